@@ -4,6 +4,11 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2_KERNEL 1
+#endif
+
 /* This code is based on some code from weston with this license:
  *
  * Copyright © 2012 Intel Corporation
@@ -57,6 +62,387 @@ static const guint32 end_vprime = 0xcdb99001;	/* vprime^block_size */
 static const guint32 step = 0x0ac93019;
 static const int block_size = 32, block_mask = 31;
 
+/* Rows are hashed this many at a time, and the row hashes are kept
+ * for the block_size rows of the blocks and the ones hashed ahead */
+#define HASH_ROWS 4
+#define HASH_RING_ROWS (32 + HASH_ROWS)
+
+/* The loops that run over every pixel of every frame have vectorized
+ * versions. They give the same results as the scalar ones, bit for
+ * bit, so buffers hashed by either can be matched against each other.
+ */
+typedef struct {
+  const char *name;
+  void (* unpremultiply_line)  (guint32       *dest,
+                                const guint32 *src,
+                                int            width);
+  void (* hash_rows)           (guint32      **hashes,
+                                const guint8  *data,
+                                int            stride,
+                                int            width,
+                                int            n_rows);
+  void (* update_block_hashes) (guint32       *block_hashes,
+                                const guint32 *bottom,
+                                const guint32 *top,
+                                int            width);
+} BroadwayBufferKernel;
+
+static void
+unpremultiply_line_c (guint32       *dest,
+                      const guint32 *src,
+                      int            width)
+{
+  const guint32 *end = src + width;
+  while (src < end)
+    {
+      guint32 pixel;
+      guint8 alpha, r, g, b;
+
+      pixel = *src++;
+
+      alpha = (pixel & 0xff000000) >> 24;
+
+      if (alpha == 0xff)
+        *dest++ = pixel;
+      else if (alpha == 0)
+        *dest++ = 0;
+      else
+        {
+          r = (((pixel & 0xff0000) >> 16) * 255 + alpha / 2) / alpha;
+          g = (((pixel & 0x00ff00) >>  8) * 255 + alpha / 2) / alpha;
+          b = (((pixel & 0x0000ff) >>  0) * 255 + alpha / 2) / alpha;
+          *dest++ = (guint32)alpha << 24 | (guint32)r << 16 | (guint32)g << 8 | (guint32)b;
+        }
+    }
+}
+
+/* Stores the hash of the block_size pixels starting at each pixel of
+ * the line, the pixels past its end counting as 0. This rolls the
+ * hash along the line, which works as end_prime is prime^block_size.
+ */
+static void
+hash_row_c (guint32       *hashes,
+            const guint32 *line,
+            int            width)
+{
+  guint32 hash;
+  int j;
+
+  hash = 0;
+  for (j = 0; j < block_size; j++)
+    {
+      hash = hash * prime;
+      if (j < width)
+        hash += line[j];
+    }
+
+  for (j = 0; j < width; j++)
+    {
+      hashes[j] = hash;
+
+      hash = hash * prime - line[j] * end_prime;
+      if (j + block_size < width)
+        hash += line[j + block_size];
+    }
+}
+
+static void
+hash_rows_c (guint32      **hashes,
+             const guint8  *data,
+             int            stride,
+             int            width,
+             int            n_rows)
+{
+  int i;
+
+  for (i = 0; i < n_rows; i++)
+    hash_row_c (hashes[i], (const guint32 *) (data + i * stride), width);
+}
+
+/* Moves the block hashes down a row: @bottom are the row hashes of
+ * the row that gets added to the blocks, @top the ones of the row
+ * that leaves them. */
+static void
+update_block_hashes_c (guint32       *block_hashes,
+                       const guint32 *bottom,
+                       const guint32 *top,
+                       int            width)
+{
+  int j;
+
+  for (j = 0; j < width; j++)
+    block_hashes[j] = block_hashes[j] * vprime + bottom[j] - top[j] * end_vprime;
+}
+
+#ifdef HAVE_SSE2_KERNEL
+/* floor (65536 / a), which is at most one too small to divide the
+ * 16 bit values of unpremultiplying by a with a multiply-high */
+#define RECIPROCAL(a) ((a) < 2 ? 0xffff : 0x10000 / (a))
+#define RECIPROCALS4(a) RECIPROCAL(a), RECIPROCAL(a + 1), RECIPROCAL(a + 2), RECIPROCAL(a + 3)
+#define RECIPROCALS16(a) RECIPROCALS4(a), RECIPROCALS4(a + 4), RECIPROCALS4(a + 8), RECIPROCALS4(a + 12)
+#define RECIPROCALS64(a) RECIPROCALS16(a), RECIPROCALS16(a + 16), RECIPROCALS16(a + 32), RECIPROCALS16(a + 48)
+
+static const guint16 reciprocals[256] = {
+  RECIPROCALS64 (0), RECIPROCALS64 (64), RECIPROCALS64 (128), RECIPROCALS64 (192)
+};
+
+/* Divides the color channels of two pixels, unpacked to 16 bits, by
+ * their alpha like unpremultiply_line_c() does. The numerator fits
+ * in 16 bits, so the quotient from the reciprocal is exact after
+ * adding one if the remainder is still too big. */
+static inline __m128i
+unpremultiply_2_sse2 (__m128i c,
+                      guint   a0,
+                      guint   a1)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i a, m, n, q, r;
+
+  a = _mm_set_epi16 (a1, a1, a1, a1, a0, a0, a0, a0);
+  m = _mm_set_epi16 (reciprocals[a1], reciprocals[a1], reciprocals[a1], reciprocals[a1],
+                     reciprocals[a0], reciprocals[a0], reciprocals[a0], reciprocals[a0]);
+
+  n = _mm_add_epi16 (_mm_sub_epi16 (_mm_slli_epi16 (c, 8), c), _mm_srli_epi16 (a, 1));
+  q = _mm_mulhi_epu16 (n, m);
+  r = _mm_sub_epi16 (n, _mm_mullo_epi16 (q, a));
+  q = _mm_sub_epi16 (q, _mm_cmpeq_epi16 (_mm_subs_epu16 (a, r), zero));
+
+  /* The scalar code truncates to 8 bits */
+  return _mm_and_si128 (q, _mm_set1_epi16 (0xff));
+}
+
+static void
+unpremultiply_line_sse2 (guint32       *dest,
+                         const guint32 *src,
+                         int            width)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i alpha_mask = _mm_set1_epi32 ((int) 0xff000000);
+  int x;
+
+  for (x = 0; x + 4 <= width; x += 4)
+    {
+      __m128i pixels, alpha, lo, hi, result;
+
+      pixels = _mm_loadu_si128 ((const __m128i *) (src + x));
+      alpha = _mm_and_si128 (pixels, alpha_mask);
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (alpha, alpha_mask)) == 0xffff)
+        {
+          _mm_storeu_si128 ((__m128i *) (dest + x), pixels);
+          continue;
+        }
+
+      lo = unpremultiply_2_sse2 (_mm_unpacklo_epi8 (pixels, zero), src[x] >> 24, src[x + 1] >> 24);
+      hi = unpremultiply_2_sse2 (_mm_unpackhi_epi8 (pixels, zero), src[x + 2] >> 24, src[x + 3] >> 24);
+
+      /* Put the alpha back, and clear the transparent pixels */
+      result = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, _mm_packus_epi16 (lo, hi)), alpha);
+      result = _mm_andnot_si128 (_mm_cmpeq_epi32 (alpha, zero), result);
+
+      _mm_storeu_si128 ((__m128i *) (dest + x), result);
+    }
+
+  unpremultiply_line_c (dest + x, src + x, width - x);
+}
+
+/* SSE2 has no 32 bit multiply */
+static inline __m128i
+mullo_epi32_sse2 (__m128i a,
+                  __m128i b)
+{
+  __m128i even, odd;
+
+  even = _mm_mul_epu32 (a, b);
+  odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+
+  return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+                             _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+}
+
+static inline void
+transpose_4x4_sse2 (__m128i *v)
+{
+  __m128i t0, t1, t2, t3;
+
+  t0 = _mm_unpacklo_epi32 (v[0], v[1]);
+  t1 = _mm_unpacklo_epi32 (v[2], v[3]);
+  t2 = _mm_unpackhi_epi32 (v[0], v[1]);
+  t3 = _mm_unpackhi_epi32 (v[2], v[3]);
+
+  v[0] = _mm_unpacklo_epi64 (t0, t1);
+  v[1] = _mm_unpackhi_epi64 (t0, t1);
+  v[2] = _mm_unpacklo_epi64 (t2, t3);
+  v[3] = _mm_unpackhi_epi64 (t2, t3);
+}
+
+/* Rolls the hashes of four rows at once, one row per lane. The pixels
+ * are transposed in blocks of 4x4 so that a vector has the same column
+ * of all rows, and the hashes are transposed back. */
+static void
+hash_rows_sse2 (guint32      **hashes,
+                const guint8  *data,
+                int            stride,
+                int            width,
+                int            n_rows)
+{
+  const __m128i p = _mm_set1_epi32 ((int) prime);
+  const __m128i end_p = _mm_set1_epi32 ((int) end_prime);
+  const guint32 *lines[4];
+  __m128i hash, leaving[4], entering[4], out[4];
+  guint32 h[4];
+  int j, k;
+
+  if (n_rows < 4 || width < block_size + 4)
+    {
+      hash_rows_c (hashes, data, stride, width, n_rows);
+      return;
+    }
+
+  for (k = 0; k < 4; k++)
+    {
+      lines[k] = (const guint32 *) (data + k * stride);
+
+      h[k] = 0;
+      for (j = 0; j < block_size; j++)
+        h[k] = h[k] * prime + lines[k][j];
+    }
+
+  hash = _mm_loadu_si128 ((const __m128i *) h);
+
+  for (j = 0; j + block_size + 4 <= width; j += 4)
+    {
+      for (k = 0; k < 4; k++)
+        {
+          leaving[k] = _mm_loadu_si128 ((const __m128i *) (lines[k] + j));
+          entering[k] = _mm_loadu_si128 ((const __m128i *) (lines[k] + j + block_size));
+        }
+      transpose_4x4_sse2 (leaving);
+      transpose_4x4_sse2 (entering);
+
+      for (k = 0; k < 4; k++)
+        {
+          out[k] = hash;
+          hash = _mm_add_epi32 (_mm_sub_epi32 (mullo_epi32_sse2 (hash, p),
+                                               mullo_epi32_sse2 (leaving[k], end_p)),
+                                entering[k]);
+        }
+
+      transpose_4x4_sse2 (out);
+      for (k = 0; k < 4; k++)
+        _mm_storeu_si128 ((__m128i *) (hashes[k] + j), out[k]);
+    }
+
+  /* The end of the rows, where no more pixels enter the hash */
+  _mm_storeu_si128 ((__m128i *) h, hash);
+  for (k = 0; k < 4; k++)
+    {
+      int jj;
+
+      for (jj = j; jj < width; jj++)
+        {
+          hashes[k][jj] = h[k];
+
+          h[k] = h[k] * prime - lines[k][jj] * end_prime;
+          if (jj + block_size < width)
+            h[k] += lines[k][jj + block_size];
+        }
+    }
+}
+
+static void
+update_block_hashes_sse2 (guint32       *block_hashes,
+                          const guint32 *bottom,
+                          const guint32 *top,
+                          int            width)
+{
+  const __m128i vp = _mm_set1_epi32 ((int) vprime);
+  const __m128i end_vp = _mm_set1_epi32 ((int) end_vprime);
+  int j;
+
+  for (j = 0; j + 4 <= width; j += 4)
+    {
+      __m128i h, b, t;
+
+      h = _mm_loadu_si128 ((const __m128i *) (block_hashes + j));
+      b = _mm_loadu_si128 ((const __m128i *) (bottom + j));
+      t = _mm_loadu_si128 ((const __m128i *) (top + j));
+
+      h = _mm_sub_epi32 (_mm_add_epi32 (mullo_epi32_sse2 (h, vp), b),
+                         mullo_epi32_sse2 (t, end_vp));
+
+      _mm_storeu_si128 ((__m128i *) (block_hashes + j), h);
+    }
+
+  update_block_hashes_c (block_hashes + j, bottom + j, top + j, width - j);
+}
+#endif
+
+/* Fastest first */
+static const BroadwayBufferKernel kernels[] = {
+#ifdef HAVE_SSE2_KERNEL
+  { "sse2", unpremultiply_line_sse2, hash_rows_sse2, update_block_hashes_sse2 },
+#endif
+  { "scalar", unpremultiply_line_c, hash_rows_c, update_block_hashes_c },
+};
+
+static const BroadwayBufferKernel *kernel = &kernels[0];
+
+/*
+ * broadway_buffer_list_kernels:
+ *
+ * Lists the names of the implementations of the per-pixel loops,
+ * for testing. "scalar" is always available.
+ *
+ * Returns: (transfer container): a %NULL-terminated array of names
+ */
+const char **
+broadway_buffer_list_kernels (void)
+{
+  const char **names;
+  guint i;
+
+  names = g_new (const char *, G_N_ELEMENTS (kernels) + 1);
+  for (i = 0; i < G_N_ELEMENTS (kernels); i++)
+    names[i] = kernels[i].name;
+  names[i] = NULL;
+
+  return names;
+}
+
+/*
+ * broadway_buffer_set_kernel:
+ * @name: (allow-none): a name returned by broadway_buffer_list_kernels()
+ *     or %NULL for the fastest one
+ *
+ * Selects the implementation of the per-pixel loops, for testing.
+ * This must not be called while buffers are created or encoded.
+ *
+ * Returns: %TRUE if @name is available
+ */
+gboolean
+broadway_buffer_set_kernel (const char *name)
+{
+  guint i;
+
+  if (name == NULL)
+    {
+      kernel = &kernels[0];
+      return TRUE;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (kernels); i++)
+    {
+      if (g_str_equal (kernels[i].name, name))
+        {
+          kernel = &kernels[i];
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
 static gboolean
 verify_block_match (BroadwayBuffer *buffer, int x, int y,
                     BroadwayBuffer *prev, struct entry *entry)
@@ -299,32 +685,54 @@ broadway_buffer_get_height (BroadwayBuffer *buffer)
 }
 
 static void
-unpremultiply_line (void *destp, void *srcp, int width)
+unpremultiply_line (guint8       *destp,
+                    const guint8 *srcp,
+                    int           width)
 {
-  guint32 *src = srcp;
-  guint32 *dest = destp;
-  guint32 *end = src + width;
-  while (src < end)
+  const guint32 *src = (const guint32 *) srcp;
+  guint32 *dest = (guint32 *) destp;
+  int x;
+
+  /* Most rows are opaque, or at least start that way, and opaque
+   * pixels stay as they are */
+  for (x = 0; x < width; x++)
     {
-      guint32 pixel;
-      guint8 alpha, r, g, b;
+      if ((src[x] & 0xff000000) != 0xff000000)
+        break;
+    }
 
-      pixel = *src++;
+  memcpy (dest, src, x * 4);
+  if (x < width)
+    kernel->unpremultiply_line (dest + x, src + x, width - x);
+}
 
-      alpha = (pixel & 0xff000000) >> 24;
+static inline guint32 *
+get_row_hashes (guint32 *ring, int width, int row)
+{
+  return ring + (row % HASH_RING_ROWS) * width;
+}
 
-      if (alpha == 0xff)
-        *dest++ = pixel;
-      else if (alpha == 0)
-        *dest++ = 0;
-      else
-        {
-          r = (((pixel & 0xff0000) >> 16) * 255 + alpha / 2) / alpha;
-          g = (((pixel & 0x00ff00) >>  8) * 255 + alpha / 2) / alpha;
-          b = (((pixel & 0x0000ff) >>  0) * 255 + alpha / 2) / alpha;
-          *dest++ = (guint32)alpha << 24 | (guint32)r << 16 | (guint32)g << 8 | (guint32)b;
-        }
-    }
+/* Hashes the HASH_ROWS rows from @first_row on, the ones below the
+ * buffer hash to 0. */
+static void
+hash_rows (BroadwayBuffer *buffer,
+           guint32        *ring,
+           int             first_row)
+{
+  guint32 *hashes[HASH_ROWS];
+  int k, n_rows;
+
+  n_rows = CLAMP (buffer->height - first_row, 0, HASH_ROWS);
+
+  for (k = 0; k < HASH_ROWS; k++)
+    hashes[k] = get_row_hashes (ring, buffer->width, first_row + k);
+
+  if (n_rows > 0)
+    kernel->hash_rows (hashes, buffer->data + first_row * buffer->stride,
+                       buffer->stride, buffer->width, n_rows);
+
+  for (k = n_rows; k < HASH_ROWS; k++)
+    memset (hashes[k], 0, buffer->width * sizeof (guint32));
 }
 
 BroadwayBuffer *
@@ -364,8 +772,8 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
   struct entry *entry;
   int i, j, k;
   int x0, x1, y0, y1;
-  guint32 *block_hashes;
-  guint32 hash, bottom_hash, h, *line, *bottom, *prev_line;
+  guint32 *block_hashes, *row_hashes, *zeros;
+  guint32 h, *line, *prev_line;
   int width, height;
   struct encoder encoder = { 0 };
   int *skyline, skyline_pixels;
@@ -382,41 +790,25 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
 
   block_hashes = g_malloc0 (width * sizeof block_hashes[0]);
 
+  /* The hashes of the block_size pixels starting at each pixel, for
+   * the rows of the blocks at the current row and the ones below */
+  row_hashes = g_malloc (HASH_RING_ROWS * width * sizeof row_hashes[0]);
+  zeros = g_malloc0 (width * sizeof zeros[0]);
+
   matches = 0;
   encoder.dest = dest;
 
   // Calculate the block hashes for the first row
-  for (i = y0; i < MIN(y1, y0 + block_size); i++)
-    {
-      line = (guint32 *)(buffer->data + i * buffer->stride);
-      hash = 0;
-      for (j = x0; j < MIN(x1, x0 + block_size); j++)
-        hash = hash * prime + line[j];
-      for (; j < x0 + block_size; j++)
-        hash = hash * prime;
-
-      for (j = x0; j < x1; j++)
-        {
-          block_hashes[j] = block_hashes[j] * vprime + hash;
-
-          hash = hash * prime - line[j] * end_prime;
-          if (j + block_size < width)
-            hash += line[j + block_size];
-        }
-    }
-  // Do the last rows if height < block_size
-  for (; i < y0 + block_size; i++)
-    {
-      for (j = x0; j < x1; j++)
-        block_hashes[j] = block_hashes[j] * vprime;
-    }
+  for (i = y0; i < y0 + block_size; i += HASH_ROWS)
+    hash_rows (buffer, row_hashes, i);
+  for (i = y0; i < y0 + block_size; i++)
+    kernel->update_block_hashes (block_hashes,
+                                 get_row_hashes (row_hashes, width, i),
+                                 zeros, width);
 
   for (i = y0; i < y1; i++)
     {
       line = (guint32 *) (buffer->data + i * buffer->stride);
-      bottom = (guint32 *) (buffer->data + (i + block_size) * buffer->stride);
-      bottom_hash = 0;
-      hash = 0;
       skyline_pixels = 0;
 
       if (prev && i < prev->height)
@@ -426,15 +818,6 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
 
       for (j = x0; j < x0 + block_size; j++)
         {
-          hash = hash * prime;
-          if (j < width)
-            hash += line[j];
-          if (i + block_size < height)
-            {
-              bottom_hash = bottom_hash * prime;
-              if (j < width)
-                bottom_hash += bottom[j];
-            }
           if (i < skyline[j])
             skyline_pixels = 0;
           else
@@ -486,22 +869,17 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
            * grid point. */
           if (((i | j) & block_mask) == 0 && !buffer->encoded)
             insert_block (buffer, block_hashes[j], j, i);
+        }
 
-          /* Update sliding block hash */
-          block_hashes[j] =
-            block_hashes[j] * vprime + bottom_hash -
-            hash * end_vprime;
+      /* Update sliding block hashes, hashing the rows they move
+       * down to ahead of time */
+      if ((i - y0) % HASH_ROWS == 0)
+        hash_rows (buffer, row_hashes, i + block_size);
 
-          if (i + block_size < height)
-            {
-              bottom_hash = bottom_hash * prime - bottom[j] * end_prime;
-              if (j + block_size < width)
-                bottom_hash += bottom[j + block_size];
-            }
-          hash = hash * prime - line[j] * end_prime;
-          if  (j + block_size < width)
-            hash += line[j + block_size] ;
-        }
+      kernel->update_block_hashes (block_hashes,
+                                   get_row_hashes (row_hashes, width, i + block_size),
+                                   get_row_hashes (row_hashes, width, i),
+                                   width);
     }
 
   encoder_flush (&encoder);
@@ -523,6 +901,58 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
 
   g_free (skyline);
   g_free (block_hashes);
+  g_free (row_hashes);
+  g_free (zeros);
 
   buffer->encoded = TRUE;
 }
+
+/* Copies the pixels inside @rect from @data into @buffer, and if @dest
+ * is non-%NULL appends them to it, encoded as deltas against the pixels
+ * they replace. The client decodes this against the same rectangle of
+ * its copy, so unlike broadway_buffer_encode() this never emits block
+ * references. The block hash table of @buffer is not updated, which is
+ * fine as block matches are always verified against the actual data.
+ */
+void
+broadway_buffer_update_rect (BroadwayBuffer        *buffer,
+                             cairo_rectangle_int_t *rect,
+                             guint8                *data,
+                             int                    stride,
+                             GString               *dest)
+{
+  struct encoder encoder = { 0 };
+  guint32 *line, *new_line;
+  int x0, x1, y0, y1;
+  int i, j;
+
+  x0 = MAX (rect->x, 0);
+  y0 = MAX (rect->y, 0);
+  x1 = MIN (rect->x + rect->width, buffer->width);
+  y1 = MIN (rect->y + rect->height, buffer->height);
+
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  new_line = g_new (guint32, x1 - x0);
+  encoder.dest = dest;
+
+  for (i = y0; i < y1; i++)
+    {
+      line = (guint32 *) (buffer->data + i * buffer->stride) + x0;
+      unpremultiply_line ((guint8 *) new_line, data + i * stride + x0 * 4, x1 - x0);
+
+      if (dest)
+        {
+          for (j = 0; j < x1 - x0; j++)
+            encode_pixel (&encoder, new_line[j], line[j]);
+        }
+
+      memcpy (line, new_line, (x1 - x0) * 4);
+    }
+
+  if (dest)
+    encoder_flush (&encoder);
+
+  g_free (new_line);
+}
@@ -3,6 +3,7 @@
 
 #include "broadway-protocol.h"
 #include <glib-object.h>
+#include <cairo.h>
 
 typedef struct _BroadwayBuffer BroadwayBuffer;
 
@@ -14,7 +15,15 @@ void            broadway_buffer_destroy    (BroadwayBuffer *buffer);
 void            broadway_buffer_encode     (BroadwayBuffer *buffer,
                                             BroadwayBuffer *prev,
                                             GString        *dest);
+void            broadway_buffer_update_rect (BroadwayBuffer        *buffer,
+                                             cairo_rectangle_int_t *rect,
+                                             guint8                *data,
+                                             int                    stride,
+                                             GString               *dest);
 int             broadway_buffer_get_width  (BroadwayBuffer *buffer);
 int             broadway_buffer_get_height (BroadwayBuffer *buffer);
 
+const char **   broadway_buffer_list_kernels (void);
+gboolean        broadway_buffer_set_kernel   (const char     *name);
+
 #endif /* __BROADWAY_BUFFER__ */
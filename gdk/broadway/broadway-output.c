@@ -11,20 +11,114 @@
  *                Basic I/O primitives                                  *
  ************************************************************************/
 
+typedef struct {
+  GBytes *bytes;              /* NULL until @deferred is complete */
+  BroadwayOutput *deferred;
+} BroadwayFrame;
+
 struct BroadwayOutput {
   GOutputStream *out;
   GString *buf;
   int error;
   guint32 serial;
+  /* All buffers sent on the connection share one deflate stream,
+   * so only one thread at a time may put buffers. */
+  GZlibCompressor *compressor;
+
+  /* Websocket frames waiting to be written, oldest first */
+  GQueue frames;
+  gsize queued_size;
+  gboolean writing;
+  gboolean closing;
+  BroadwayOutputWrittenFunc written_func;
+  gpointer written_data;
+
+  /* Set for deferred outputs, until the output goes away */
+  BroadwayOutput *parent;
 };
 
+static void write_frames (BroadwayOutput *output);
+
 static void
-broadway_output_send_cmd (BroadwayOutput *output,
-			  gboolean fin, BroadwayWSOpCode code,
-			  const void *buf, gsize count)
+free_frame (BroadwayFrame *frame)
+{
+  if (frame->bytes)
+    g_bytes_unref (frame->bytes);
+  g_free (frame);
+}
+
+static void
+broadway_output_destroy (BroadwayOutput *output)
+{
+  g_queue_foreach (&output->frames, (GFunc)free_frame, NULL);
+  g_queue_clear (&output->frames);
+  g_object_unref (output->out);
+  g_object_unref (output->compressor);
+  g_string_free (output->buf, TRUE);
+  free (output);
+}
+
+static void
+frame_written_cb (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  BroadwayOutput *output = user_data;
+  BroadwayFrame *frame;
+
+  output->writing = FALSE;
+
+  frame = g_queue_pop_head (&output->frames);
+  output->queued_size -= g_bytes_get_size (frame->bytes);
+  free_frame (frame);
+
+  /* This is noticed by the next flush */
+  if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source), result, NULL, NULL))
+    output->error = TRUE;
+
+  if (output->closing)
+    {
+      if (output->error || g_queue_is_empty (&output->frames))
+        broadway_output_destroy (output);
+      else
+        write_frames (output);
+      return;
+    }
+
+  write_frames (output);
+
+  /* Last, as this may free the output */
+  if (output->written_func)
+    output->written_func (output->written_data);
+}
+
+static void
+write_frames (BroadwayOutput *output)
+{
+  BroadwayFrame *frame;
+
+  if (output->writing || output->error)
+    return;
+
+  frame = g_queue_peek_head (&output->frames);
+  if (frame == NULL || frame->bytes == NULL)
+    return;
+
+  output->writing = TRUE;
+  g_output_stream_write_all_async (output->out,
+                                   g_bytes_get_data (frame->bytes, NULL),
+                                   g_bytes_get_size (frame->bytes),
+                                   G_PRIORITY_DEFAULT, NULL,
+                                   frame_written_cb, output);
+}
+
+static GBytes *
+create_frame (gboolean fin, BroadwayWSOpCode code,
+              const void *buf, gsize count)
 {
   gboolean mask = FALSE;
   guchar header[16];
+  guchar *data;
   size_t p;
 
   gboolean mid_header = count > 125 && count <= 65535;
@@ -46,9 +140,27 @@ broadway_output_send_cmd (BroadwayOutput *output,
       p += 8;
     }
   // FIXME: if we are paranoid we should 'mask' the data
-  // FIXME: we should really emit these as a single write
-  g_output_stream_write_all (output->out, header, p, NULL, NULL, NULL);
-  g_output_stream_write_all (output->out, buf, count, NULL, NULL, NULL);
+  data = g_malloc (p + count);
+  memcpy (data, header, p);
+  if (count > 0)
+    memcpy (data + p, buf, count);
+
+  return g_bytes_new_take (data, p + count);
+}
+
+static void
+broadway_output_send_cmd (BroadwayOutput *output,
+			  gboolean fin, BroadwayWSOpCode code,
+			  const void *buf, gsize count)
+{
+  BroadwayFrame *frame;
+
+  frame = g_new0 (BroadwayFrame, 1);
+  frame->bytes = create_frame (fin, code, buf, count);
+  output->queued_size += g_bytes_get_size (frame->bytes);
+  g_queue_push_tail (&output->frames, frame);
+
+  write_frames (output);
 }
 
 void broadway_output_pong (BroadwayOutput *output)
@@ -56,23 +168,120 @@ void broadway_output_pong (BroadwayOutput *output)
   broadway_output_send_cmd (output, TRUE, BROADWAY_WS_CNX_PONG, NULL, 0);
 }
 
+/* Queues the commands written so far, they are written to the
+ * connection asynchronously. */
 int
 broadway_output_flush (BroadwayOutput *output)
 {
-  if (output->buf->len == 0)
-    return TRUE;
-
-  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
-                            output->buf->str, output->buf->len);
+  if (output->buf->len > 0)
+    {
+      broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
+                                output->buf->str, output->buf->len);
 
-  g_string_set_size (output->buf, 0);
+      g_string_set_size (output->buf, 0);
+    }
 
   return !output->error;
+}
 
+/* Returns the number of bytes that were flushed but not written
+ * to the connection yet.
+ */
+gsize
+broadway_output_get_queued_size (BroadwayOutput *output)
+{
+  return output->queued_size;
 }
 
+/* Sets a function that gets called whenever a frame was written */
+void
+broadway_output_set_written_func (BroadwayOutput            *output,
+                                  BroadwayOutputWrittenFunc  func,
+                                  gpointer                   data)
+{
+  output->written_func = func;
+  output->written_data = data;
+}
+
+/* Returns an output for a command that gets written later, possibly
+ * from another thread. It is sent after everything written to @output
+ * before, once broadway_output_complete() is called for it. Only put
+ * buffers to @output from the returned output until then.
+ */
 BroadwayOutput *
-broadway_output_new (GOutputStream *out, guint32 serial)
+broadway_output_defer (BroadwayOutput *output)
+{
+  BroadwayOutput *deferred;
+  BroadwayFrame *frame;
+
+  broadway_output_flush (output);
+
+  deferred = g_new0 (BroadwayOutput, 1);
+  deferred->buf = g_string_new ("");
+  deferred->serial = output->serial++;
+  deferred->compressor = g_object_ref (output->compressor);
+  deferred->parent = output;
+
+  frame = g_new0 (BroadwayFrame, 1);
+  frame->deferred = deferred;
+  g_queue_push_tail (&output->frames, frame);
+
+  return deferred;
+}
+
+/* Queues what was written to @deferred in its place, and frees it.
+ * Returns whether anything was queued. Whatever was written is always
+ * sent, as the client has to inflate everything that went through the
+ * shared compressor to stay in sync with it. */
+gboolean
+broadway_output_complete (BroadwayOutput *deferred)
+{
+  BroadwayOutput *output = deferred->parent;
+  BroadwayFrame *frame;
+  gboolean queued = FALSE;
+  GList *l;
+
+  if (output != NULL)
+    {
+      for (l = output->frames.head; l != NULL; l = l->next)
+        {
+          frame = l->data;
+          if (frame->deferred == deferred)
+            break;
+        }
+      g_assert (l != NULL);
+
+      /* A broken compressor breaks the connection */
+      if (deferred->error)
+        output->error = TRUE;
+
+      frame->deferred = NULL;
+      if (deferred->buf->len > 0 && !deferred->error)
+        {
+          frame->bytes = create_frame (TRUE, BROADWAY_WS_BINARY,
+                                       deferred->buf->str, deferred->buf->len);
+          output->queued_size += g_bytes_get_size (frame->bytes);
+          queued = TRUE;
+        }
+      else
+        {
+          g_queue_delete_link (&output->frames, l);
+          free_frame (frame);
+        }
+
+      write_frames (output);
+    }
+
+  g_object_unref (deferred->compressor);
+  g_string_free (deferred->buf, TRUE);
+  g_free (deferred);
+
+  return queued;
+}
+
+BroadwayOutput *
+broadway_output_new (GOutputStream *out, guint32 serial,
+                     int compression_level)
 {
   BroadwayOutput *output;
 
@@ -81,15 +290,43 @@ broadway_output_new (GOutputStream *out, guint32 serial)
   output->out = g_object_ref (out);
   output->buf = g_string_new ("");
   output->serial = serial;
+  output->compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                              compression_level);
 
   return output;
 }
 
+/* The frames that are ready are still written, so that e.g. the
+ * disconnect message makes it to the client. */
 void
 broadway_output_free (BroadwayOutput *output)
 {
-  g_object_unref (output->out);
-  free (output);
+  BroadwayFrame *frame;
+  GList *l, *next;
+
+  for (l = output->frames.head; l != NULL; l = next)
+    {
+      next = l->next;
+      frame = l->data;
+
+      if (frame->deferred)
+        {
+          frame->deferred->parent = NULL;
+          g_queue_delete_link (&output->frames, l);
+          free_frame (frame);
+        }
+    }
+
+  output->closing = TRUE;
+  output->written_func = NULL;
+
+  if (output->writing)
+    return;
+
+  if (output->error || g_queue_is_empty (&output->frames))
+    broadway_output_destroy (output);
+  else
+    write_frames (output);
 }
 
 guint32
@@ -286,16 +523,77 @@ broadway_output_set_transient_for (BroadwayOutput *output,
   append_uint16 (output, parent_id);
 }
 
+/* Compresses @encoded straight into the output buffer, prefixed
+ * by its compressed size. The stream is sync flushed, so the client
+ * can decompress each buffer as it arrives, while later buffers can
+ * still refer back to the data of earlier ones.
+ */
+static void
+append_compressed (BroadwayOutput *output,
+                   GString        *encoded)
+{
+  GConverterResult res;
+  GError *error = NULL;
+  gsize start, size, len, in_pos, bytes_read, bytes_written;
+  guint8 *buf;
+
+  /* Filled in when we know the size */
+  append_uint32 (output, 0);
+  start = output->buf->len;
+
+  size = encoded->len + encoded->len / 8 + 64;
+  len = 0;
+  in_pos = 0;
+
+  do
+    {
+      if (len == size)
+        size *= 2;
+      g_string_set_size (output->buf, start + size);
+
+      res = g_converter_convert (G_CONVERTER (output->compressor),
+                                 encoded->str + in_pos, encoded->len - in_pos,
+                                 output->buf->str + start + len, size - len,
+                                 G_CONVERTER_FLUSH,
+                                 &bytes_read, &bytes_written, &error);
+      if (res == G_CONVERTER_ERROR)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            {
+              g_clear_error (&error);
+              size *= 2;
+              continue;
+            }
+
+          /* The stream is unusable now, so is the connection */
+          g_warning ("compression failed: %s\n", error->message);
+          g_error_free (error);
+          output->error = TRUE;
+          break;
+        }
+
+      in_pos += bytes_read;
+      len += bytes_written;
+    }
+  /* A full output buffer may mean that there is more to flush */
+  while (res != G_CONVERTER_FLUSHED && (in_pos < encoded->len || len == size));
+
+  g_string_set_size (output->buf, start + len);
+
+  buf = (guint8 *)output->buf->str + start - 4;
+  buf[0] = (len >> 0) & 0xff;
+  buf[1] = (len >> 8) & 0xff;
+  buf[2] = (len >> 16) & 0xff;
+  buf[3] = (len >> 24) & 0xff;
+}
+
 void
 broadway_output_put_buffer (BroadwayOutput *output,
                             int             id,
                             BroadwayBuffer *prev_buffer,
                             BroadwayBuffer *buffer)
 {
-  gsize len;
   int w, h;
-  GZlibCompressor *compressor;
-  GOutputStream *out, *out_mem;
   GString *encoded;
 
   write_header (output, BROADWAY_OP_PUT_BUFFER);
@@ -310,23 +608,52 @@ broadway_output_put_buffer (BroadwayOutput *output,
   encoded = g_string_new ("");
   broadway_buffer_encode (buffer, prev_buffer, encoded);
 
-  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1);
-  out_mem = g_memory_output_stream_new_resizable ();
-  out = g_converter_output_stream_new (out_mem, G_CONVERTER (compressor));
-  g_object_unref (compressor);
+  append_compressed (output, encoded);
 
-  if (!g_output_stream_write_all (out, encoded->str, encoded->len,
-                                  NULL, NULL, NULL) ||
-      !g_output_stream_close (out, NULL, NULL))
-    g_warning ("compression failed\n");
+  g_string_free (encoded, TRUE);
+}
 
+/* Updates the rectangles of @region in @buffer from @data, and sends
+ * only those to the client. Each rectangle is followed by the length
+ * of its encoded data, and the data of all rectangles is compressed
+ * together. @region must be inside the buffer.
+ */
+void
+broadway_output_put_buffer_rects (BroadwayOutput *output,
+                                  int             id,
+                                  BroadwayBuffer *buffer,
+                                  cairo_region_t *region,
+                                  guint8         *data,
+                                  int             stride)
+{
+  cairo_rectangle_int_t rect;
+  GString *encoded;
+  gsize start;
+  int i, n_rects;
 
-  len = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (out_mem));
-  append_uint32 (output, len);
+  write_header (output, BROADWAY_OP_PUT_BUFFER_RECTS);
+
+  n_rects = cairo_region_num_rectangles (region);
+
+  append_uint16 (output, id);
+  append_uint16 (output, n_rects);
+
+  encoded = g_string_new ("");
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_region_get_rectangle (region, i, &rect);
+
+      start = encoded->len;
+      broadway_buffer_update_rect (buffer, &rect, data, stride, encoded);
+
+      append_uint16 (output, rect.x);
+      append_uint16 (output, rect.y);
+      append_uint16 (output, rect.width);
+      append_uint16 (output, rect.height);
+      append_uint32 (output, encoded->len - start);
+    }
 
-  g_string_append_len (output->buf, g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (out_mem)), len);
+  append_compressed (output, encoded);
 
   g_string_free (encoded, TRUE);
-  g_object_unref (out);
-  g_object_unref (out_mem);
 }
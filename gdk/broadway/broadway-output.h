@@ -17,11 +17,20 @@ typedef enum {
   BROADWAY_WS_CNX_PONG = 0xa
 } BroadwayWSOpCode;
 
+typedef void (*BroadwayOutputWrittenFunc) (gpointer data);
+
 BroadwayOutput *broadway_output_new             (GOutputStream  *out,
-						 guint32         serial);
+						 guint32         serial,
+						 int             compression_level);
 void            broadway_output_free            (BroadwayOutput *output);
 int             broadway_output_flush           (BroadwayOutput *output);
 int             broadway_output_has_error       (BroadwayOutput *output);
+gsize           broadway_output_get_queued_size (BroadwayOutput *output);
+void            broadway_output_set_written_func (BroadwayOutput            *output,
+                                                  BroadwayOutputWrittenFunc  func,
+                                                  gpointer                   data);
+BroadwayOutput *broadway_output_defer           (BroadwayOutput *output);
+gboolean        broadway_output_complete        (BroadwayOutput *deferred);
 void            broadway_output_set_next_serial (BroadwayOutput *output,
 						 guint32         serial);
 guint32         broadway_output_get_next_serial (BroadwayOutput *output);
@@ -58,6 +67,12 @@ void            broadway_output_put_buffer      (BroadwayOutput *output,
 						 int             id,
                                                  BroadwayBuffer *prev_buffer,
                                                  BroadwayBuffer *buffer);
+void            broadway_output_put_buffer_rects (BroadwayOutput *output,
+                                                  int             id,
+                                                  BroadwayBuffer *buffer,
+                                                  cairo_region_t *region,
+                                                  guint8         *data,
+                                                  int             stride);
 void            broadway_output_grab_pointer    (BroadwayOutput *output,
 						 int id,
 						 gboolean owner_event);
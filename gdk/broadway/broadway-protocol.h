@@ -23,7 +23,9 @@ typedef enum {
   BROADWAY_EVENT_CONFIGURE_NOTIFY = 'w',
   BROADWAY_EVENT_DELETE_NOTIFY = 'W',
   BROADWAY_EVENT_SCREEN_SIZE_CHANGED = 'd',
-  BROADWAY_EVENT_FOCUS = 'f'
+  BROADWAY_EVENT_FOCUS = 'f',
+  BROADWAY_EVENT_FRAME_ACK = 'F',
+  BROADWAY_EVENT_FRAME_DONE = 'D'
 } BroadwayEventType;
 
 typedef enum {
@@ -42,6 +44,7 @@ typedef enum {
   BROADWAY_OP_AUTH_OK = 'L',
   BROADWAY_OP_DISCONNECTED = 'D',
   BROADWAY_OP_PUT_BUFFER = 'b',
+  BROADWAY_OP_PUT_BUFFER_RECTS = 'P',
   BROADWAY_OP_SET_SHOW_KEYBOARD = 'k',
 } BroadwayOpType;
 
@@ -128,6 +131,11 @@ typedef struct {
   gint32 old_id;
 } BroadwayInputFocusMsg;
 
+typedef struct {
+  BroadwayInputBaseMsg base;
+  gint32 id;
+} BroadwayInputFrameDoneMsg;
+
 typedef union {
   BroadwayInputBaseMsg base;
   BroadwayInputPointerMsg pointer;
@@ -141,6 +149,7 @@ typedef union {
   BroadwayInputDeleteNotify delete_notify;
   BroadwayInputScreenResizeNotify screen_resize_notify;
   BroadwayInputFocusMsg focus;
+  BroadwayInputFrameDoneMsg frame_done;
 } BroadwayInputMsg;
 
 typedef enum {
@@ -192,8 +201,13 @@ typedef struct {
   char name[36];
   guint32 width;
   guint32 height;
+  guint32 n_rects; /* 0 if the whole window changed */
+  BroadwayRect rects[1];
 } BroadwayRequestUpdate;
 
+/* Damage with more rectangles than this is sent as its extents */
+#define BROADWAY_MAX_UPDATE_RECTS 16
+
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
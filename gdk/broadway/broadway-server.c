@@ -35,8 +35,15 @@
 #include <string.h>
 #endif
 
+/* Don't start encoding more updates while the client is this far behind,
+ * or while it didn't acknowledge this many of the frames sent to it */
+#define MAX_QUEUED_OUTPUT (256 * 1024)
+#define MAX_FRAMES_IN_FLIGHT 2
+
 typedef struct BroadwayInput BroadwayInput;
 typedef struct BroadwayWindow BroadwayWindow;
+typedef struct BroadwayEncodeJob BroadwayEncodeJob;
+typedef struct BroadwayFrameInFlight BroadwayFrameInFlight;
 struct _BroadwayServer {
   GObject parent_instance;
 
@@ -58,6 +65,23 @@ struct _BroadwayServer {
   BroadwayWindow *root;
   gint32 focused_window_id; /* -1 => none */
   gint show_keyboard;
+  int compression_level;
+
+  /* Window contents are encoded in a thread, one update at a time,
+   * so that the order of the deflate stream is kept. */
+  GThreadPool *encoder;
+  GQueue encode_queue;
+  BroadwayEncodeJob *encoding;
+
+  /* Frames sent to the client that it didn't acknowledge yet, oldest first */
+  GQueue frames_in_flight;
+
+  /* Statistics, see send_stats() */
+  guint64 n_updates;
+  guint64 n_merged_updates;
+  guint64 n_frames_sent;
+  guint64 n_frames_acked;
+  gint64 frame_latency;
 
   guint32 screen_width;
   guint32 screen_height;
@@ -114,14 +138,44 @@ struct BroadwayWindow {
   gboolean visible;
   gint32 transient_for;
 
+  /* Only used by the encoder thread, while there are jobs */
   BroadwayBuffer *buffer;
   gboolean buffer_synced;
 
+  gint32 content_width;
+  gint32 content_height;
+  BroadwayEncodeJob *queued_update;
+  int n_jobs;
+  gboolean destroyed;
+  gboolean frame_pending; /* The client waits for BROADWAY_EVENT_FRAME_DONE */
+
   char *cached_surface_name;
   cairo_surface_t *cached_surface;
 };
 
+struct BroadwayEncodeJob {
+  BroadwayServer *server;
+  BroadwayWindow *window;
+  gboolean resend; /* Send the current contents to a new client */
+  guint8 *data; /* Copy of the new contents */
+  int width;
+  int height;
+  cairo_region_t *damage; /* Changed parts of data, NULL for all */
+  BroadwayOutput *output; /* Deferred, NULL if it's not sent */
+  guint32 serial; /* Of the command in output */
+};
+
+struct BroadwayFrameInFlight {
+  guint32 serial;
+  gint64 sent_time;
+};
+
 static void broadway_server_resync_windows (BroadwayServer *server);
+static void broadway_server_encode_next (BroadwayServer *server);
+static void broadway_server_clear_frames_in_flight (BroadwayServer *server);
+static void broadway_window_free (BroadwayWindow *window);
+static void encode_job (gpointer data, gpointer user_data);
+static void encode_job_free (BroadwayEncodeJob *job);
 
 static GType broadway_server_get_type (void);
 
@@ -138,6 +192,8 @@ broadway_server_init (BroadwayServer *server)
   server->last_seen_time = 1;
   server->id_ht = g_hash_table_new (NULL, NULL);
   server->id_counter = 0;
+  server->compression_level = -1;
+  server->encoder = g_thread_pool_new (encode_job, server, 1, FALSE, NULL);
 
   root = g_new0 (BroadwayWindow, 1);
   root->id = server->id_counter++;
@@ -157,6 +213,9 @@ broadway_server_finalize (GObject *object)
 {
   BroadwayServer *server = BROADWAY_SERVER (object);
 
+  g_thread_pool_free (server->encoder, TRUE, TRUE);
+  broadway_server_clear_frames_in_flight (server);
+
   g_free (server->address);
   g_free (server->ssl_cert);
   g_free (server->ssl_key);
@@ -419,6 +478,26 @@ update_future_pointer_info (BroadwayServer *server, BroadwayInputPointerMsg *dat
   server->future_mouse_in_toplevel = data->mouse_window_id;
 }
 
+/* The client acknowledges the frames up to @serial once it showed them */
+static void
+broadway_server_frame_acked (BroadwayServer *server,
+                             guint32         serial)
+{
+  BroadwayFrameInFlight *frame;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  while ((frame = g_queue_peek_head (&server->frames_in_flight)) != NULL &&
+         (gint32)(serial - frame->serial) >= 0)
+    {
+      server->frame_latency = now - frame->sent_time;
+      server->n_frames_acked++;
+      g_free (g_queue_pop_head (&server->frames_in_flight));
+    }
+
+  broadway_server_encode_next (server);
+}
+
 static void
 parse_input_message (BroadwayInput *input, const unsigned char *message)
 {
@@ -435,6 +514,14 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
   msg.base.serial = ntohl (*p++);
   time_ = ntohl (*p++);
 
+  /* Not an event, this is only for us */
+  if (msg.base.type == BROADWAY_EVENT_FRAME_ACK)
+    {
+      if (input == server->input)
+        broadway_server_frame_acked (server, msg.base.serial);
+      return;
+    }
+
   if (time_ == 0) {
     time_ = server->last_seen_time;
   } else {
@@ -758,6 +845,10 @@ broadway_server_flush (BroadwayServer *server)
       server->saved_serial = broadway_output_get_next_serial (server->output);
       broadway_output_free (server->output);
       server->output = NULL;
+      broadway_server_clear_frames_in_flight (server);
+
+      /* Encoding may have been waiting for it */
+      broadway_server_encode_next (server);
     }
 }
 
@@ -1052,7 +1143,8 @@ start_input (HttpRequest *request)
   g_byte_array_append (input->buffer, data_buffer, data_buffer_size);
 
   input->output =
-    broadway_output_new (g_io_stream_get_output_stream (request->connection), 0);
+    broadway_output_new (g_io_stream_get_output_stream (request->connection), 0,
+                         request->server->compression_level);
 
   /* This will free and close the data input stream, but we got all the buffered content already */
   http_request_free (request);
@@ -1100,7 +1192,11 @@ start (BroadwayInput *input)
       broadway_output_free (server->output);
     }
   server->output = input->output;
+  broadway_server_clear_frames_in_flight (server);
 
+  broadway_output_set_written_func (server->output,
+                                    (BroadwayOutputWrittenFunc)broadway_server_encode_next,
+                                    server);
   broadway_output_set_next_serial (server->output, server->saved_serial);
   broadway_output_flush (server->output);
 
@@ -1136,6 +1232,42 @@ send_data (HttpRequest *request,
   http_request_free (request);
 }
 
+/* Plain text, one "name value" pair per line */
+static void
+send_stats (HttpRequest *request)
+{
+  BroadwayServer *server = request->server;
+  BroadwayWindow *window;
+  GString *stats;
+  GList *l;
+  int n_waiting;
+
+  n_waiting = 0;
+  for (l = server->toplevels; l != NULL; l = l->next)
+    {
+      window = l->data;
+      if (window->frame_pending)
+        n_waiting++;
+    }
+
+  stats = g_string_new (NULL);
+  g_string_append_printf (stats, "connected %d\n", server->output != NULL);
+  g_string_append_printf (stats, "compression-level %d\n", server->compression_level);
+  g_string_append_printf (stats, "updates %" G_GUINT64_FORMAT "\n", server->n_updates);
+  g_string_append_printf (stats, "merged-updates %" G_GUINT64_FORMAT "\n", server->n_merged_updates);
+  g_string_append_printf (stats, "queued-updates %u\n", g_queue_get_length (&server->encode_queue));
+  g_string_append_printf (stats, "waiting-windows %d\n", n_waiting);
+  g_string_append_printf (stats, "frames-sent %" G_GUINT64_FORMAT "\n", server->n_frames_sent);
+  g_string_append_printf (stats, "frames-acked %" G_GUINT64_FORMAT "\n", server->n_frames_acked);
+  g_string_append_printf (stats, "frames-in-flight %u\n", g_queue_get_length (&server->frames_in_flight));
+  g_string_append_printf (stats, "frame-latency-ms %.1f\n", server->frame_latency / 1000.0);
+  g_string_append_printf (stats, "queued-output-bytes %" G_GSIZE_FORMAT "\n",
+                          server->output ? broadway_output_get_queued_size (server->output) : 0);
+
+  send_data (request, "text/plain", stats->str, stats->len);
+  g_string_free (stats, TRUE);
+}
+
 #include "clienthtml.h"
 #include "broadwayjs.h"
 
@@ -1179,6 +1311,8 @@ got_request (HttpRequest *request)
     send_data (request, "text/javascript", broadway_js, G_N_ELEMENTS(broadway_js) - 1);
   else if (strcmp (escaped, "/socket") == 0)
     start_input (request);
+  else if (strcmp (escaped, "/stats") == 0)
+    send_stats (request);
   else
     send_error (request, 404, "File not found");
 
@@ -1453,15 +1587,33 @@ broadway_server_destroy_window (BroadwayServer *server,
 				GINT_TO_POINTER (id));
   if (window != NULL)
     {
+      GList *l, *next;
+
       server->toplevels = g_list_remove (server->toplevels, window);
       g_hash_table_remove (server->id_ht,
 			   GINT_TO_POINTER (id));
 
-      g_free (window->cached_surface_name);
-      if (window->cached_surface != NULL)
-	cairo_surface_destroy (window->cached_surface);
+      /* Drop the queued updates, they haven't written anything yet.
+       * A running one sends its update and frees the window. */
+      for (l = server->encode_queue.head; l != NULL; l = next)
+        {
+          BroadwayEncodeJob *job = l->data;
 
-      g_free (window);
+          next = l->next;
+          if (job->window != window)
+            continue;
+
+          if (job->output != NULL)
+            broadway_output_complete (job->output);
+          g_queue_delete_link (&server->encode_queue, l);
+          encode_job_free (job);
+          window->n_jobs--;
+        }
+
+      window->queued_update = NULL;
+      window->destroyed = TRUE;
+      if (window->n_jobs == 0)
+        broadway_window_free (window);
     }
 }
 
@@ -1588,19 +1740,278 @@ broadway_server_window_set_transient_for (BroadwayServer *server,
     }
 }
 
+/* Sets the zlib compression level, from 0 to 9 or -1 for the
+ * default, used for the window contents sent to new clients.
+ */
+void
+broadway_server_set_compression_level (BroadwayServer *server,
+                                       int             level)
+{
+  server->compression_level = level;
+}
+
 gboolean
 broadway_server_has_client (BroadwayServer *server)
 {
   return server->output != NULL;
 }
 
+static void
+broadway_window_free (BroadwayWindow *window)
+{
+  g_free (window->cached_surface_name);
+  if (window->cached_surface != NULL)
+    cairo_surface_destroy (window->cached_surface);
+  if (window->buffer != NULL)
+    broadway_buffer_destroy (window->buffer);
+
+  g_free (window);
+}
+
+static void
+encode_job_free (BroadwayEncodeJob *job)
+{
+  if (job->damage)
+    cairo_region_destroy (job->damage);
+  g_free (job->data);
+  g_free (job);
+}
+
+/* Runs in the encoder thread */
+static void
+encode_job_run (BroadwayEncodeJob *job)
+{
+  BroadwayWindow *window = job->window;
+  BroadwayBuffer *buffer;
+  cairo_rectangle_int_t rect;
+  int i;
+
+  if (job->resend)
+    {
+      window->buffer_synced = FALSE;
+      if (job->output != NULL && window->buffer != NULL)
+        {
+          window->buffer_synced = TRUE;
+          broadway_output_put_buffer (job->output, window->id,
+                                      NULL, window->buffer);
+        }
+    }
+  else if (job->damage != NULL)
+    {
+      /* The previous update had the same size */
+      g_assert (window->buffer != NULL);
+
+      if (job->output != NULL && window->buffer_synced)
+        broadway_output_put_buffer_rects (job->output, window->id,
+                                          window->buffer, job->damage,
+                                          job->data, job->width * 4);
+      else
+        {
+          for (i = 0; i < cairo_region_num_rectangles (job->damage); i++)
+            {
+              cairo_region_get_rectangle (job->damage, i, &rect);
+              broadway_buffer_update_rect (window->buffer, &rect,
+                                           job->data, job->width * 4,
+                                           NULL);
+            }
+
+          if (job->output != NULL)
+            {
+              window->buffer_synced = TRUE;
+              broadway_output_put_buffer (job->output, window->id,
+                                          NULL, window->buffer);
+            }
+        }
+    }
+  else
+    {
+      buffer = broadway_buffer_create (job->width, job->height,
+                                       job->data, job->width * 4);
+
+      if (job->output != NULL)
+        {
+          broadway_output_put_buffer (job->output, window->id,
+                                      window->buffer_synced ? window->buffer : NULL,
+                                      buffer);
+          window->buffer_synced = TRUE;
+        }
+
+      if (window->buffer)
+        broadway_buffer_destroy (window->buffer);
+
+      window->buffer = buffer;
+    }
+}
+
+static gboolean
+encode_job_done (gpointer data)
+{
+  BroadwayEncodeJob *job = data;
+  BroadwayServer *server = job->server;
+  BroadwayWindow *window = job->window;
+  BroadwayFrameInFlight *frame;
+
+  server->encoding = NULL;
+
+  /* Sent even if the window is gone: the client has to inflate it
+   * to keep up with the compressor, and only destroys the surface
+   * after it */
+  if (job->output != NULL &&
+      broadway_output_complete (job->output))
+    {
+      frame = g_new (BroadwayFrameInFlight, 1);
+      frame->serial = job->serial;
+      frame->sent_time = g_get_monotonic_time ();
+      g_queue_push_tail (&server->frames_in_flight, frame);
+      server->n_frames_sent++;
+    }
+
+  window->n_jobs--;
+  if (window->destroyed && window->n_jobs == 0)
+    broadway_window_free (window);
+
+  encode_job_free (job);
+
+  broadway_server_encode_next (server);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+encode_job (gpointer data,
+            gpointer user_data)
+{
+  encode_job_run (data);
+
+  g_main_context_invoke (NULL, encode_job_done, data);
+}
+
+static void
+broadway_server_clear_frames_in_flight (BroadwayServer *server)
+{
+  g_queue_foreach (&server->frames_in_flight, (GFunc)g_free, NULL);
+  g_queue_clear (&server->frames_in_flight);
+}
+
+static gboolean
+broadway_server_client_is_behind (BroadwayServer *server)
+{
+  return server->output != NULL &&
+    (broadway_output_get_queued_size (server->output) > MAX_QUEUED_OUTPUT ||
+     g_queue_get_length (&server->frames_in_flight) >= MAX_FRAMES_IN_FLIGHT);
+}
+
+/* Lets the clients paint the next frame of the windows whose last
+ * update is no longer queued. Until the web client catches up they
+ * keep waiting, so that they drop frames instead of drawing ones
+ * that would only get merged. */
+static void
+broadway_server_notify_frames (BroadwayServer *server)
+{
+  BroadwayInputMsg msg;
+  BroadwayWindow *window;
+  GList *l;
+
+  if (broadway_server_client_is_behind (server))
+    return;
+
+  for (l = server->toplevels; l != NULL; l = l->next)
+    {
+      window = l->data;
+      if (!window->frame_pending || window->queued_update != NULL)
+        continue;
+
+      window->frame_pending = FALSE;
+
+      memset (&msg, 0, sizeof (msg));
+      msg.base.type = BROADWAY_EVENT_FRAME_DONE;
+      msg.base.time = server->last_seen_time;
+      msg.frame_done.id = window->id;
+
+      broadway_events_got_input (&msg, -1);
+    }
+}
+
+static void
+broadway_server_encode_next (BroadwayServer *server)
+{
+  BroadwayEncodeJob *job;
+
+  /* While the client catches up, new updates of the queued windows
+   * get merged instead of being encoded and sent one after another */
+  if (server->encoding == NULL &&
+      !broadway_server_client_is_behind (server))
+    {
+      job = g_queue_pop_head (&server->encode_queue);
+      if (job != NULL)
+        {
+          if (job->window->queued_update == job)
+            job->window->queued_update = NULL;
+
+          server->encoding = job;
+          g_thread_pool_push (server->encoder, job, NULL);
+        }
+    }
+
+  broadway_server_notify_frames (server);
+}
+
+static BroadwayEncodeJob *
+broadway_server_queue_encode (BroadwayServer *server,
+                              BroadwayWindow *window,
+                              gboolean        send)
+{
+  BroadwayEncodeJob *job;
+
+  job = g_new0 (BroadwayEncodeJob, 1);
+  job->server = server;
+  job->window = window;
+  if (send && server->output != NULL)
+    {
+      job->output = broadway_output_defer (server->output);
+      job->serial = broadway_output_get_next_serial (job->output);
+    }
+
+  window->n_jobs++;
+  g_queue_push_tail (&server->encode_queue, job);
+
+  return job;
+}
+
+static void
+copy_surface_rect (BroadwayEncodeJob     *job,
+                   cairo_surface_t       *surface,
+                   cairo_rectangle_int_t *rect)
+{
+  guint8 *data;
+  int y, stride;
+
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  for (y = rect->y; y < rect->y + rect->height; y++)
+    memcpy (job->data + y * job->width * 4 + rect->x * 4,
+            data + y * stride + rect->x * 4,
+            rect->width * 4);
+}
+
+/* If @damage is non-%NULL only that part of the surface changed since
+ * the last update, and only that gets encoded and sent to the client.
+ *
+ * The surface is copied, the encoding happens later in the encoder
+ * thread. If the window already has an update waiting for that, the
+ * changes are added to it instead.
+ */
 void
 broadway_server_window_update (BroadwayServer *server,
 			       gint id,
-			       cairo_surface_t *surface)
+			       cairo_surface_t *surface,
+			       cairo_region_t *damage)
 {
   BroadwayWindow *window;
-  BroadwayBuffer *buffer;
+  BroadwayEncodeJob *job;
+  cairo_rectangle_int_t rect = { 0, 0, 0, 0 };
+  int i;
 
   if (surface == NULL)
     return;
@@ -1613,21 +2024,61 @@ broadway_server_window_update (BroadwayServer *server,
   g_assert (window->width == cairo_image_surface_get_width (surface));
   g_assert (window->height == cairo_image_surface_get_height (surface));
 
-  buffer = broadway_buffer_create (window->width, window->height,
-                                   cairo_image_surface_get_data (surface),
-                                   cairo_image_surface_get_stride (surface));
+  rect.width = window->width;
+  rect.height = window->height;
 
-  if (server->output != NULL)
+  /* Partial updates need the rest from an update of the same size */
+  if (window->content_width == window->width &&
+      window->content_height == window->height &&
+      damage != NULL)
     {
-      window->buffer_synced = TRUE;
-      broadway_output_put_buffer (server->output, window->id,
-                                  window->buffer, buffer);
+      damage = cairo_region_copy (damage);
+      cairo_region_intersect_rectangle (damage, &rect);
     }
+  else
+    damage = NULL;
 
-  if (window->buffer)
-    broadway_buffer_destroy (window->buffer);
+  server->n_updates++;
+  window->frame_pending = TRUE;
+
+  job = window->queued_update;
+  if (job == NULL ||
+      job->width != window->width || job->height != window->height)
+    {
+      job = broadway_server_queue_encode (server, window, TRUE);
+      job->width = window->width;
+      job->height = window->height;
+      job->data = g_malloc (job->width * job->height * 4);
+      job->damage = damage ? cairo_region_copy (damage) : NULL;
 
-  window->buffer = buffer;
+      window->queued_update = job;
+    }
+  else
+    {
+      server->n_merged_updates++;
+
+      if (damage == NULL)
+        g_clear_pointer (&job->damage, cairo_region_destroy);
+      else if (job->damage != NULL)
+        cairo_region_union (job->damage, damage);
+    }
+
+  if (damage != NULL)
+    {
+      for (i = 0; i < cairo_region_num_rectangles (damage); i++)
+        {
+          cairo_region_get_rectangle (damage, i, &rect);
+          copy_surface_rect (job, surface, &rect);
+        }
+      cairo_region_destroy (damage);
+    }
+  else
+    copy_surface_rect (job, surface, &rect);
+
+  window->content_width = window->width;
+  window->content_height = window->height;
+
+  broadway_server_encode_next (server);
 }
 
 gboolean
@@ -1887,7 +2338,6 @@ broadway_server_resync_windows (BroadwayServer *server)
       if (window->id == 0)
 	continue; /* Skip root */
 
-      window->buffer_synced = FALSE;
       broadway_output_new_surface (server->output,
 				   window->id,
 				   window->x,
@@ -1908,18 +2358,21 @@ broadway_server_resync_windows (BroadwayServer *server)
       if (window->transient_for != -1)
 	broadway_output_set_transient_for (server->output, window->id, window->transient_for);
       if (window->visible)
+	broadway_output_show_surface (server->output, window->id);
+
+      /* The client has none of the contents, so send them again in
+       * full, after all the queued updates */
+      if (window->content_width > 0)
 	{
-	  broadway_output_show_surface (server->output, window->id);
+	  BroadwayEncodeJob *job;
 
-	  if (window->buffer != NULL)
-	    {
-	      window->buffer_synced = TRUE;
-              broadway_output_put_buffer (server->output, window->id,
-                                          NULL, window->buffer);
-	    }
+	  job = broadway_server_queue_encode (server, window, window->visible);
+	  job->resend = TRUE;
 	}
     }
 
+  broadway_server_encode_next (server);
+
   if (server->show_keyboard)
     broadway_output_set_show_keyboard (server->output, TRUE);
 
@@ -26,6 +26,8 @@ BroadwayServer     *broadway_server_new                      (char             *
 							      GError          **error);
 BroadwayServer     *broadway_server_on_unix_socket_new       (char             *address,
 							      GError          **error);
+void                broadway_server_set_compression_level    (BroadwayServer   *server,
+							      int               level);
 gboolean            broadway_server_has_client               (BroadwayServer   *server);
 void                broadway_server_flush                    (BroadwayServer   *server);
 void                broadway_server_sync                     (BroadwayServer   *server);
@@ -80,7 +82,8 @@ cairo_surface_t   * broadway_server_create_surface           (int
 							      int               height);
 void                broadway_server_window_update            (BroadwayServer   *server,
 							      gint              id,
-							      cairo_surface_t  *surface);
+							      cairo_surface_t  *surface,
+							      cairo_region_t   *damage);
 gboolean            broadway_server_window_move_resize       (BroadwayServer   *server,
 							      gint              id,
 							      gboolean          with_move,
@@ -103,6 +103,7 @@ var stackingOrder = [];
 var outstandingCommands = new Array();
 var inputSocket = null;
 var debugDecoding = false;
+var inflater = null;
 var fakeInput = null;
 var showKeyboard = false;
 var showKeyboardChanged = false;
@@ -513,11 +514,14 @@ function decodeBuffer(context, oldData, w, h, data, debug)
 
 function cmdPutBuffer(id, w, h, compressed)
 {
+    // Always inflate, the following buffers depend on the stream state
+    var data = inflater.inflate(compressed);
+
     var surface = surfaces[id];
-    var context = surface.canvas.getContext("2d");
+    if (surface == undefined)
+        return;
 
-    var inflate = new Zlib.RawInflate(compressed);
-    var data = inflate.decompress();
+    var context = surface.canvas.getContext("2d");
 
     var imageData = decodeBuffer (context, surface.imageData, w, h, data, debugDecoding);
     context.putImageData(imageData, 0, 0);
@@ -528,6 +532,37 @@ function cmdPutBuffer(id, w, h, compressed)
     surface.imageData = imageData;
 }
 
+function cmdPutBufferRects(id, rects, compressed)
+{
+    // Always inflate, the following buffers depend on the stream state
+    var data = inflater.inflate(compressed);
+
+    var surface = surfaces[id];
+    if (surface == undefined)
+        return;
+
+    var context = surface.canvas.getContext("2d");
+
+    var offset = 0;
+    for (var i = 0; i < rects.length; i++) {
+        var r = rects[i];
+        var rectData = data.subarray(offset, offset + r.len);
+        offset += r.len;
+
+        // The rects are encoded as deltas against the old content
+        var oldData = context.createImageData(r.w, r.h);
+        copyRect(surface.imageData, r.x, r.y, oldData, 0, 0, r.w, r.h);
+
+        var imageData = decodeBuffer (context, oldData, r.w, r.h, rectData, debugDecoding);
+        context.putImageData(imageData, r.x, r.y);
+
+        if (debugDecoding)
+            imageData = decodeBuffer (context, oldData, r.w, r.h, rectData, false);
+
+        copyRect(imageData, 0, 0, surface.imageData, r.x, r.y, r.w, r.h);
+    }
+}
+
 function cmdGrabPointer(id, ownerEvents)
 {
     doGrab(id, ownerEvents, false);
@@ -549,6 +584,7 @@ function handleCommands(cmd)
         active = true;
     }
 
+    var gotFrame = false;
     while (cmd.pos < cmd.length) {
 	var id, x, y, w, h, q;
 	var command = cmd.get_char();
@@ -622,6 +658,25 @@ function handleCommands(cmd)
 	    h = cmd.get_16();
             var data = cmd.get_data();
             cmdPutBuffer(id, w, h, data);
+            gotFrame = true;
+            break;
+
+	case 'P': // Put image buffer rects
+	    id = cmd.get_16();
+	    var nrects = cmd.get_16();
+	    var rects = [];
+	    for (var r = 0; r < nrects; r++) {
+		var rect = {};
+		rect.x = cmd.get_16();
+		rect.y = cmd.get_16();
+		rect.w = cmd.get_16();
+		rect.h = cmd.get_16();
+		rect.len = cmd.get_32();
+		rects.push(rect);
+	    }
+            var data = cmd.get_data();
+            cmdPutBufferRects(id, rects, data);
+            gotFrame = true;
             break;
 
 	case 'g': // Grab
@@ -644,6 +699,11 @@ function handleCommands(cmd)
 	    alert("Unknown op " + command);
 	}
     }
+
+    // The server doesn't send more frames until we catch up
+    if (gotFrame)
+	sendInput ("F", []);
+
     return true;
 }
 
@@ -2616,6 +2676,8 @@ function connect()
     loc = loc.substr(0, loc.lastIndexOf('/')) + "/socket";
     ws = new WebSocket(loc, "broadway");
     ws.binaryType = "arraybuffer";
+    // The server starts a new compression stream for each connection
+    inflater = new InflateStream();
 
     ws.onopen = function() {
 	inputSocket = ws;
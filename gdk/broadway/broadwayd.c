@@ -262,9 +262,35 @@ client_handle_request (BroadwayClient *client,
 					      request->update.height);
       if (surface != NULL)
 	{
+	  cairo_region_t *damage = NULL;
+	  guint32 i;
+
+	  /* Don't trust the client with the number of rects, a bad
+	     one just makes the whole window change */
+	  if (request->update.n_rects > 0 &&
+	      request->update.n_rects <= BROADWAY_MAX_UPDATE_RECTS &&
+	      request->base.size >= G_STRUCT_OFFSET (BroadwayRequestUpdate, rects) +
+				    request->update.n_rects * sizeof (BroadwayRect))
+	    {
+	      damage = cairo_region_create ();
+	      for (i = 0; i < request->update.n_rects; i++)
+		{
+		  cairo_rectangle_int_t rect;
+
+		  rect.x = request->update.rects[i].x;
+		  rect.y = request->update.rects[i].y;
+		  rect.width = request->update.rects[i].width;
+		  rect.height = request->update.rects[i].height;
+		  cairo_region_union_rectangle (damage, &rect);
+		}
+	    }
+
 	  broadway_server_window_update (server,
 					 request->update.id,
-					 surface);
+					 surface,
+					 damage);
+	  if (damage)
+	    cairo_region_destroy (damage);
 	  cairo_surface_destroy (surface);
 	}
       break;
@@ -350,6 +376,8 @@ client_fill_cb (GObject *source_object,
 	      remaining -= size;
 	      buffer += size;
 	    }
+	  else
+	    break;
 	}
       
       /* This is guaranteed not to block */
@@ -421,6 +449,7 @@ main (int argc, char *argv[])
   int http_port = 0;
   char *ssl_cert = NULL;
   char *ssl_key = NULL;
+  int compression_level = -1;
   char *display;
   int port = 0;
   const GOptionEntry entries[] = {
@@ -431,6 +460,7 @@ main (int argc, char *argv[])
 #endif
     { "cert", 'c', 0, G_OPTION_ARG_STRING, &ssl_cert, "SSL certificate path", "PATH" },
     { "key", 'k', 0, G_OPTION_ARG_STRING, &ssl_key, "SSL key path", "PATH" },
+    { "compression-level", 'z', 0, G_OPTION_ARG_INT, &compression_level, "zlib compression level, from 0 to 9", "LEVEL" },
     { NULL }
   };
 
@@ -444,6 +474,12 @@ main (int argc, char *argv[])
       exit (1);
     }
 
+  if (compression_level < -1 || compression_level > 9)
+    {
+      g_printerr ("Compression level must be between 0 and 9\n");
+      exit (1);
+    }
+
   display = NULL;
   if (argc > 1)
     {
@@ -514,6 +550,8 @@ main (int argc, char *argv[])
       return 1;
     }
 
+  broadway_server_set_compression_level (server, compression_level);
+
   listener = g_socket_service_new ();
   if (!g_socket_listener_add_address (G_SOCKET_LISTENER (listener),
 				      address,
@@ -568,6 +606,8 @@ get_event_size (int type)
       return sizeof (BroadwayInputScreenResizeNotify);
     case BROADWAY_EVENT_FOCUS:
       return sizeof (BroadwayInputFocusMsg);
+    case BROADWAY_EVENT_FRAME_DONE:
+      return sizeof (BroadwayInputFrameDoneMsg);
     default:
       g_assert_not_reached ();
     }
@@ -728,13 +728,20 @@ _gdk_broadway_server_create_surface (int                 width,
   return surface;
 }
 
+/* Only the parts of the surface in @damage get sent to the client,
+ * or all of it if @damage is %NULL.
+ */
 void
 _gdk_broadway_server_window_update (GdkBroadwayServer *server,
 				    gint id,
-				    cairo_surface_t *surface)
+				    cairo_surface_t *surface,
+				    cairo_region_t *damage)
 {
-  BroadwayRequestUpdate msg;
+  BroadwayRequestUpdate *msg;
   BroadwayShmSurfaceData *data;
+  cairo_rectangle_int_t rect;
+  gsize size;
+  int i, n_rects;
 
   if (surface == NULL)
     return;
@@ -742,13 +749,35 @@ _gdk_broadway_server_window_update (GdkBroadwayServer *server,
   data = cairo_surface_get_user_data (surface, &gdk_broadway_shm_cairo_key);
   g_assert (data != NULL);
 
-  msg.id = id;
-  memcpy (msg.name, data->name, 36);
-  msg.width = cairo_image_surface_get_width (surface);
-  msg.height = cairo_image_surface_get_height (surface);
+  n_rects = damage ? cairo_region_num_rectangles (damage) : 0;
+  if (n_rects > BROADWAY_MAX_UPDATE_RECTS)
+    n_rects = 1;
 
-  gdk_broadway_server_send_message (server, msg,
-				    BROADWAY_REQUEST_UPDATE);
+  size = sizeof (BroadwayRequestUpdate) + sizeof (BroadwayRect) * MAX (n_rects - 1, 0);
+  msg = g_malloc0 (size);
+
+  msg->id = id;
+  memcpy (msg->name, data->name, 36);
+  msg->width = cairo_image_surface_get_width (surface);
+  msg->height = cairo_image_surface_get_height (surface);
+  msg->n_rects = n_rects;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      if (n_rects < cairo_region_num_rectangles (damage))
+        cairo_region_get_extents (damage, &rect);
+      else
+        cairo_region_get_rectangle (damage, i, &rect);
+
+      msg->rects[i].x = rect.x;
+      msg->rects[i].y = rect.y;
+      msg->rects[i].width = rect.width;
+      msg->rects[i].height = rect.height;
+    }
+
+  gdk_broadway_server_send_message_with_size (server, (BroadwayRequestBase *) msg, size,
+                                              BROADWAY_REQUEST_UPDATE);
+  g_free (msg);
 }
 
 gboolean
@@ -383,6 +383,12 @@ _gdk_broadway_events_got_input (BroadwayInputMsg *message)
       }
     break;
 
+  case BROADWAY_EVENT_FRAME_DONE:
+    window = g_hash_table_lookup (display_broadway->id_ht, GINT_TO_POINTER (message->frame_done.id));
+    if (window)
+      _gdk_broadway_window_frame_done (window);
+    break;
+
   default:
     g_printerr ("_gdk_broadway_events_got_input - Unknown input command %c\n", message->base.type);
     break;
@@ -37,6 +37,7 @@
 #include "gdkinternals.h"
 #include "gdkdeviceprivate.h"
 #include "gdkeventsource.h"
+#include "gdkframeclockprivate.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -126,7 +127,17 @@ update_dirty_windows_and_sync (void)
 	  updated_surface = TRUE;
 	  _gdk_broadway_server_window_update (display->server,
 					      impl->id,
-					      impl->surface);
+					      impl->surface,
+					      impl->damage);
+	  g_clear_pointer (&impl->damage, cairo_region_destroy);
+
+	  /* Don't paint the next frame until broadwayd is ready for
+	     it, so that a slow client drops frames instead of lagging */
+	  if (impl->surface != NULL && !impl->frame_pending)
+	    {
+	      impl->frame_pending = TRUE;
+	      _gdk_frame_clock_freeze (gdk_window_get_frame_clock (impl->wrapper));
+	    }
 	}
     }
 
@@ -195,6 +206,8 @@ gdk_window_impl_broadway_finalize (GObject *object)
 
   g_hash_table_destroy (impl->device_cursor);
 
+  g_clear_pointer (&impl->damage, cairo_region_destroy);
+
   broadway_display->toplevels = g_list_remove (broadway_display->toplevels, impl);
 
   G_OBJECT_CLASS (gdk_window_impl_broadway_parent_class)->finalize (object);
@@ -245,6 +258,18 @@ on_frame_clock_after_paint (GdkFrameClock *clock,
   update_dirty_windows_and_sync ();
 }
 
+void
+_gdk_broadway_window_frame_done (GdkWindow *window)
+{
+  GdkWindowImplBroadway *impl = GDK_WINDOW_IMPL_BROADWAY (window->impl);
+
+  if (impl->frame_pending)
+    {
+      impl->frame_pending = FALSE;
+      _gdk_frame_clock_thaw (gdk_window_get_frame_clock (window));
+    }
+}
+
 static void
 connect_frame_clock (GdkWindow *window)
 {
@@ -498,6 +523,7 @@ gdk_window_broadway_move_resize (GdkWindow *window,
 
 	  /* Resize clears the content */
 	  impl->dirty = TRUE;
+	  g_clear_pointer (&impl->damage, cairo_region_destroy);
 	  impl->last_synced = FALSE;
 
 	  window->width = width;
@@ -1047,6 +1073,12 @@ gdk_broadway_window_end_paint (GdkWindow *window)
 {
   GdkWindowImplBroadway *impl;
   impl = GDK_WINDOW_IMPL_BROADWAY (window->impl);
+
+  if (!impl->dirty)
+    impl->damage = cairo_region_copy (window->current_paint.region);
+  else if (impl->damage)
+    cairo_region_union (impl->damage, window->current_paint.region);
+
   impl->dirty = TRUE;
 }
 
@@ -69,6 +69,8 @@ struct _GdkWindowImplBroadway
 
   gint8 toplevel_window_type;
   gboolean dirty;
+  cairo_region_t *damage; /* What is dirty, NULL for everything */
+  gboolean frame_pending; /* The frame clock waits for broadwayd */
   gboolean last_synced;
 
   GdkGeometry geometry_hints;
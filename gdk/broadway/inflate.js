@@ -0,0 +1,285 @@
+/* Streaming raw inflate (RFC 1951)
+ *
+ * broadwayd compresses all the buffers it sends over a connection as
+ * one deflate stream, flushing it after each buffer, so that a buffer
+ * can refer back to the data of the ones before it. Each message thus
+ * ends on a block boundary, and decompressing it needs the last 32k
+ * of output from the previous messages.
+ */
+
+var inflateLengthBase = [
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 ];
+var inflateLengthExtra = [
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 ];
+var inflateDistBase = [
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577 ];
+var inflateDistExtra = [
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 ];
+var inflateCodeLengthOrder = [
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 ];
+
+var inflateWindowSize = 32768;
+var inflateFixedLit = null;
+var inflateFixedDist = null;
+
+/* Builds a table indexed by the next maxLen bits of input, whose
+ * entries are the length of the code in the upper 16 bits and the
+ * symbol in the lower ones. */
+function inflateBuildTable(lengths)
+{
+    var n = lengths.length;
+    var maxLen = 0;
+    var count = new Uint16Array(16);
+    var next = new Uint16Array(16);
+    var i, j, len, code, rev;
+
+    for (i = 0; i < n; i++) {
+        count[lengths[i]]++;
+        if (lengths[i] > maxLen)
+            maxLen = lengths[i];
+    }
+    count[0] = 0;
+
+    code = 0;
+    for (len = 1; len < 16; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+
+    var size = 1 << maxLen;
+    var codes = new Uint32Array(size);
+    for (i = 0; i < n; i++) {
+        len = lengths[i];
+        if (len == 0)
+            continue;
+
+        // Codes are packed starting with the most significant bit
+        code = next[len]++;
+        rev = 0;
+        for (j = 0; j < len; j++) {
+            rev = (rev << 1) | (code & 1);
+            code >>= 1;
+        }
+
+        for (j = rev; j < size; j += 1 << len)
+            codes[j] = (len << 16) | i;
+    }
+
+    return { codes: codes, maxLen: maxLen };
+}
+
+function inflateBuildFixedTables()
+{
+    var lengths = new Uint8Array(288);
+    var i;
+
+    for (i = 0; i < 144; i++)
+        lengths[i] = 8;
+    for (; i < 256; i++)
+        lengths[i] = 9;
+    for (; i < 280; i++)
+        lengths[i] = 7;
+    for (; i < 288; i++)
+        lengths[i] = 8;
+    inflateFixedLit = inflateBuildTable(lengths);
+
+    lengths = new Uint8Array(30);
+    for (i = 0; i < 30; i++)
+        lengths[i] = 5;
+    inflateFixedDist = inflateBuildTable(lengths);
+}
+
+function InflateStream()
+{
+    this.history = new Uint8Array(0);
+}
+
+InflateStream.prototype.getBits = function(n)
+{
+    while (this.bitCount < n) {
+        if (this.pos >= this.input.length)
+            throw new Error("Unexpected end of compressed data");
+        this.bitBuf |= this.input[this.pos++] << this.bitCount;
+        this.bitCount += 8;
+    }
+
+    var v = this.bitBuf & ((1 << n) - 1);
+    this.bitBuf >>>= n;
+    this.bitCount -= n;
+    return v;
+};
+
+InflateStream.prototype.decodeSymbol = function(table)
+{
+    // Near the end of the input the missing bits are zero
+    while (this.bitCount < table.maxLen && this.pos < this.input.length) {
+        this.bitBuf |= this.input[this.pos++] << this.bitCount;
+        this.bitCount += 8;
+    }
+
+    var entry = table.codes[this.bitBuf & ((1 << table.maxLen) - 1)];
+    var len = entry >>> 16;
+    if (len == 0 || len > this.bitCount)
+        throw new Error("Invalid compressed data");
+
+    this.bitBuf >>>= len;
+    this.bitCount -= len;
+    return entry & 0xffff;
+};
+
+InflateStream.prototype.ensureSpace = function(n)
+{
+    if (this.outPos + n <= this.out.length)
+        return;
+
+    var out = new Uint8Array(Math.max(this.out.length * 2, this.outPos + n));
+    out.set(this.out.subarray(0, this.outPos));
+    this.out = out;
+};
+
+InflateStream.prototype.inflateStored = function()
+{
+    // Skip to the byte boundary
+    this.getBits(this.bitCount & 7);
+
+    var len = this.getBits(16);
+    var nlen = this.getBits(16);
+    if ((len ^ 0xffff) != nlen)
+        throw new Error("Invalid stored block length");
+
+    this.ensureSpace(len);
+    while (len > 0 && this.bitCount > 0) {
+        this.out[this.outPos++] = this.getBits(8);
+        len--;
+    }
+
+    if (this.pos + len > this.input.length)
+        throw new Error("Unexpected end of compressed data");
+    this.out.set(this.input.subarray(this.pos, this.pos + len), this.outPos);
+    this.pos += len;
+    this.outPos += len;
+};
+
+InflateStream.prototype.inflateDynamicTables = function()
+{
+    var nlit = this.getBits(5) + 257;
+    var ndist = this.getBits(5) + 1;
+    var ncode = this.getBits(4) + 4;
+    var lengths = new Uint8Array(19);
+    var i, sym, rep, val;
+
+    for (i = 0; i < ncode; i++)
+        lengths[inflateCodeLengthOrder[i]] = this.getBits(3);
+    var codeTable = inflateBuildTable(lengths);
+
+    lengths = new Uint8Array(nlit + ndist);
+    for (i = 0; i < nlit + ndist;) {
+        sym = this.decodeSymbol(codeTable);
+        if (sym < 16) {
+            lengths[i++] = sym;
+            continue;
+        }
+
+        val = 0;
+        if (sym == 16) {
+            if (i == 0)
+                throw new Error("Invalid code lengths");
+            val = lengths[i - 1];
+            rep = 3 + this.getBits(2);
+        } else if (sym == 17) {
+            rep = 3 + this.getBits(3);
+        } else {
+            rep = 11 + this.getBits(7);
+        }
+
+        if (i + rep > nlit + ndist)
+            throw new Error("Invalid code lengths");
+        while (rep-- > 0)
+            lengths[i++] = val;
+    }
+
+    this.litTable = inflateBuildTable(lengths.subarray(0, nlit));
+    this.distTable = inflateBuildTable(lengths.subarray(nlit));
+};
+
+InflateStream.prototype.inflateCodes = function()
+{
+    var sym, len, dist, i;
+
+    for (;;) {
+        sym = this.decodeSymbol(this.litTable);
+        if (sym < 256) {
+            this.ensureSpace(1);
+            this.out[this.outPos++] = sym;
+        } else if (sym == 256) {
+            return;
+        } else {
+            sym -= 257;
+            if (sym >= 29)
+                throw new Error("Invalid length code");
+            len = inflateLengthBase[sym] + this.getBits(inflateLengthExtra[sym]);
+
+            sym = this.decodeSymbol(this.distTable);
+            if (sym >= 30)
+                throw new Error("Invalid distance code");
+            dist = inflateDistBase[sym] + this.getBits(inflateDistExtra[sym]);
+            if (dist > this.outPos)
+                throw new Error("Distance too far back");
+
+            // Copy byte by byte, as the source can overlap the destination
+            this.ensureSpace(len);
+            for (i = 0; i < len; i++) {
+                this.out[this.outPos] = this.out[this.outPos - dist];
+                this.outPos++;
+            }
+        }
+    }
+};
+
+/* Returns the data of the next flushed chunk of the stream */
+InflateStream.prototype.inflate = function(input)
+{
+    var start = this.history.length;
+    var type;
+
+    this.input = input;
+    this.pos = 0;
+    this.bitBuf = 0;
+    this.bitCount = 0;
+    this.out = new Uint8Array(start + Math.max(input.length * 4, 1024));
+    this.out.set(this.history);
+    this.outPos = start;
+
+    while (this.pos < this.input.length || this.bitCount >= 8) {
+        this.getBits(1); // BFINAL, the stream is never finished
+        type = this.getBits(2);
+
+        if (type == 0) {
+            this.inflateStored();
+        } else if (type == 1) {
+            if (inflateFixedLit == null)
+                inflateBuildFixedTables();
+            this.litTable = inflateFixedLit;
+            this.distTable = inflateFixedDist;
+            this.inflateCodes();
+        } else if (type == 2) {
+            this.inflateDynamicTables();
+            this.inflateCodes();
+        } else {
+            throw new Error("Invalid block type");
+        }
+    }
+
+    this.history = this.out.slice(Math.max(this.outPos - inflateWindowSize, 0), this.outPos);
+    var data = this.out.subarray(start, this.outPos);
+
+    this.input = null;
+    this.out = null;
+
+    return data;
+};
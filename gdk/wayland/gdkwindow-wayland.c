@@ -67,6 +67,8 @@ struct _GdkWaylandWindowClass
   GdkWindowClass parent_class;
 };
 
+#define MAX_DAMAGE_HISTORY 4
+
 G_DEFINE_TYPE (GdkWaylandWindow, gdk_wayland_window, GDK_TYPE_WINDOW)
 
 static void
@@ -123,6 +125,17 @@ struct _GdkWindowImplWayland
   cairo_surface_t *staging_cairo_surface;
   cairo_surface_t *committed_cairo_surface;
   cairo_surface_t *backfill_cairo_surface;
+  cairo_surface_t *spare_cairo_surface;
+
+  /* What changed in the last commits, most recent first, so that
+   * older buffers can be brought up to date by back filling only
+   * those parts.
+   */
+  cairo_region_t *damage_history[MAX_DAMAGE_HISTORY];
+  cairo_region_t *pending_damage_region;
+  cairo_region_t *stale_region;
+  guint commit_serial;
+  guint first_reusable_serial;
 
   int pending_buffer_offset_x;
   int pending_buffer_offset_y;
@@ -175,6 +188,9 @@ static void maybe_set_gtk_surface_modal (GdkWindow *window);
 
 static void gdk_window_request_transient_parent_commit (GdkWindow *window);
 
+static void keep_spare_cairo_surface (GdkWindowImplWayland *impl,
+                                      cairo_surface_t      *cairo_surface);
+
 GType _gdk_window_impl_wayland_get_type (void);
 
 G_DEFINE_TYPE (GdkWindowImplWayland, _gdk_window_impl_wayland, GDK_TYPE_WINDOW_IMPL)
@@ -196,6 +212,18 @@ _gdk_wayland_screen_add_orphan_dialog (GdkWindow *window)
     orphan_dialogs = g_list_prepend (orphan_dialogs, window);
 }
 
+static void
+clear_damage_history (GdkWindowImplWayland *impl)
+{
+  int i;
+
+  for (i = 0; i < MAX_DAMAGE_HISTORY; i++)
+    g_clear_pointer (&impl->damage_history[i], cairo_region_destroy);
+
+  g_clear_pointer (&impl->pending_damage_region, cairo_region_destroy);
+  g_clear_pointer (&impl->stale_region, cairo_region_destroy);
+}
+
 static void
 drop_cairo_surfaces (GdkWindow *window)
 {
@@ -203,11 +231,15 @@ drop_cairo_surfaces (GdkWindow *window)
 
   g_clear_pointer (&impl->staging_cairo_surface, cairo_surface_destroy);
   g_clear_pointer (&impl->backfill_cairo_surface, cairo_surface_destroy);
+  g_clear_pointer (&impl->spare_cairo_surface, cairo_surface_destroy);
 
   /* We nullify this so if a buffer release comes in later, we won't
    * try to reuse that buffer since it's no longer suitable
    */
   impl->committed_cairo_surface = NULL;
+  impl->first_reusable_serial = impl->commit_serial + 1;
+
+  clear_damage_history (impl);
 }
 
 /*
@@ -356,6 +388,8 @@ fill_presentation_time_from_frame_time (GdkFrameTimings *timings,
     }
 }
 
+static const cairo_user_data_key_t gdk_wayland_window_commit_serial_key;
+
 static void
 read_back_cairo_surface (GdkWindow *window)
 {
@@ -367,6 +401,8 @@ read_back_cairo_surface (GdkWindow *window)
     goto out;
 
   paint_region = cairo_region_copy (window->clip_region);
+  if (impl->stale_region)
+    cairo_region_intersect (paint_region, impl->stale_region);
   cairo_region_subtract (paint_region, impl->staged_updates_region);
 
   if (cairo_region_is_empty (paint_region))
@@ -385,6 +421,21 @@ out:
   g_clear_pointer (&paint_region, cairo_region_destroy);
   g_clear_pointer (&impl->staged_updates_region, cairo_region_destroy);
   g_clear_pointer (&impl->backfill_cairo_surface, cairo_surface_destroy);
+  g_clear_pointer (&impl->stale_region, cairo_region_destroy);
+}
+
+static void
+push_damage_history (GdkWindowImplWayland *impl)
+{
+  int i;
+
+  g_clear_pointer (&impl->damage_history[MAX_DAMAGE_HISTORY - 1], cairo_region_destroy);
+  for (i = MAX_DAMAGE_HISTORY - 1; i > 0; i--)
+    impl->damage_history[i] = impl->damage_history[i - 1];
+
+  impl->damage_history[0] = g_steal_pointer (&impl->pending_damage_region);
+  if (impl->damage_history[0] == NULL)
+    impl->damage_history[0] = cairo_region_create ();
 }
 
 static void
@@ -504,7 +555,15 @@ on_frame_clock_after_paint (GdkFrameClock *clock,
   wl_surface_commit (impl->display_server.wl_surface);
 
   if (impl->pending_buffer_attached)
-    impl->committed_cairo_surface = g_steal_pointer (&impl->staging_cairo_surface);
+    {
+      impl->commit_serial++;
+      push_damage_history (impl);
+      cairo_surface_set_user_data (impl->staging_cairo_surface,
+                                   &gdk_wayland_window_commit_serial_key,
+                                   GUINT_TO_POINTER (impl->commit_serial),
+                                   NULL);
+      impl->committed_cairo_surface = g_steal_pointer (&impl->staging_cairo_surface);
+    }
 
   impl->pending_buffer_attached = FALSE;
   impl->pending_commit = FALSE;
@@ -670,7 +729,7 @@ buffer_release_callback (void             *_data,
        */
       g_warn_if_fail (impl->staging_cairo_surface != cairo_surface);
 
-      cairo_surface_destroy (cairo_surface);
+      keep_spare_cairo_surface (impl, cairo_surface);
       return;
     }
 
@@ -685,7 +744,7 @@ buffer_release_callback (void             *_data,
        */
       g_warn_if_fail (!cairo_region_is_empty (impl->staged_updates_region));
 
-      g_clear_pointer (&impl->committed_cairo_surface, cairo_surface_destroy);
+      keep_spare_cairo_surface (impl, g_steal_pointer (&impl->committed_cairo_surface));
       return;
     }
 
@@ -699,6 +758,66 @@ static const struct wl_buffer_listener buffer_listener = {
   buffer_release_callback
 };
 
+/* Takes the surface in place of the current spare one if it has
+ * been committed more recently, so that as little as possible has
+ * to be back filled when it gets staged again.
+ */
+static void
+keep_spare_cairo_surface (GdkWindowImplWayland *impl,
+                          cairo_surface_t      *cairo_surface)
+{
+  guint serial, spare_serial;
+
+  serial = GPOINTER_TO_UINT (cairo_surface_get_user_data (cairo_surface,
+                                                          &gdk_wayland_window_commit_serial_key));
+
+  if (impl->spare_cairo_surface)
+    spare_serial = GPOINTER_TO_UINT (cairo_surface_get_user_data (impl->spare_cairo_surface,
+                                                                  &gdk_wayland_window_commit_serial_key));
+  else
+    spare_serial = 0;
+
+  if (serial < impl->first_reusable_serial || serial <= spare_serial)
+    {
+      cairo_surface_destroy (cairo_surface);
+      return;
+    }
+
+  g_clear_pointer (&impl->spare_cairo_surface, cairo_surface_destroy);
+  impl->spare_cairo_surface = cairo_surface;
+}
+
+/* Stages the spare surface, which is missing the damage of all the
+ * commits after its own.
+ */
+static void
+stage_spare_cairo_surface (GdkWindowImplWayland *impl)
+{
+  guint serial, age, i;
+
+  serial = GPOINTER_TO_UINT (cairo_surface_get_user_data (impl->spare_cairo_surface,
+                                                          &gdk_wayland_window_commit_serial_key));
+  age = impl->commit_serial - serial;
+
+  impl->staging_cairo_surface = g_steal_pointer (&impl->spare_cairo_surface);
+
+  g_clear_pointer (&impl->stale_region, cairo_region_destroy);
+  if (age > MAX_DAMAGE_HISTORY)
+    return;
+
+  impl->stale_region = cairo_region_create ();
+  for (i = 0; i < age; i++)
+    {
+      if (impl->damage_history[i] == NULL)
+        {
+          g_clear_pointer (&impl->stale_region, cairo_region_destroy);
+          return;
+        }
+
+      cairo_region_union (impl->stale_region, impl->damage_history[i]);
+    }
+}
+
 static void
 gdk_wayland_window_ensure_cairo_surface (GdkWindow *window)
 {
@@ -717,6 +836,10 @@ gdk_wayland_window_ensure_cairo_surface (GdkWindow *window)
       cairo_surface_set_device_scale (impl->staging_cairo_surface,
                                       impl->scale, impl->scale);
     }
+  else if (!impl->staging_cairo_surface && impl->spare_cairo_surface)
+    {
+      stage_spare_cairo_surface (impl);
+    }
   else if (!impl->staging_cairo_surface)
     {
       GdkWaylandDisplay *display_wayland = GDK_WAYLAND_DISPLAY (gdk_window_get_display (impl->wrapper));
@@ -792,18 +915,20 @@ gdk_window_impl_wayland_end_paint (GdkWindow *window)
        * fill the unstaged parts of the staging buffer with the
        * last frame.
        */
-      if (impl->committed_cairo_surface != NULL)
+      if (impl->staged_updates_region != NULL)
         {
-          if (impl->staged_updates_region == NULL)
-            {
-              impl->staged_updates_region = cairo_region_copy (window->current_paint.region);
-              impl->backfill_cairo_surface = cairo_surface_reference (impl->committed_cairo_surface);
-            }
-          else
-            {
-              cairo_region_union (impl->staged_updates_region, window->current_paint.region);
-            }
+          cairo_region_union (impl->staged_updates_region, window->current_paint.region);
         }
+      else if (impl->committed_cairo_surface != NULL)
+        {
+          impl->staged_updates_region = cairo_region_copy (window->current_paint.region);
+          impl->backfill_cairo_surface = cairo_surface_reference (impl->committed_cairo_surface);
+        }
+
+      if (impl->pending_damage_region == NULL)
+        impl->pending_damage_region = cairo_region_copy (window->current_paint.region);
+      else
+        cairo_region_union (impl->pending_damage_region, window->current_paint.region);
 
       n = cairo_region_num_rectangles (window->current_paint.region);
       for (i = 0; i < n; i++)
@@ -837,6 +962,7 @@ gdk_window_impl_wayland_finalize (GObject *object)
   g_clear_pointer (&impl->opaque_region, cairo_region_destroy);
   g_clear_pointer (&impl->input_region, cairo_region_destroy);
   g_clear_pointer (&impl->staged_updates_region, cairo_region_destroy);
+  clear_damage_history (impl);
 
   G_OBJECT_CLASS (_gdk_window_impl_wayland_parent_class)->finalize (object);
 }
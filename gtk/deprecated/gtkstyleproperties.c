@@ -24,6 +24,7 @@
 #include <cairo-gobject.h>
 
 #include "gtkstyleprovider.h"
+#include "gtkcssdependenciesprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
 #include "gtkcsstypedvalueprivate.h"
 #include "gtkcsstypesprivate.h"
@@ -80,6 +81,7 @@ struct _GtkStylePropertiesPrivate
 {
   GHashTable *color_map;
   GHashTable *properties;
+  GtkCssDependencies *dependencies;
 };
 
 static void gtk_style_properties_provider_init         (GtkStyleProviderIface            *iface);
@@ -259,6 +261,13 @@ gtk_style_properties_init (GtkStyleProperties *props)
   props->priv = gtk_style_properties_get_instance_private (props);
   props->priv->properties = g_hash_table_new_full (NULL, NULL, NULL,
                                                    (GDestroyNotify) property_data_free);
+
+  /* values are looked up by the state of the node only */
+  props->priv->dependencies = gtk_css_dependencies_new ();
+  gtk_css_dependencies_add (props->priv->dependencies,
+                            GTK_CSS_CHANGE_STATE,
+                            GUINT_TO_POINTER (G_MAXUINT),
+                            GTK_CSS_CHANGE_STATE);
 }
 
 static void
@@ -270,6 +279,7 @@ gtk_style_properties_finalize (GObject *object)
   props = GTK_STYLE_PROPERTIES (object);
   priv = props->priv;
   g_hash_table_destroy (priv->properties);
+  gtk_css_dependencies_free (priv->dependencies);
 
   if (priv->color_map)
     g_hash_table_destroy (priv->color_map);
@@ -0,0 +1,135 @@
+/*  Copyright 2016 The GTK+ Team
+ *
+ * GTK+ is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK+; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+
+static void
+do_compile (gint         argc,
+            const gchar *argv[])
+{
+  GFile *file;
+  GBytes *bytes;
+  GError *error = NULL;
+  gchar *output = NULL;
+  const gchar *filename = NULL;
+  gconstpointer data;
+  gsize size;
+  gint i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (g_str_has_prefix (argv[i], "--output="))
+        {
+          g_free (output);
+          output = g_strdup (argv[i] + strlen ("--output="));
+        }
+      else if (filename == NULL)
+        filename = argv[i];
+      else
+        {
+          g_printerr (_("Can't compile more than one file\n"));
+          exit (1);
+        }
+    }
+
+  if (filename == NULL)
+    {
+      g_printerr (_("No file to compile given\n"));
+      exit (1);
+    }
+
+  /* file names and resource:// URIs both work */
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (output == NULL)
+    {
+      gchar *basename;
+
+      basename = g_file_get_basename (file);
+      output = g_strconcat (basename, ".compiled", NULL);
+      g_free (basename);
+    }
+
+  bytes = gtk_css_provider_compile (file, &error);
+  if (bytes == NULL)
+    {
+      g_printerr (_("Failed to compile %s: %s\n"), filename, error->message);
+      exit (1);
+    }
+
+  data = g_bytes_get_data (bytes, &size);
+
+  /* g_file_set_contents() replaces the file atomically, so running
+   * applications that have the old file mapped are not affected */
+  if (!g_file_set_contents (output, data, size, &error))
+    {
+      g_printerr (_("Failed to write %s: %s\n"), output, error->message);
+      exit (1);
+    }
+
+  g_bytes_unref (bytes);
+  g_object_unref (file);
+  g_free (output);
+}
+
+static void
+usage (void)
+{
+  g_print (_("Usage:\n"
+             "  gtk-css-tool [COMMAND] FILE\n"
+             "\n"
+             "Commands:\n"
+             "  compile [OPTIONS]  Compile the style sheet\n"
+             "\n"
+             "Compile Options:\n"
+             "  --output=FILE      Write to FILE instead of FILE.compiled\n"
+             "                     in the current directory\n"
+             "\n"
+             "Perform various tasks on CSS style sheets.\n"));
+  exit (1);
+}
+
+int
+main (int argc, const char *argv[])
+{
+  g_set_prgname ("gtk-css-tool");
+
+  /* Style sheets can be compiled without a display, for example
+   * while building GTK+ itself, so don't insist on one. */
+  gtk_init_check (NULL, NULL);
+
+  if (argc < 3)
+    usage ();
+
+  if (strcmp (argv[2], "--help") == 0)
+    usage ();
+
+  argv++;
+  argc--;
+
+  if (strcmp (argv[0], "compile") == 0)
+    do_compile (argc, argv);
+  else
+    usage ();
+
+  return 0;
+}
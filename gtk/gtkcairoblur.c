@@ -25,6 +25,22 @@
 #include <math.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2_KERNEL 1
+#endif
+
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNEL 1
+#endif
+
 /*
  * Gets the size for a single box blur.
  *
@@ -218,6 +234,650 @@ _boxblur (guchar      *buffer,
   g_free (flipped_buffer);
 }
 
+/* The vectorized kernels blur the columns in place, without swapping
+ * rows and columns. They do the same as blur_xspan() for a whole row
+ * of columns at a time: every step adds a row to the sums of the
+ * columns and subtracts the row that leaves the window. The rows in
+ * the window are kept in a ring buffer, as they get overwritten with
+ * the result. The sums are kept in 16 bits, so this works for filter
+ * sizes up to BLUR_MAX_VECTOR_SIZE.
+ *
+ * The division is done by multiplying with a precomputed inverse and
+ * shifting, see Granlund and Montgomery, "Division by Invariant
+ * Integers using Multiplication". It is exact for all 16 bit values.
+ */
+#define BLUR_MAX_VECTOR_SIZE 256
+
+typedef struct {
+  guint16 multiplier;
+  guint16 shift1;
+  guint16 shift2;
+  guint16 half;
+} BlurDivisor;
+
+static void
+blur_divisor_init (BlurDivisor *div,
+                   int          d)
+{
+  int l = 0;
+
+  while ((1 << l) < d)
+    l++;
+
+  div->multiplier = (((1 << 16) * ((1 << l) - d)) / d) + 1;
+  div->shift1 = MIN (l, 1);
+  div->shift2 = MAX (l - 1, 0);
+  div->half = d / 2;
+}
+
+static inline guchar
+blur_divide (const BlurDivisor *div,
+             guint              sum)
+{
+  guint n = sum + div->half;
+  guint t = (n * div->multiplier) >> 16;
+
+  return (t + ((n - t) >> div->shift1)) >> div->shift2;
+}
+
+typedef void (* BlurColumnsStep) (guint16           *sums,
+                                  const guchar      *in,
+                                  guchar            *ring,
+                                  guchar            *out,
+                                  int                n,
+                                  const BlurDivisor *div);
+
+static void
+blur_columns_step_c (guint16           *sums,
+                     const guchar      *in,
+                     guchar            *ring,
+                     guchar            *out,
+                     int                n,
+                     const BlurDivisor *div)
+{
+  int x;
+
+  for (x = 0; x < n; x++)
+    {
+      guchar value = in[x];
+
+      sums[x] += value - ring[x];
+      ring[x] = value;
+      out[x] = blur_divide (div, sums[x]);
+    }
+}
+
+#ifdef HAVE_SSE2_KERNEL
+static void
+blur_columns_step_sse2 (guint16           *sums,
+                        const guchar      *in,
+                        guchar            *ring,
+                        guchar            *out,
+                        int                n,
+                        const BlurDivisor *div)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i multiplier = _mm_set1_epi16 (div->multiplier);
+  const __m128i half = _mm_set1_epi16 (div->half);
+  const __m128i shift1 = _mm_cvtsi32_si128 (div->shift1);
+  const __m128i shift2 = _mm_cvtsi32_si128 (div->shift2);
+  int x;
+
+  for (x = 0; x + 16 <= n; x += 16)
+    {
+      __m128i value, old, lo, hi, t;
+
+      value = _mm_loadu_si128 ((const __m128i *) (in + x));
+      old = _mm_loadu_si128 ((const __m128i *) (ring + x));
+      _mm_storeu_si128 ((__m128i *) (ring + x), value);
+
+      lo = _mm_loadu_si128 ((const __m128i *) (sums + x));
+      hi = _mm_loadu_si128 ((const __m128i *) (sums + x + 8));
+      lo = _mm_sub_epi16 (_mm_add_epi16 (lo, _mm_unpacklo_epi8 (value, zero)), _mm_unpacklo_epi8 (old, zero));
+      hi = _mm_sub_epi16 (_mm_add_epi16 (hi, _mm_unpackhi_epi8 (value, zero)), _mm_unpackhi_epi8 (old, zero));
+      _mm_storeu_si128 ((__m128i *) (sums + x), lo);
+      _mm_storeu_si128 ((__m128i *) (sums + x + 8), hi);
+
+      lo = _mm_add_epi16 (lo, half);
+      t = _mm_mulhi_epu16 (lo, multiplier);
+      lo = _mm_srl_epi16 (_mm_add_epi16 (t, _mm_srl_epi16 (_mm_sub_epi16 (lo, t), shift1)), shift2);
+      hi = _mm_add_epi16 (hi, half);
+      t = _mm_mulhi_epu16 (hi, multiplier);
+      hi = _mm_srl_epi16 (_mm_add_epi16 (t, _mm_srl_epi16 (_mm_sub_epi16 (hi, t), shift1)), shift2);
+
+      _mm_storeu_si128 ((__m128i *) (out + x), _mm_packus_epi16 (lo, hi));
+    }
+
+  blur_columns_step_c (sums + x, in + x, ring + x, out + x, n - x, div);
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+__attribute__ ((target ("avx2")))
+static void
+blur_columns_step_avx2 (guint16           *sums,
+                        const guchar      *in,
+                        guchar            *ring,
+                        guchar            *out,
+                        int                n,
+                        const BlurDivisor *div)
+{
+  const __m256i multiplier = _mm256_set1_epi16 (div->multiplier);
+  const __m256i half = _mm256_set1_epi16 (div->half);
+  const __m128i shift1 = _mm_cvtsi32_si128 (div->shift1);
+  const __m128i shift2 = _mm_cvtsi32_si128 (div->shift2);
+  int x;
+
+  for (x = 0; x + 32 <= n; x += 32)
+    {
+      __m256i value, old, sum_lo, sum_hi, lo, hi, t;
+
+      value = _mm256_loadu_si256 ((const __m256i *) (in + x));
+      old = _mm256_loadu_si256 ((const __m256i *) (ring + x));
+      _mm256_storeu_si256 ((__m256i *) (ring + x), value);
+
+      sum_lo = _mm256_loadu_si256 ((const __m256i *) (sums + x));
+      sum_hi = _mm256_loadu_si256 ((const __m256i *) (sums + x + 16));
+      sum_lo = _mm256_add_epi16 (sum_lo, _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (value)));
+      sum_lo = _mm256_sub_epi16 (sum_lo, _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (old)));
+      sum_hi = _mm256_add_epi16 (sum_hi, _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (value, 1)));
+      sum_hi = _mm256_sub_epi16 (sum_hi, _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (old, 1)));
+      _mm256_storeu_si256 ((__m256i *) (sums + x), sum_lo);
+      _mm256_storeu_si256 ((__m256i *) (sums + x + 16), sum_hi);
+
+      lo = _mm256_add_epi16 (sum_lo, half);
+      t = _mm256_mulhi_epu16 (lo, multiplier);
+      lo = _mm256_srl_epi16 (_mm256_add_epi16 (t, _mm256_srl_epi16 (_mm256_sub_epi16 (lo, t), shift1)), shift2);
+      hi = _mm256_add_epi16 (sum_hi, half);
+      t = _mm256_mulhi_epu16 (hi, multiplier);
+      hi = _mm256_srl_epi16 (_mm256_add_epi16 (t, _mm256_srl_epi16 (_mm256_sub_epi16 (hi, t), shift1)), shift2);
+
+      /* packing works on 128 bit lanes, put them back in order */
+      _mm256_storeu_si256 ((__m256i *) (out + x),
+                           _mm256_permute4x64_epi64 (_mm256_packus_epi16 (lo, hi), 0xd8));
+    }
+
+  blur_columns_step_c (sums + x, in + x, ring + x, out + x, n - x, div);
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+static void
+blur_columns_step_neon (guint16           *sums,
+                        const guchar      *in,
+                        guchar            *ring,
+                        guchar            *out,
+                        int                n,
+                        const BlurDivisor *div)
+{
+  const uint16x8_t half = vdupq_n_u16 (div->half);
+  const uint16x4_t multiplier = vdup_n_u16 (div->multiplier);
+  const int16x8_t shift1 = vdupq_n_s16 (- (int) div->shift1);
+  const int16x8_t shift2 = vdupq_n_s16 (- (int) div->shift2);
+  int x;
+
+  for (x = 0; x + 16 <= n; x += 16)
+    {
+      uint8x16_t value, old;
+      uint16x8_t lo, hi, t;
+
+      value = vld1q_u8 (in + x);
+      old = vld1q_u8 (ring + x);
+      vst1q_u8 (ring + x, value);
+
+      lo = vld1q_u16 (sums + x);
+      hi = vld1q_u16 (sums + x + 8);
+      lo = vsubq_u16 (vaddw_u8 (lo, vget_low_u8 (value)), vmovl_u8 (vget_low_u8 (old)));
+      hi = vsubq_u16 (vaddw_u8 (hi, vget_high_u8 (value)), vmovl_u8 (vget_high_u8 (old)));
+      vst1q_u16 (sums + x, lo);
+      vst1q_u16 (sums + x + 8, hi);
+
+      lo = vaddq_u16 (lo, half);
+      t = vcombine_u16 (vshrn_n_u32 (vmull_u16 (vget_low_u16 (lo), multiplier), 16),
+                        vshrn_n_u32 (vmull_u16 (vget_high_u16 (lo), multiplier), 16));
+      lo = vshlq_u16 (vaddq_u16 (t, vshlq_u16 (vsubq_u16 (lo, t), shift1)), shift2);
+      hi = vaddq_u16 (hi, half);
+      t = vcombine_u16 (vshrn_n_u32 (vmull_u16 (vget_low_u16 (hi), multiplier), 16),
+                        vshrn_n_u32 (vmull_u16 (vget_high_u16 (hi), multiplier), 16));
+      hi = vshlq_u16 (vaddq_u16 (t, vshlq_u16 (vsubq_u16 (hi, t), shift1)), shift2);
+
+      vst1q_u8 (out + x, vcombine_u8 (vmovn_u16 (lo), vmovn_u16 (hi)));
+    }
+
+  blur_columns_step_c (sums + x, in + x, ring + x, out + x, n - x, div);
+}
+#endif
+
+/* The rows are blurred by swapping rows and columns and blurring the
+ * columns. The vectorized versions of flip_buffer() transpose blocks
+ * of 16x16 pixels in registers by interleaving rows k and k + 8 four
+ * times: every round moves a bit of the column index to the row
+ * index and vice versa.
+ */
+typedef void (* BlurFlip) (guchar *dst_buffer,
+                           guchar *src_buffer,
+                           int     width,
+                           int     height);
+
+#if defined(HAVE_SSE2_KERNEL)
+static void
+flip_buffer_sse2 (guchar *dst_buffer,
+                  guchar *src_buffer,
+                  int     width,
+                  int     height)
+{
+  int i0, j0, k, round;
+
+  for (j0 = 0; j0 + 16 <= height; j0 += 16)
+    for (i0 = 0; i0 + 16 <= width; i0 += 16)
+      {
+        __m128i a[16], b[16];
+
+        for (k = 0; k < 16; k++)
+          a[k] = _mm_loadu_si128 ((const __m128i *) (src_buffer + (j0 + k) * width + i0));
+
+        for (round = 0; round < 4; round++)
+          {
+            for (k = 0; k < 8; k++)
+              {
+                b[2 * k] = _mm_unpacklo_epi8 (a[k], a[k + 8]);
+                b[2 * k + 1] = _mm_unpackhi_epi8 (a[k], a[k + 8]);
+              }
+            memcpy (a, b, sizeof (a));
+          }
+
+        for (k = 0; k < 16; k++)
+          _mm_storeu_si128 ((__m128i *) (dst_buffer + (i0 + k) * height + j0), a[k]);
+      }
+
+  /* the edges that don't fill a block */
+  for (j0 = 0; j0 < height; j0++)
+    for (i0 = j0 < (height & ~15) ? (width & ~15) : 0; i0 < width; i0++)
+      dst_buffer[i0 * height + j0] = src_buffer[j0 * width + i0];
+}
+#endif
+
+#if defined(HAVE_NEON_KERNEL)
+static void
+flip_buffer_neon (guchar *dst_buffer,
+                  guchar *src_buffer,
+                  int     width,
+                  int     height)
+{
+  int i0, j0, k, round;
+
+  for (j0 = 0; j0 + 16 <= height; j0 += 16)
+    for (i0 = 0; i0 + 16 <= width; i0 += 16)
+      {
+        uint8x16_t a[16], b[16];
+
+        for (k = 0; k < 16; k++)
+          a[k] = vld1q_u8 (src_buffer + (j0 + k) * width + i0);
+
+        for (round = 0; round < 4; round++)
+          {
+            for (k = 0; k < 8; k++)
+              {
+                uint8x16x2_t zipped = vzipq_u8 (a[k], a[k + 8]);
+
+                b[2 * k] = zipped.val[0];
+                b[2 * k + 1] = zipped.val[1];
+              }
+            memcpy (a, b, sizeof (a));
+          }
+
+        for (k = 0; k < 16; k++)
+          vst1q_u8 (dst_buffer + (i0 + k) * height + j0, a[k]);
+      }
+
+  /* the edges that don't fill a block */
+  for (j0 = 0; j0 < height; j0++)
+    for (i0 = j0 < (height & ~15) ? (width & ~15) : 0; i0 < width; i0++)
+      dst_buffer[i0 * height + j0] = src_buffer[j0 * width + i0];
+}
+#endif
+
+typedef struct {
+  const char      *name;
+  BlurColumnsStep  step;
+  BlurFlip         flip;
+} BlurKernel;
+
+static const BlurKernel blur_kernels[] = {
+  { "scalar", NULL, flip_buffer },
+#ifdef HAVE_SSE2_KERNEL
+  { "sse2", blur_columns_step_sse2, flip_buffer_sse2 },
+#endif
+#ifdef HAVE_AVX2_KERNEL
+  { "avx2", blur_columns_step_avx2, flip_buffer_sse2 },
+#endif
+#ifdef HAVE_NEON_KERNEL
+  { "neon", blur_columns_step_neon, flip_buffer_neon },
+#endif
+};
+
+static const BlurKernel *blur_kernel = NULL;
+
+static gboolean
+blur_kernel_is_supported (const BlurKernel *kernel)
+{
+#ifdef HAVE_AVX2_KERNEL
+  if (kernel->step == blur_columns_step_avx2)
+    {
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx2");
+    }
+#endif
+
+  return TRUE;
+}
+
+static const BlurKernel *
+blur_get_kernel (void)
+{
+  if (G_UNLIKELY (blur_kernel == NULL))
+    {
+      int i;
+
+      /* the kernels are sorted by preference */
+      for (i = G_N_ELEMENTS (blur_kernels) - 1; i >= 0; i--)
+        {
+          if (blur_kernel_is_supported (&blur_kernels[i]))
+            {
+              blur_kernel = &blur_kernels[i];
+              break;
+            }
+        }
+    }
+
+  return blur_kernel;
+}
+
+/* Blurs columns @x0 to @x0 + @n - 1 with a single box blur pass, see
+ * blur_xspan() for @d and @shift. @ring needs to hold @d rows of @n
+ * pixels, @zeros and @discard a row each.
+ */
+static void
+blur_yspan (BlurColumnsStep  step,
+            guchar          *buffer,
+            int              width,
+            int              height,
+            int              x0,
+            int              n,
+            int              d,
+            int              shift,
+            guint16         *sums,
+            guchar          *ring,
+            const guchar    *zeros,
+            guchar          *discard)
+{
+  BlurDivisor div;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  blur_divisor_init (&div, d);
+  memset (sums, 0, n * sizeof (guint16));
+  memset (ring, 0, n * d);
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      step (sums,
+            i >= 0 && i < height ? buffer + i * width + x0 : zeros,
+            ring + ((i + d) % d) * n,
+            i >= offset ? buffer + (i - offset) * width + x0 : discard,
+            n,
+            &div);
+    }
+}
+
+static void
+blur_columns (BlurColumnsStep  step,
+              guchar          *buffer,
+              int              width,
+              int              height,
+              int              x0,
+              int              n,
+              int              d)
+{
+  guint16 *sums;
+  guchar *scratch, *ring, *zeros, *discard;
+
+  sums = g_new (guint16, n);
+  /* the last pass uses a filter of size d + 1 */
+  scratch = g_malloc0 (n * (d + 3));
+  zeros = scratch;
+  discard = scratch + n;
+  ring = scratch + 2 * n;
+
+  /* See blur_rows() for the passes */
+  if (d % 2 == 1)
+    {
+      blur_yspan (step, buffer, width, height, x0, n, d, 0, sums, ring, zeros, discard);
+      blur_yspan (step, buffer, width, height, x0, n, d, 0, sums, ring, zeros, discard);
+      blur_yspan (step, buffer, width, height, x0, n, d, 0, sums, ring, zeros, discard);
+    }
+  else
+    {
+      blur_yspan (step, buffer, width, height, x0, n, d, 1, sums, ring, zeros, discard);
+      blur_yspan (step, buffer, width, height, x0, n, d, -1, sums, ring, zeros, discard);
+      blur_yspan (step, buffer, width, height, x0, n, d + 1, 0, sums, ring, zeros, discard);
+    }
+
+  g_free (scratch);
+  g_free (sums);
+}
+
+/* Large surfaces are split into stripes of columns that get blurred
+ * in parallel. The calling thread helps out.
+ */
+#define BLUR_MIN_PARALLEL_PIXELS (512 * 512)
+#define BLUR_MAX_THREADS 8
+/* stripes are a multiple of this wide */
+#define BLUR_STRIPE_ALIGN 64
+
+typedef struct {
+  BlurColumnsStep  step;
+  guchar          *buffer;
+  int              width;
+  int              height;
+  int              d;
+  int              stripe_width;
+  gint             next_column; /* atomic */
+
+  GMutex           mutex;
+  GCond            cond;
+  guint            n_running;
+} BlurBatch;
+
+static GThreadPool *blur_pool = NULL;
+static guint blur_n_threads = G_MAXUINT;
+
+static guint
+blur_get_n_threads (void)
+{
+  if (G_UNLIKELY (blur_n_threads == G_MAXUINT))
+    blur_n_threads = CLAMP (g_get_num_processors (), 1, BLUR_MAX_THREADS + 1) - 1;
+
+  return blur_n_threads;
+}
+
+static void
+blur_batch_run (BlurBatch *batch)
+{
+  int x0;
+
+  while (TRUE)
+    {
+      x0 = g_atomic_int_add (&batch->next_column, batch->stripe_width);
+      if (x0 >= batch->width)
+        break;
+
+      blur_columns (batch->step,
+                    batch->buffer, batch->width, batch->height,
+                    x0, MIN (batch->stripe_width, batch->width - x0),
+                    batch->d);
+    }
+}
+
+static void
+blur_thread_func (gpointer data,
+                  gpointer user_data)
+{
+  BlurBatch *batch = data;
+
+  blur_batch_run (batch);
+
+  g_mutex_lock (&batch->mutex);
+  batch->n_running--;
+  g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+static void
+blur_columns_parallel (BlurColumnsStep  step,
+                       guchar          *buffer,
+                       int              width,
+                       int              height,
+                       int              d)
+{
+  BlurBatch batch;
+  guint i, n_threads;
+
+  n_threads = blur_get_n_threads ();
+  if (width * height < BLUR_MIN_PARALLEL_PIXELS)
+    n_threads = 0;
+  n_threads = MIN (n_threads, (width - 1) / BLUR_STRIPE_ALIGN);
+
+  batch.step = step;
+  batch.buffer = buffer;
+  batch.width = width;
+  batch.height = height;
+  batch.d = d;
+  /* one stripe per thread, as wide stripes need fewer steps */
+  batch.stripe_width = (width / (n_threads + 1) + BLUR_STRIPE_ALIGN - 1) & ~(BLUR_STRIPE_ALIGN - 1);
+  batch.next_column = 0;
+
+  if (n_threads == 0)
+    {
+      blur_batch_run (&batch);
+      return;
+    }
+
+  if (blur_pool == NULL)
+    blur_pool = g_thread_pool_new (blur_thread_func, NULL, BLUR_MAX_THREADS, FALSE, NULL);
+
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+
+  batch.n_running = n_threads;
+  for (i = 0; i < n_threads; i++)
+    g_thread_pool_push (blur_pool, &batch, NULL);
+
+  blur_batch_run (&batch);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.n_running > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+}
+
+static void
+_boxblur_vectorized (const BlurKernel *kernel,
+                     guchar           *buffer,
+                     int               width,
+                     int               height,
+                     int               radius,
+                     GtkBlurFlags      flags)
+{
+  guchar *flipped_buffer;
+  int d = get_box_filter_size (radius);
+
+  if (flags & GTK_BLUR_Y)
+    blur_columns_parallel (kernel->step, buffer, width, height, d);
+
+  if (flags & GTK_BLUR_X)
+    {
+      flipped_buffer = g_malloc (width * height);
+
+      kernel->flip (flipped_buffer, buffer, width, height);
+      blur_columns_parallel (kernel->step, flipped_buffer, height, width, d);
+      kernel->flip (buffer, flipped_buffer, height, width);
+
+      g_free (flipped_buffer);
+    }
+}
+
+/*
+ * _gtk_cairo_blur_list_kernels:
+ *
+ * Lists the names of the blur implementations the CPU supports,
+ * for testing. "scalar" is always supported.
+ *
+ * Returns: (transfer container): a %NULL-terminated array of names
+ */
+const char **
+_gtk_cairo_blur_list_kernels (void)
+{
+  GPtrArray *names;
+  guint i;
+
+  names = g_ptr_array_new ();
+  for (i = 0; i < G_N_ELEMENTS (blur_kernels); i++)
+    {
+      if (blur_kernel_is_supported (&blur_kernels[i]))
+        g_ptr_array_add (names, (gpointer) blur_kernels[i].name);
+    }
+  g_ptr_array_add (names, NULL);
+
+  return (const char **) g_ptr_array_free (names, FALSE);
+}
+
+/*
+ * _gtk_cairo_blur_set_kernel:
+ * @name: (allow-none): a name returned by _gtk_cairo_blur_list_kernels()
+ *     or %NULL for the fastest one
+ * @n_threads: the number of additional threads to use for large
+ *     surfaces, or -1 for the default
+ *
+ * Selects the blur implementation, for testing.
+ *
+ * Returns: %TRUE if @name is supported
+ */
+gboolean
+_gtk_cairo_blur_set_kernel (const char *name,
+                            int         n_threads)
+{
+  guint i;
+
+  blur_n_threads = n_threads < 0 ? G_MAXUINT : MIN (n_threads, BLUR_MAX_THREADS);
+
+  if (name == NULL)
+    {
+      blur_kernel = NULL;
+      return TRUE;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (blur_kernels); i++)
+    {
+      if (g_str_equal (blur_kernels[i].name, name) &&
+          blur_kernel_is_supported (&blur_kernels[i]))
+        {
+          blur_kernel = &blur_kernels[i];
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
 /*
  * _gtk_cairo_blur_surface:
  * @surface: a cairo image surface.
@@ -230,6 +890,7 @@ _gtk_cairo_blur_surface (cairo_surface_t* surface,
                          double           radius_d,
                          GtkBlurFlags     flags)
 {
+  const BlurKernel *kernel;
   int radius = radius_d;
 
   g_return_if_fail (surface != NULL);
@@ -247,10 +908,18 @@ _gtk_cairo_blur_surface (cairo_surface_t* surface,
   /* Before we mess with the surface, execute any pending drawing. */
   cairo_surface_flush (surface);
 
-  _boxblur (cairo_image_surface_get_data (surface),
-            cairo_image_surface_get_stride (surface),
-            cairo_image_surface_get_height (surface),
-            radius, flags);
+  kernel = blur_get_kernel ();
+  if (kernel->step && get_box_filter_size (radius) < BLUR_MAX_VECTOR_SIZE)
+    _boxblur_vectorized (kernel,
+                         cairo_image_surface_get_data (surface),
+                         cairo_image_surface_get_stride (surface),
+                         cairo_image_surface_get_height (surface),
+                         radius, flags);
+  else
+    _boxblur (cairo_image_surface_get_data (surface),
+              cairo_image_surface_get_stride (surface),
+              cairo_image_surface_get_height (surface),
+              radius, flags);
 
   /* Inform cairo we altered the surface contents. */
   cairo_surface_mark_dirty (surface);
@@ -41,6 +41,10 @@ void            _gtk_cairo_blur_surface         (cairo_surface_t *surface,
 						 GtkBlurFlags     flags);;
 int             _gtk_cairo_blur_compute_pixels  (double           radius);
 
+const char **   _gtk_cairo_blur_list_kernels    (void);
+gboolean        _gtk_cairo_blur_set_kernel      (const char      *name,
+                                                 int              n_threads);
+
 G_END_DECLS
 
 #endif /* _GTK_CAIRO_BLUR_H */
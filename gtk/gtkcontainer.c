@@ -3599,6 +3599,50 @@ compare_children_for_draw (gconstpointer  _a,
   return b->window_depth - a->window_depth;
 }
 
+/* Drops the children that are completely hidden behind the opaque
+ * background of a sibling that gets drawn after them, like the pages
+ * of a #GtkOverlay covered by an overlay.
+ */
+static void
+gtk_container_remove_occluded_children (GtkContainer *container,
+                                        GArray       *child_infos)
+{
+  GdkWindow *window = _gtk_widget_get_window (GTK_WIDGET (container));
+  cairo_region_t *opaque = NULL;
+  cairo_rectangle_int_t rect;
+  GtkWidget *child;
+  int i;
+
+  for (i = child_infos->len - 1; i >= 0; i--)
+    {
+      child = g_array_index (child_infos, ChildOrderInfo, i).child;
+
+      if (_gtk_widget_get_window (child) != window)
+        continue;
+
+      if (opaque)
+        {
+          gtk_widget_get_clip (child, &rect);
+          if (cairo_region_contains_rectangle (opaque, &rect) == CAIRO_REGION_OVERLAP_IN)
+            {
+              g_array_remove_index (child_infos, i);
+              continue;
+            }
+        }
+
+      if (gtk_widget_get_opaque_rect (child, &rect))
+        {
+          if (opaque)
+            cairo_region_union_rectangle (opaque, &rect);
+          else
+            opaque = cairo_region_create_rectangle (&rect);
+        }
+    }
+
+  if (opaque)
+    cairo_region_destroy (opaque);
+}
+
 static gint
 gtk_container_draw (GtkWidget *widget,
                     cairo_t   *cr)
@@ -3624,6 +3668,9 @@ gtk_container_draw (GtkWidget *widget,
 
   g_array_sort (child_infos, compare_children_for_draw);
 
+  if (child_infos->len > 1)
+    gtk_container_remove_occluded_children (container, child_infos);
+
   for (i = 0; i < child_infos->len; i++)
     {
       child_info = &g_array_index (child_infos, ChildOrderInfo, i);
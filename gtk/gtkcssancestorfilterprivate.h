@@ -0,0 +1,112 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2016 The GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_CSS_ANCESTOR_FILTER_PRIVATE_H__
+#define __GTK_CSS_ANCESTOR_FILTER_PRIVATE_H__
+
+#include <string.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A small bloom filter containing the names, ids and style classes of
+ * all ancestors of a CSS node. It can only ever give false positives,
+ * so if a selector's hash is not contained in the filter, no ancestor
+ * can match that selector and the walk up the parent chain for
+ * descendant and child combinators can be skipped.
+ *
+ * Each hash sets 2 of the 256 bits in the filter.
+ */
+#define GTK_CSS_ANCESTOR_FILTER_WORDS 8
+
+typedef struct _GtkCssAncestorFilter GtkCssAncestorFilter;
+
+struct _GtkCssAncestorFilter {
+  guint32 bits[GTK_CSS_ANCESTOR_FILTER_WORDS];
+};
+
+/* salts so that equal numeric keys of different kinds don't collide */
+#define GTK_CSS_ANCESTOR_FILTER_SALT_NAME  0x9e3779b9u
+#define GTK_CSS_ANCESTOR_FILTER_SALT_ID    0x7f4a7c15u
+#define GTK_CSS_ANCESTOR_FILTER_SALT_CLASS 0x2545f491u
+
+static inline guint32
+gtk_css_ancestor_filter_hash (gsize   key,
+                              guint32 salt)
+{
+  guint32 hash;
+
+  hash = (guint32) key;
+#if GLIB_SIZEOF_SIZE_T > 4
+  hash ^= (guint32) (key >> 32);
+#endif
+  hash = (hash ^ salt) * 2654435761u;
+  hash ^= hash >> 15;
+
+  /* 0 is reserved for "no hash" */
+  return hash ? hash : 1;
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_name (/*interned*/ const char *name)
+{
+  return gtk_css_ancestor_filter_hash (GPOINTER_TO_SIZE (name), GTK_CSS_ANCESTOR_FILTER_SALT_NAME);
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_id (/*interned*/ const char *id)
+{
+  return gtk_css_ancestor_filter_hash (GPOINTER_TO_SIZE (id), GTK_CSS_ANCESTOR_FILTER_SALT_ID);
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_class (GQuark style_class)
+{
+  return gtk_css_ancestor_filter_hash (style_class, GTK_CSS_ANCESTOR_FILTER_SALT_CLASS);
+}
+
+static inline void
+gtk_css_ancestor_filter_init (GtkCssAncestorFilter *filter)
+{
+  memset (filter, 0, sizeof (GtkCssAncestorFilter));
+}
+
+static inline void
+gtk_css_ancestor_filter_add (GtkCssAncestorFilter *filter,
+                             guint32               hash)
+{
+  guint bit1 = hash & 0xff;
+  guint bit2 = (hash >> 8) & 0xff;
+
+  filter->bits[bit1 / 32] |= 1u << (bit1 % 32);
+  filter->bits[bit2 / 32] |= 1u << (bit2 % 32);
+}
+
+static inline gboolean
+gtk_css_ancestor_filter_may_contain (const GtkCssAncestorFilter *filter,
+                                     guint32                     hash)
+{
+  guint bit1 = hash & 0xff;
+  guint bit2 = (hash >> 8) & 0xff;
+
+  return (filter->bits[bit1 / 32] & (1u << (bit1 % 32))) &&
+         (filter->bits[bit2 / 32] & (1u << (bit2 % 32)));
+}
+
+G_END_DECLS
+
+#endif /* __GTK_CSS_ANCESTOR_FILTER_PRIVATE_H__ */
@@ -487,6 +487,11 @@ gtk_css_animated_style_new_advance (GtkCssAnimatedStyle *source,
   result->style = g_object_ref (base);
   result->current_time = timestamp;
   result->animations = animations;
+  /* The same properties are animated every frame, so avoid growing
+   * the array one property at a time */
+  if (source->animated_values)
+    result->animated_values = g_ptr_array_new_full (source->animated_values->len,
+                                                    (GDestroyNotify) _gtk_css_value_unref);
 
   gtk_css_animated_style_apply_animations (result, timestamp);
 
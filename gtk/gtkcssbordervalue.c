@@ -130,12 +130,30 @@ gtk_css_value_border_print (const GtkCssValue *value,
     g_string_append (string, " fill");
 }
 
+static guint
+gtk_css_value_border_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->fill;
+
+  for (i = 0; i < 4; i++)
+    {
+      hash <<= 1;
+      if (value->values[i])
+        hash ^= _gtk_css_value_hash (value->values[i]);
+    }
+
+  return hash;
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_BORDER = {
   gtk_css_value_border_free,
   gtk_css_value_border_compute,
   gtk_css_value_border_equal,
   gtk_css_value_border_transition,
-  gtk_css_value_border_print
+  gtk_css_value_border_print,
+  gtk_css_value_border_hash
 };
 
 GtkCssValue *
@@ -98,12 +98,19 @@ gtk_css_value_corner_print (const GtkCssValue *corner,
     }
 }
 
+static guint
+gtk_css_value_corner_hash (const GtkCssValue *corner)
+{
+  return _gtk_css_value_hash (corner->x) ^ (_gtk_css_value_hash (corner->y) << 1);
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_CORNER = {
   gtk_css_value_corner_free,
   gtk_css_value_corner_compute,
   gtk_css_value_corner_equal,
   gtk_css_value_corner_transition,
-  gtk_css_value_corner_print
+  gtk_css_value_corner_print,
+  gtk_css_value_corner_hash
 };
 
 GtkCssValue *
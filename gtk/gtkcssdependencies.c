@@ -0,0 +1,213 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2016 The GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtkcssdependenciesprivate.h"
+
+#include "gtkprivate.h"
+
+/* An index from names, ids, style classes and state flags to the
+ * nodes whose style depends on them, relative to the node that has
+ * them: GTK_CSS_CHANGE_CLASS for the node itself, then the
+ * _gtk_css_change_for_sibling() and _gtk_css_change_for_child()
+ * variants for the following siblings, the descendants and the
+ * descendants of the following siblings.
+ *
+ * Every GtkCssProvider keeps one for all of its selectors. As
+ * nodes may use other providers than their parents, queries go to
+ * all of the indexes at once.
+ *
+ * All of the dependencies fit in 32 bits, so they are stored in
+ * the hash tables as pointers.
+ */
+
+#define N_STATE_FLAGS 32
+
+struct _GtkCssDependencies {
+  GHashTable   *names;
+  GHashTable   *ids;
+  GHashTable   *classes;
+  GtkCssChange  states[N_STATE_FLAGS];
+};
+
+static GSList *all_dependencies = NULL;
+/* providers that can't tell what they depend on */
+static guint n_unknown = 0;
+
+GtkCssDependencies *
+gtk_css_dependencies_new (void)
+{
+  GtkCssDependencies *deps;
+
+  deps = g_slice_new0 (GtkCssDependencies);
+  deps->names = g_hash_table_new (NULL, NULL);
+  deps->ids = g_hash_table_new (NULL, NULL);
+  deps->classes = g_hash_table_new (NULL, NULL);
+
+  all_dependencies = g_slist_prepend (all_dependencies, deps);
+
+  return deps;
+}
+
+void
+gtk_css_dependencies_free (GtkCssDependencies *deps)
+{
+  all_dependencies = g_slist_remove (all_dependencies, deps);
+
+  g_hash_table_unref (deps->names);
+  g_hash_table_unref (deps->ids);
+  g_hash_table_unref (deps->classes);
+
+  g_slice_free (GtkCssDependencies, deps);
+}
+
+static GHashTable *
+gtk_css_dependencies_get_table (const GtkCssDependencies *deps,
+                                GtkCssChange              change)
+{
+  switch (change)
+    {
+    case GTK_CSS_CHANGE_NAME:
+      return deps->names;
+    case GTK_CSS_CHANGE_ID:
+      return deps->ids;
+    case GTK_CSS_CHANGE_CLASS:
+      return deps->classes;
+    default:
+      return NULL;
+    }
+}
+
+/**
+ * gtk_css_dependencies_add:
+ * @deps: the index
+ * @change: one of %GTK_CSS_CHANGE_NAME, %GTK_CSS_CHANGE_ID,
+ *     %GTK_CSS_CHANGE_CLASS or %GTK_CSS_CHANGE_STATE
+ * @key: the name, id, class or state flags that are depended on
+ * @dependencies: the relatives of the node with @key that depend on
+ *     it, as @change and variants of it for sibling and child nodes
+ *
+ * Records that the style of some nodes depends on @key.
+ **/
+void
+gtk_css_dependencies_add (GtkCssDependencies *deps,
+                          GtkCssChange        change,
+                          gconstpointer       key,
+                          GtkCssChange        dependencies)
+{
+  GHashTable *table;
+  guint i;
+
+  gtk_internal_return_if_fail (dependencies <= G_MAXUINT32);
+
+  if (change == GTK_CSS_CHANGE_STATE)
+    {
+      guint state = GPOINTER_TO_UINT (key);
+
+      for (i = 0; i < N_STATE_FLAGS; i++)
+        {
+          if (state & (1u << i))
+            deps->states[i] |= dependencies;
+        }
+
+      return;
+    }
+
+  table = gtk_css_dependencies_get_table (deps, change);
+  gtk_internal_return_if_fail (table != NULL);
+
+  if (key == NULL)
+    return;
+
+  dependencies |= GPOINTER_TO_UINT (g_hash_table_lookup (table, key));
+  g_hash_table_insert (table, (gpointer) key, GUINT_TO_POINTER ((guint) dependencies));
+}
+
+static GtkCssChange
+gtk_css_dependencies_get (const GtkCssDependencies *deps,
+                          GtkCssChange              change,
+                          gconstpointer             key)
+{
+  GtkCssChange result;
+  guint i;
+
+  if (change == GTK_CSS_CHANGE_STATE)
+    {
+      guint state = GPOINTER_TO_UINT (key);
+
+      result = 0;
+      for (i = 0; i < N_STATE_FLAGS; i++)
+        {
+          if (state & (1u << i))
+            result |= deps->states[i];
+        }
+
+      return result;
+    }
+
+  if (key == NULL)
+    return 0;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (gtk_css_dependencies_get_table (deps, change), key));
+}
+
+/**
+ * gtk_css_dependencies_lookup:
+ * @change: one of %GTK_CSS_CHANGE_NAME, %GTK_CSS_CHANGE_ID,
+ *     %GTK_CSS_CHANGE_CLASS or %GTK_CSS_CHANGE_STATE
+ * @key: the name, id, class or state flags that changed
+ *
+ * Looks up which relatives of a node can get a different style when
+ * @key changes on the node. This is @change for the node itself and
+ * its sibling and child variants for the others, see
+ * _gtk_css_change_for_dependents().
+ *
+ * Returns: the nodes that depend on @key
+ **/
+GtkCssChange
+gtk_css_dependencies_lookup (GtkCssChange  change,
+                             gconstpointer key)
+{
+  GtkCssChange result;
+  GSList *l;
+
+  if (n_unknown > 0)
+    return _gtk_css_change_for_dependents (change);
+
+  result = 0;
+  for (l = all_dependencies; l; l = l->next)
+    result |= gtk_css_dependencies_get (l->data, change, key);
+
+  return result;
+}
+
+/* For style providers that don't keep an index. As long as one of
+ * them is in use, everything depends on everything. */
+void
+gtk_css_dependencies_add_unknown (void)
+{
+  n_unknown++;
+}
+
+void
+gtk_css_dependencies_remove_unknown (void)
+{
+  gtk_internal_return_if_fail (n_unknown > 0);
+
+  n_unknown--;
+}
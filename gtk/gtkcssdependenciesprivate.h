@@ -0,0 +1,48 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2016 The GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_CSS_DEPENDENCIES_PRIVATE_H__
+#define __GTK_CSS_DEPENDENCIES_PRIVATE_H__
+
+#include "gtkcsstypesprivate.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GtkCssDependencies GtkCssDependencies;
+
+/* The keys are the interned name for GTK_CSS_CHANGE_NAME, the
+ * interned id for GTK_CSS_CHANGE_ID, GUINT_TO_POINTER() of the quark
+ * for GTK_CSS_CHANGE_CLASS and GUINT_TO_POINTER() of the state flags
+ * for GTK_CSS_CHANGE_STATE. */
+
+GtkCssDependencies *    gtk_css_dependencies_new                (void);
+void                    gtk_css_dependencies_free               (GtkCssDependencies     *deps);
+
+void                    gtk_css_dependencies_add                (GtkCssDependencies     *deps,
+                                                                 GtkCssChange            change,
+                                                                 gconstpointer           key,
+                                                                 GtkCssChange            dependencies);
+
+GtkCssChange            gtk_css_dependencies_lookup             (GtkCssChange            change,
+                                                                 gconstpointer           key);
+
+void                    gtk_css_dependencies_add_unknown        (void);
+void                    gtk_css_dependencies_remove_unknown     (void);
+
+G_END_DECLS
+
+#endif /* __GTK_CSS_DEPENDENCIES_PRIVATE_H__ */
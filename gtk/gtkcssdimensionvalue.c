@@ -167,6 +167,15 @@ gtk_css_value_dimension_equal (const GtkCssValue *number1,
          number1->value == number2->value;
 }
 
+static guint
+gtk_css_value_dimension_hash (const GtkCssValue *number)
+{
+  /* make sure 0.0 and -0.0 hash the same, they compare equal */
+  double value = number->value == 0.0 ? 0.0 : number->value;
+
+  return number->unit ^ g_double_hash (&value);
+}
+
 static void
 gtk_css_value_dimension_print (const GtkCssValue *number,
                             GString           *string)
@@ -276,7 +285,8 @@ static const GtkCssNumberValueClass GTK_CSS_VALUE_DIMENSION = {
     gtk_css_value_dimension_compute,
     gtk_css_value_dimension_equal,
     gtk_css_number_value_transition,
-    gtk_css_value_dimension_print
+    gtk_css_value_dimension_print,
+    gtk_css_value_dimension_hash
   },
   gtk_css_value_dimension_get,
   gtk_css_value_dimension_get_dimension,
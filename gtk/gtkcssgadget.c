@@ -23,13 +23,18 @@
 
 #include <math.h>
 
+#include "gtkcssarrayvalueprivate.h"
+#include "gtkcsscornervalueprivate.h"
+#include "gtkcssenumvalueprivate.h"
 #include "gtkcssnumbervalueprivate.h"
+#include "gtkcssrgbavalueprivate.h"
 #include "gtkcssshadowsvalueprivate.h"
 #include "gtkcssstyleprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkcsswidgetnodeprivate.h"
 #include "gtkrenderbackgroundprivate.h"
 #include "gtkrenderborderprivate.h"
+#include "gtkwidgetprivate.h"
 #include "gtkdebug.h"
 
 /*
@@ -484,6 +489,75 @@ get_box_padding (GtkCssStyle *style,
   border->right = get_number (style, GTK_CSS_PROPERTY_PADDING_RIGHT);
 }
 
+static gboolean
+has_square_corner (GtkCssStyle *style,
+                   guint        property)
+{
+  const GtkCssValue *corner = gtk_css_style_get_value (style, property);
+
+  return _gtk_css_corner_value_get_x (corner, 100) <= 0 &&
+         _gtk_css_corner_value_get_y (corner, 100) <= 0;
+}
+
+/* Computes the area that the background of the box covers with
+ * opaque pixels, which is all of the background clip box if the
+ * background color is opaque and no corner is rounded.
+ */
+static gboolean
+get_opaque_rect (GtkCssStyle           *style,
+                 const GtkBorder       *border,
+                 const GtkBorder       *padding,
+                 int                    x,
+                 int                    y,
+                 int                    width,
+                 int                    height,
+                 cairo_rectangle_int_t *rect)
+{
+  const GdkRGBA *color;
+  GtkCssValue *clips;
+
+  color = _gtk_css_rgba_value_get_rgba (gtk_css_style_get_value (style, GTK_CSS_PROPERTY_BACKGROUND_COLOR));
+  if (color->alpha < 1.0)
+    return FALSE;
+
+  if (!has_square_corner (style, GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS) ||
+      !has_square_corner (style, GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS) ||
+      !has_square_corner (style, GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS) ||
+      !has_square_corner (style, GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS))
+    return FALSE;
+
+  /* The background color uses the clip of the bottom layer */
+  clips = gtk_css_style_get_value (style, GTK_CSS_PROPERTY_BACKGROUND_CLIP);
+  switch (_gtk_css_area_value_get (_gtk_css_array_value_get_nth (clips, _gtk_css_array_value_get_n_values (clips) - 1)))
+    {
+    case GTK_CSS_AREA_CONTENT_BOX:
+      x += padding->left;
+      y += padding->top;
+      width -= padding->left + padding->right;
+      height -= padding->top + padding->bottom;
+      /* fall through */
+    case GTK_CSS_AREA_PADDING_BOX:
+      x += border->left;
+      y += border->top;
+      width -= border->left + border->right;
+      height -= border->top + border->bottom;
+      break;
+    case GTK_CSS_AREA_BORDER_BOX:
+    default:
+      break;
+    }
+
+  if (width <= 0 || height <= 0)
+    return FALSE;
+
+  rect->x = x;
+  rect->y = y;
+  rect->width = width;
+  rect->height = height;
+
+  return TRUE;
+}
+
 /**
  * gtk_css_gadget_get_preferred_size:
  * @gadget: the #GtkCssGadget whose size is requested
@@ -722,6 +796,21 @@ gtk_css_gadget_draw (GtkCssGadget *gadget,
                                    width - margin.left - margin.right,
                                    height - margin.top - margin.bottom,
                                    gtk_css_node_get_junction_sides (priv->node));
+
+  /* Let the parent skip drawing what the widget covers up */
+  if (priv->owner && priv->node == gtk_widget_get_css_node (priv->owner))
+    {
+      cairo_rectangle_int_t opaque;
+
+      if (get_opaque_rect (style, &border, &padding,
+                           x + margin.left,
+                           y + margin.top,
+                           width - margin.left - margin.right,
+                           height - margin.top - margin.bottom,
+                           &opaque))
+        gtk_widget_set_opaque_rect (priv->owner, &opaque);
+    }
+
   gtk_css_style_render_border (style,
                                cr,
                                x + margin.left,
@@ -410,6 +410,73 @@ _gtk_css_image_get_surface (GtkCssImage     *image,
   return result;
 }
 
+/**
+ * _gtk_css_pattern_cache_lookup:
+ * @cache: the cache
+ * @width: width the pattern is for
+ * @height: height the pattern is for
+ *
+ * Looks up a pattern that was added with _gtk_css_pattern_cache_insert().
+ *
+ * Returns: (transfer none) (nullable): the pattern or %NULL
+ **/
+cairo_pattern_t *
+_gtk_css_pattern_cache_lookup (GtkCssPatternCache *cache,
+                               double              width,
+                               double              height)
+{
+  guint i;
+
+  for (i = 0; i < GTK_CSS_PATTERN_CACHE_SIZE; i++)
+    {
+      if (cache->entries[i].pattern != NULL &&
+          cache->entries[i].width == width &&
+          cache->entries[i].height == height)
+        return cache->entries[i].pattern;
+    }
+
+  return NULL;
+}
+
+/**
+ * _gtk_css_pattern_cache_insert:
+ * @cache: the cache
+ * @width: width the pattern is for
+ * @height: height the pattern is for
+ * @pattern: the pattern to keep
+ *
+ * Keeps a reference to @pattern, replacing the oldest pattern if
+ * the cache is full.
+ **/
+void
+_gtk_css_pattern_cache_insert (GtkCssPatternCache *cache,
+                               double              width,
+                               double              height,
+                               cairo_pattern_t    *pattern)
+{
+  guint i = cache->next;
+
+  if (cache->entries[i].pattern)
+    cairo_pattern_destroy (cache->entries[i].pattern);
+
+  cache->entries[i].width = width;
+  cache->entries[i].height = height;
+  cache->entries[i].pattern = cairo_pattern_reference (pattern);
+
+  cache->next = (i + 1) % GTK_CSS_PATTERN_CACHE_SIZE;
+}
+
+void
+_gtk_css_pattern_cache_clear (GtkCssPatternCache *cache)
+{
+  guint i;
+
+  for (i = 0; i < GTK_CSS_PATTERN_CACHE_SIZE; i++)
+    g_clear_pointer (&cache->entries[i].pattern, cairo_pattern_destroy);
+
+  cache->next = 0;
+}
+
 static GType
 gtk_css_image_get_parser_type (GtkCssParser *parser)
 {
@@ -140,6 +140,7 @@ gtk_css_image_linear_draw (GtkCssImage        *image,
   double length; /* distance in pixels for 100% */
   double start, end; /* position of first/last point on gradient line - with gradient line being [0, 1] */
   double offset;
+  double key_width, key_height;
   int i, last;
 
   if (linear->side)
@@ -175,6 +176,20 @@ gtk_css_image_linear_draw (GtkCssImage        *image,
                                             width, height,
                                             &x, &y);
 
+  /* Horizontal and vertical gradients only depend on one side */
+  key_width = x == 0 ? 0 : width;
+  key_height = y == 0 ? 0 : height;
+
+  pattern = _gtk_css_pattern_cache_lookup (&linear->patterns, key_width, key_height);
+  if (pattern)
+    {
+      cairo_rectangle (cr, 0, 0, width, height);
+      cairo_translate (cr, width / 2, height / 2);
+      cairo_set_source (cr, pattern);
+      cairo_fill (cr);
+      return;
+    }
+
   length = sqrt (x * x + y * y);
   gtk_css_image_linear_get_start_end (linear, length, &start, &end);
   pattern = cairo_pattern_create_linear (x * (start - 0.5), y * (start - 0.5),
@@ -233,6 +248,7 @@ gtk_css_image_linear_draw (GtkCssImage        *image,
   cairo_set_source (cr, pattern);
   cairo_fill (cr);
 
+  _gtk_css_pattern_cache_insert (&linear->patterns, key_width, key_height, pattern);
   cairo_pattern_destroy (pattern);
 }
 
@@ -574,6 +590,8 @@ gtk_css_image_linear_dispose (GObject *object)
 {
   GtkCssImageLinear *linear = GTK_CSS_IMAGE_LINEAR (object);
 
+  _gtk_css_pattern_cache_clear (&linear->patterns);
+
   if (linear->stops)
     {
       g_array_free (linear->stops, TRUE);
@@ -37,6 +37,21 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssImage           GtkCssImage;
 typedef struct _GtkCssImageClass      GtkCssImageClass;
+typedef struct _GtkCssPatternCache    GtkCssPatternCache;
+
+#define GTK_CSS_PATTERN_CACHE_SIZE 4
+
+/* The patterns an image was last drawn with, for the sizes they
+ * were drawn at */
+struct _GtkCssPatternCache
+{
+  struct {
+    double           width;
+    double           height;
+    cairo_pattern_t *pattern;
+  } entries[GTK_CSS_PATTERN_CACHE_SIZE];
+  guint next;
+};
 
 struct _GtkCssImage
 {
@@ -123,6 +138,16 @@ cairo_surface_t *
                                                     int                         surface_width,
                                                     int                         surface_height);
 
+cairo_pattern_t *
+               _gtk_css_pattern_cache_lookup       (GtkCssPatternCache         *cache,
+                                                    double                      width,
+                                                    double                      height);
+void           _gtk_css_pattern_cache_insert       (GtkCssPatternCache         *cache,
+                                                    double                      width,
+                                                    double                      height,
+                                                    cairo_pattern_t            *pattern);
+void           _gtk_css_pattern_cache_clear        (GtkCssPatternCache         *cache);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_IMAGE_PRIVATE_H__ */
@@ -92,6 +92,16 @@ gtk_css_image_radial_draw (GtkCssImage *image,
   x = _gtk_css_position_value_get_x (radial->position, width);
   y = _gtk_css_position_value_get_y (radial->position, height);
 
+  pattern = _gtk_css_pattern_cache_lookup (&radial->patterns, width, height);
+  if (pattern)
+    {
+      cairo_rectangle (cr, 0, 0, width, height);
+      cairo_translate (cr, x, y);
+      cairo_set_source (cr, pattern);
+      cairo_fill (cr);
+      return;
+    }
+
   if (radial->circle)
     {
       switch (radial->size)
@@ -224,6 +234,7 @@ gtk_css_image_radial_draw (GtkCssImage *image,
   cairo_set_source (cr, pattern);
   cairo_fill (cr);
 
+  _gtk_css_pattern_cache_insert (&radial->patterns, width, height, pattern);
   cairo_pattern_destroy (pattern);
 }
 
@@ -632,6 +643,8 @@ gtk_css_image_radial_dispose (GObject *object)
   GtkCssImageRadial *radial = GTK_CSS_IMAGE_RADIAL (object);
   int i;
 
+  _gtk_css_pattern_cache_clear (&radial->patterns);
+
   if (radial->stops)
     {
       g_array_free (radial->stops, TRUE);
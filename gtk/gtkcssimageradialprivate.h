@@ -59,6 +59,8 @@ struct _GtkCssImageRadial
   GtkCssRadialSize size;
   guint circle : 1;
   guint repeating :1;
+
+  GtkCssPatternCache patterns;
 };
 
 struct _GtkCssImageRadialClass
@@ -23,10 +23,13 @@
 
 #include "gtkcssimageurlprivate.h"
 #include "gtkcssimagesurfaceprivate.h"
+#include "gtkcssparserprivate.h"
 #include "gtkstyleproviderprivate.h"
 
 G_DEFINE_TYPE (GtkCssImageUrl, _gtk_css_image_url, GTK_TYPE_CSS_IMAGE)
 
+static gboolean print_uris = FALSE;
+
 static GtkCssImage *
 gtk_css_image_url_load_image (GtkCssImageUrl  *url,
                               GError         **error)
@@ -168,8 +171,19 @@ gtk_css_image_url_print (GtkCssImage *image,
                          GString     *string)
 {
   GtkCssImageUrl *url = GTK_CSS_IMAGE_URL (image);
+  char *uri;
+
+  if (!print_uris)
+    {
+      _gtk_css_image_print (gtk_css_image_url_load_image (url, NULL), string);
+      return;
+    }
 
-  _gtk_css_image_print (gtk_css_image_url_load_image (url, NULL), string);
+  uri = g_file_get_uri (url->file);
+  g_string_append (string, "url(");
+  _gtk_css_print_string (string, uri);
+  g_string_append (string, ")");
+  g_free (uri);
 }
 
 static void
@@ -205,3 +219,16 @@ _gtk_css_image_url_init (GtkCssImageUrl *image_url)
 {
 }
 
+/**
+ * _gtk_css_image_url_set_print_uris:
+ * @uris: %TRUE to print the URI of the file
+ *
+ * Makes url() images print the URI of their file instead of their
+ * contents, so that they are loaded again when the printed value is
+ * parsed. This is used when compiling style sheets.
+ **/
+void
+_gtk_css_image_url_set_print_uris (gboolean uris)
+{
+  print_uris = uris;
+}
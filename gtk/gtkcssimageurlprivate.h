@@ -49,6 +49,8 @@ struct _GtkCssImageUrlClass
 
 GType          _gtk_css_image_url_get_type             (void) G_GNUC_CONST;
 
+void           _gtk_css_image_url_set_print_uris       (gboolean        uris);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_IMAGE_URL_PRIVATE_H__ */
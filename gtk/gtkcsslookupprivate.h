@@ -35,6 +35,8 @@ typedef struct {
 
 struct _GtkCssLookup {
   GtkBitmask        *missing;
+  guint              threaded : 1;      /* done by a worker thread, providers must not parse */
+  guint              incomplete : 1;    /* a provider could not set a value without parsing */
   GtkCssLookupValue  values[GTK_CSS_PROPERTY_N_PROPERTIES];
 };
 
@@ -20,11 +20,16 @@
 #include "gtkcssnodeprivate.h"
 
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcssdependenciesprivate.h"
+#include "gtkcsslookupprivate.h"
+#include "gtkcssmatcherprivate.h"
 #include "gtkcsssectionprivate.h"
+#include "gtkcssselectorprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkintl.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
+#include "gtkstyleproviderprivate.h"
 #include "gtktypebuiltins.h"
 
 /*
@@ -87,6 +92,23 @@
  * if we need to change things. */
 #define GTK_CSS_RADICAL_CHANGE (GTK_CSS_CHANGE_ID | GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_CLASS | GTK_CSS_CHANGE_SOURCE | GTK_CSS_CHANGE_PARENT_STYLE)
 
+/* A style lookup that was done ahead of time by a worker thread,
+ * see gtk_css_node_prefetch_styles(). It is only valid as long as
+ * the generation matches lookup_generation. */
+struct _GtkCssNodePrefetch {
+  GtkStyleProviderPrivate *provider;
+  GtkCssLookup            *lookup;
+  GtkCssChange             change;
+  guint                    generation;
+};
+
+/* Increased whenever a node is invalidated from outside of validation
+ * and whenever a style provider changes */
+static guint lookup_generation = 0;
+
+static void gtk_css_node_invalidate_internal (GtkCssNode *cssnode, GtkCssChange change);
+static void gtk_css_node_invalidate_dependencies (GtkCssNode *cssnode, GtkCssChange change, GtkCssChange dependencies);
+
 G_DEFINE_TYPE (GtkCssNode, gtk_css_node, G_TYPE_OBJECT)
 
 enum {
@@ -242,11 +264,22 @@ gtk_css_node_dispose (GObject *object)
   G_OBJECT_CLASS (gtk_css_node_parent_class)->dispose (object);
 }
 
+static void
+gtk_css_node_prefetch_free (GtkCssNodePrefetch *prefetch)
+{
+  g_object_unref (prefetch->provider);
+  if (prefetch->lookup)
+    _gtk_css_lookup_free (prefetch->lookup);
+
+  g_slice_free (GtkCssNodePrefetch, prefetch);
+}
+
 static void
 gtk_css_node_finalize (GObject *object)
 {
   GtkCssNode *cssnode = GTK_CSS_NODE (object);
 
+  g_clear_pointer (&cssnode->prefetch, gtk_css_node_prefetch_free);
   if (cssnode->style)
     g_object_unref (cssnode->style);
   gtk_css_node_declaration_unref (cssnode->decl);
@@ -292,7 +325,14 @@ may_use_global_parent_cache (GtkCssNode *node)
   
   parent = gtk_css_node_get_parent (node);
   if (parent == NULL)
-    return FALSE;
+    {
+      GtkCssMatcher matcher;
+
+      /* Only root nodes that are matched as CSS nodes can be cached,
+       * widget paths might contain things the declaration doesn't. */
+      return gtk_css_node_init_matcher (node, &matcher) &&
+             _gtk_css_matcher_is_node (&matcher);
+    }
 
   provider = gtk_css_node_get_style_provider_or_null (node);
   if (provider != NULL && provider != gtk_css_node_get_style_provider (parent))
@@ -309,15 +349,15 @@ lookup_in_global_parent_cache (GtkCssNode                  *node,
 
   parent = node->parent;
 
-  if (parent == NULL ||
-      !may_use_global_parent_cache (node))
+  if (!may_use_global_parent_cache (node))
     return NULL;
 
-  if (parent->cache == NULL)
+  if (parent && parent->cache == NULL)
     return NULL;
 
   g_assert (node->cache == NULL);
-  node->cache = gtk_css_node_style_cache_lookup (parent->cache,
+  node->cache = gtk_css_node_style_cache_lookup (parent ? parent->cache : NULL,
+                                                 gtk_css_node_get_style_provider (node),
                                                  (GtkCssNodeDeclaration *) decl,
                                                  gtk_css_node_is_first_child (node),
                                                  gtk_css_node_is_last_child (node));
@@ -338,14 +378,14 @@ store_in_global_parent_cache (GtkCssNode                  *node,
 
   parent = node->parent;
 
-  if (parent == NULL ||
-      !may_use_global_parent_cache (node))
+  if (!may_use_global_parent_cache (node))
     return;
 
-  if (parent->cache == NULL)
+  if (parent && parent->cache == NULL)
     parent->cache = gtk_css_node_style_cache_new (parent->style);
 
-  node->cache = gtk_css_node_style_cache_insert (parent->cache,
+  node->cache = gtk_css_node_style_cache_insert (parent ? parent->cache : NULL,
+                                                 gtk_css_node_get_style_provider (node),
                                                  (GtkCssNodeDeclaration *) decl,
                                                  gtk_css_node_is_first_child (node),
                                                  gtk_css_node_is_last_child (node),
@@ -356,6 +396,7 @@ static GtkCssStyle *
 gtk_css_node_create_style (GtkCssNode *cssnode)
 {
   const GtkCssNodeDeclaration *decl;
+  GtkCssNodePrefetch *prefetch;
   GtkCssMatcher matcher;
   GtkCssStyle *parent;
   GtkCssStyle *style;
@@ -367,7 +408,16 @@ gtk_css_node_create_style (GtkCssNode *cssnode)
   if (style)
     return g_object_ref (style);
 
-  if (gtk_css_node_init_matcher (cssnode, &matcher))
+  prefetch = cssnode->prefetch;
+  if (prefetch &&
+      prefetch->generation == lookup_generation &&
+      prefetch->provider == gtk_css_node_get_style_provider (cssnode) &&
+      !prefetch->lookup->incomplete)
+    style = gtk_css_static_style_new_from_lookup (prefetch->provider,
+                                                  prefetch->lookup,
+                                                  prefetch->change,
+                                                  parent);
+  else if (gtk_css_node_init_matcher (cssnode, &matcher))
     style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
                                               &matcher,
                                               parent);
@@ -718,6 +768,7 @@ gtk_css_node_invalidate_style (GtkCssNode *cssnode)
     return;
 
   cssnode->style_is_invalid = TRUE;
+  cssnode->ancestor_filter_is_valid = FALSE;
   gtk_css_node_set_invalid (cssnode, TRUE);
   
   if (cssnode->first_child)
@@ -944,6 +995,22 @@ gtk_css_node_set_style (GtkCssNode  *cssnode,
   return style_changed;
 }
 
+/* Changes to the node itself can be ignored by its relatives,
+ * everything else was propagated to it and needs to be passed on. */
+static GtkCssChange
+gtk_css_node_get_change_for_child (GtkCssNode *cssnode)
+{
+  return _gtk_css_change_for_child (cssnode->pending_changes & ~GTK_CSS_CHANGE_ANY_SELF) |
+         (_gtk_css_change_for_child (cssnode->pending_changes & GTK_CSS_CHANGE_ANY_SELF) & ~cssnode->ignored_changes);
+}
+
+static GtkCssChange
+gtk_css_node_get_change_for_sibling (GtkCssNode *cssnode)
+{
+  return _gtk_css_change_for_sibling (cssnode->pending_changes & ~GTK_CSS_CHANGE_ANY_SELF) |
+         (_gtk_css_change_for_sibling (cssnode->pending_changes & GTK_CSS_CHANGE_ANY_SELF) & ~cssnode->ignored_changes);
+}
+
 static void
 gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
                                         gboolean    style_changed)
@@ -951,7 +1018,7 @@ gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
   GtkCssChange change, child_change;
   GtkCssNode *child;
 
-  change = _gtk_css_change_for_child (cssnode->pending_changes);
+  change = gtk_css_node_get_change_for_child (cssnode);
   if (style_changed)
     change |= GTK_CSS_CHANGE_PARENT_STYLE;
 
@@ -962,15 +1029,72 @@ gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
        child;
        child = gtk_css_node_get_next_sibling (child))
     {
-      child_change = child->pending_changes;
-      gtk_css_node_invalidate (child, change);
+      child_change = gtk_css_node_get_change_for_sibling (child);
+      gtk_css_node_invalidate_internal (child, change);
       if (child->visible)
-        change |= _gtk_css_change_for_sibling (child_change);
+        change |= child_change;
     }
 
   cssnode->needs_propagation = FALSE;
 }
 
+static void
+gtk_css_node_update_ancestor_filter (GtkCssNode *cssnode)
+{
+  GtkCssNode *parent = cssnode->parent;
+  const GtkCssAncestorFilter *parent_filter;
+  GtkCssMatcher parent_matcher;
+  const GQuark *classes;
+  guint i, n_classes;
+
+  if (parent == NULL)
+    {
+      gtk_css_ancestor_filter_init (&cssnode->ancestor_filter);
+      cssnode->ancestor_filter_is_valid = TRUE;
+      return;
+    }
+
+  /* The filter is only valid if the whole parent chain is matched via
+   * CSS nodes. Widget paths have their own idea of what parents are. */
+  if (!gtk_css_node_init_matcher (parent, &parent_matcher))
+    {
+      cssnode->ancestor_filter_is_valid = FALSE;
+      return;
+    }
+
+  parent_filter = _gtk_css_matcher_get_ancestor_filter (&parent_matcher);
+  if (parent_filter == NULL)
+    {
+      cssnode->ancestor_filter_is_valid = FALSE;
+      return;
+    }
+
+  cssnode->ancestor_filter = *parent_filter;
+
+  if (gtk_css_node_get_name (parent))
+    gtk_css_ancestor_filter_add (&cssnode->ancestor_filter,
+                                 gtk_css_ancestor_filter_hash_name (gtk_css_node_get_name (parent)));
+  if (gtk_css_node_get_id (parent))
+    gtk_css_ancestor_filter_add (&cssnode->ancestor_filter,
+                                 gtk_css_ancestor_filter_hash_id (gtk_css_node_get_id (parent)));
+
+  classes = gtk_css_node_list_classes (parent, &n_classes);
+  for (i = 0; i < n_classes; i++)
+    gtk_css_ancestor_filter_add (&cssnode->ancestor_filter,
+                                 gtk_css_ancestor_filter_hash_class (classes[i]));
+
+  cssnode->ancestor_filter_is_valid = TRUE;
+}
+
+const GtkCssAncestorFilter *
+gtk_css_node_get_ancestor_filter (GtkCssNode *cssnode)
+{
+  if (!cssnode->ancestor_filter_is_valid)
+    return NULL;
+
+  return &cssnode->ancestor_filter;
+}
+
 static gboolean
 gtk_css_node_needs_new_style (GtkCssNode *cssnode)
 {
@@ -998,11 +1122,15 @@ gtk_css_node_ensure_style (GtkCssNode *cssnode,
 
       g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
 
+      gtk_css_node_update_ancestor_filter (cssnode);
+
       new_style = GTK_CSS_NODE_GET_CLASS (cssnode)->update_style (cssnode,
-                                                                  cssnode->pending_changes,
+                                                                  cssnode->pending_changes & ~(cssnode->ignored_changes & GTK_CSS_CHANGE_ANY_SELF),
                                                                   current_time,
                                                                   cssnode->style);
 
+      g_clear_pointer (&cssnode->prefetch, gtk_css_node_prefetch_free);
+
       style_changed = gtk_css_node_set_style (cssnode, new_style);
       g_object_unref (new_style);
     }
@@ -1014,6 +1142,7 @@ gtk_css_node_ensure_style (GtkCssNode *cssnode,
   gtk_css_node_propagate_pending_changes (cssnode, style_changed);
 
   cssnode->pending_changes = 0;
+  cssnode->ignored_changes = 0;
   cssnode->style_is_invalid = FALSE;
 }
 
@@ -1101,9 +1230,14 @@ void
 gtk_css_node_set_name (GtkCssNode              *cssnode,
                        /*interned*/ const char *name)
 {
+  const char *old_name = gtk_css_node_get_name (cssnode);
+
   if (gtk_css_node_declaration_set_name (&cssnode->decl, name))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
+      gtk_css_node_invalidate_dependencies (cssnode,
+                                            GTK_CSS_CHANGE_NAME,
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_NAME, old_name) |
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_NAME, name));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_NAME]);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_WIDGET_TYPE]);
     }
@@ -1137,9 +1271,14 @@ void
 gtk_css_node_set_id (GtkCssNode                *cssnode,
                      /* interned */ const char *id)
 {
+  const char *old_id = gtk_css_node_get_id (cssnode);
+
   if (gtk_css_node_declaration_set_id (&cssnode->decl, id))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ID);
+      gtk_css_node_invalidate_dependencies (cssnode,
+                                            GTK_CSS_CHANGE_ID,
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_ID, old_id) |
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_ID, gtk_css_node_get_id (cssnode)));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_ID]);
     }
 }
@@ -1154,9 +1293,14 @@ void
 gtk_css_node_set_state (GtkCssNode    *cssnode,
                         GtkStateFlags  state_flags)
 {
+  GtkStateFlags old_state = gtk_css_node_get_state (cssnode);
+
   if (gtk_css_node_declaration_set_state (&cssnode->decl, state_flags))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_STATE);
+      gtk_css_node_invalidate_dependencies (cssnode,
+                                            GTK_CSS_CHANGE_STATE,
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_STATE,
+                                                                         GUINT_TO_POINTER (old_state ^ state_flags)));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_STATE]);
     }
 }
@@ -1183,9 +1327,17 @@ gtk_css_node_get_junction_sides (GtkCssNode *cssnode)
 static void
 gtk_css_node_clear_classes (GtkCssNode *cssnode)
 {
+  GtkCssChange dependencies = 0;
+  const GQuark *classes;
+  guint i, n_classes;
+
+  classes = gtk_css_node_list_classes (cssnode, &n_classes);
+  for (i = 0; i < n_classes; i++)
+    dependencies |= gtk_css_dependencies_lookup (GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (classes[i]));
+
   if (gtk_css_node_declaration_clear_classes (&cssnode->decl))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_dependencies (cssnode, GTK_CSS_CHANGE_CLASS, dependencies);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1236,7 +1388,9 @@ gtk_css_node_add_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_dependencies (cssnode,
+                                            GTK_CSS_CHANGE_CLASS,
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (style_class)));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1247,7 +1401,9 @@ gtk_css_node_remove_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_invalidate_dependencies (cssnode,
+                                            GTK_CSS_CHANGE_CLASS,
+                                            gtk_css_dependencies_lookup (GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (style_class)));
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1318,6 +1474,46 @@ gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
     }
 }
 
+/* Like gtk_css_node_invalidate_style_provider(), but only invalidates
+ * nodes that might be matched by one of the changed selectors in @keys.
+ * Children inherit their style, so they get invalidated as needed once
+ * their parent's style changed. */
+void
+gtk_css_node_invalidate_changed_selectors (GtkCssNode *cssnode,
+                                           GPtrArray  *keys)
+{
+  GtkCssMatcher matcher;
+  GtkCssNode *child;
+  guint i;
+
+  /* Keys can only be checked against the node itself. Nodes matched
+   * through a widget path might match things the node doesn't have. */
+  if (!gtk_css_node_init_matcher (cssnode, &matcher) ||
+      !_gtk_css_matcher_is_node (&matcher))
+    {
+      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+    }
+  else
+    {
+      for (i = 0; i < keys->len; i++)
+        {
+          if (_gtk_css_selector_key_matches (g_ptr_array_index (keys, i), &matcher))
+            {
+              gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+              break;
+            }
+        }
+    }
+
+  for (child = cssnode->first_child;
+       child;
+       child = child->next_sibling)
+    {
+      if (gtk_css_node_get_style_provider_or_null (child) == NULL)
+        gtk_css_node_invalidate_changed_selectors (child, keys);
+    }
+}
+
 static void
 gtk_css_node_invalidate_timestamp (GtkCssNode *cssnode)
 {
@@ -1349,9 +1545,9 @@ gtk_css_node_invalidate_frame_clock (GtkCssNode *cssnode,
     gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ANIMATIONS);
 }
 
-void
-gtk_css_node_invalidate (GtkCssNode   *cssnode,
-                         GtkCssChange  change)
+static void
+gtk_css_node_invalidate_internal (GtkCssNode   *cssnode,
+                                  GtkCssChange  change)
 {
   if (!cssnode->invalid)
     change &= ~GTK_CSS_CHANGE_TIMESTAMP;
@@ -1368,6 +1564,90 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
   gtk_css_node_invalidate_style (cssnode);
 }
 
+/* The values in prefetched lookups belong to the style providers,
+ * so they must not be used once a provider changed. Called for all
+ * changes, even those that don't invalidate any node. */
+void
+gtk_css_node_invalidate_prefetched_styles (void)
+{
+  lookup_generation++;
+}
+
+void
+gtk_css_node_invalidate (GtkCssNode   *cssnode,
+                         GtkCssChange  change)
+{
+  /* Propagating pending changes during validation uses the internal
+   * function. Everything else may change what a lookup finds. */
+  if (change & ~(GTK_CSS_CHANGE_TIMESTAMP | GTK_CSS_CHANGE_ANIMATIONS))
+    lookup_generation++;
+
+  cssnode->ignored_changes &= ~_gtk_css_change_for_dependents (change & GTK_CSS_CHANGE_ANY_SELF);
+
+  gtk_css_node_invalidate_internal (cssnode, change);
+}
+
+/* The ancestor filters of the descendants of @cssnode contain its
+ * name, id and classes. They must be kept up to date even when no
+ * descendant is restyled, as selectors added by a later reload of a
+ * style provider may depend on them. */
+static void
+gtk_css_node_update_descendant_filters (GtkCssNode *cssnode)
+{
+  GtkCssNode *child;
+
+  for (child = cssnode->first_child;
+       child;
+       child = child->next_sibling)
+    {
+      /* the filters below it are invalid, too */
+      if (!child->ancestor_filter_is_valid)
+        continue;
+
+      gtk_css_node_update_ancestor_filter (child);
+      gtk_css_node_update_descendant_filters (child);
+    }
+}
+
+/* Like gtk_css_node_invalidate() for a change of the name, id,
+ * classes or state of @cssnode, but only for the relatives that
+ * depend on it according to gtk_css_dependencies_lookup(). */
+static void
+gtk_css_node_invalidate_dependencies (GtkCssNode   *cssnode,
+                                      GtkCssChange  change,
+                                      GtkCssChange  dependencies)
+{
+  GtkCssChange all, ignored;
+
+  if (change & (GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_ID | GTK_CSS_CHANGE_CLASS))
+    gtk_css_node_update_descendant_filters (cssnode);
+
+  /* nodes that never computed a style need to do so first */
+  if (cssnode->style == gtk_css_static_style_get_default ())
+    {
+      gtk_css_node_invalidate (cssnode, change);
+      return;
+    }
+
+  lookup_generation++;
+
+  if (dependencies == 0)
+    return;
+
+  all = _gtk_css_change_for_dependents (change);
+  ignored = all & ~dependencies;
+  /* the children of the following siblings are reached via the siblings */
+  if (dependencies & _gtk_css_change_for_child (_gtk_css_change_for_sibling (change)))
+    ignored &= ~_gtk_css_change_for_sibling (change);
+
+  if (cssnode->pending_changes & change)
+    cssnode->ignored_changes &= ignored | ~all;
+  else
+    cssnode->ignored_changes = (cssnode->ignored_changes & ~all) | ignored;
+
+  gtk_css_node_invalidate_internal (cssnode, change);
+}
+
 void
 gtk_css_node_validate_internal (GtkCssNode *cssnode,
                                 gint64      timestamp)
@@ -1395,6 +1675,241 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
     }
 }
 
+/* Parallel style lookups
+ *
+ * Most of the time spent computing a style is spent finding the
+ * matching declarations. That only reads the node tree and the style
+ * providers, so when GTK_STYLE_THREADS is set, validation first does
+ * all lookups of a large update with a pool of worker threads. The
+ * lookups are then resolved into styles by the usual depth-first walk
+ * on the main thread, which also emits all signals in tree order.
+ * Resolving values stays on the main thread because it refs values,
+ * loads images and looks at settings, none of which is thread-safe.
+ *
+ * Only nodes that are matched as CSS nodes, like all their ancestors
+ * and the siblings of those, are looked up in parallel. Widget paths
+ * are created on demand and can't be used from other threads.
+ */
+
+/* below that many lookups, waking up the threads isn't worth it */
+#define PREFETCH_MIN_NODES 128
+/* number of lookups a thread takes at once */
+#define PREFETCH_CHUNK_SIZE 16
+
+typedef struct {
+  GtkCssNode    *node;
+  GtkCssMatcher  matcher;
+} PrefetchJob;
+
+typedef struct {
+  PrefetchJob *jobs;
+  guint        n_jobs;
+  gint         next_job;   /* atomic */
+
+  GMutex       mutex;
+  GCond        cond;
+  guint        n_running;
+} PrefetchBatch;
+
+static GThreadPool *prefetch_pool = NULL;
+
+static guint
+gtk_css_node_get_n_style_threads (void)
+{
+  static guint n_threads = G_MAXUINT;
+
+  if (G_UNLIKELY (n_threads == G_MAXUINT))
+    {
+      const char *env = g_getenv ("GTK_STYLE_THREADS");
+      guint64 n = 0;
+
+      if (env)
+        n = g_ascii_strtoull (env, NULL, 10);
+
+      n_threads = MIN (n, 64);
+    }
+
+  return n_threads;
+}
+
+static void
+prefetch_batch_run (PrefetchBatch *batch)
+{
+  guint i, end;
+
+  while (TRUE)
+    {
+      i = g_atomic_int_add (&batch->next_job, PREFETCH_CHUNK_SIZE);
+      if (i >= batch->n_jobs)
+        break;
+
+      end = MIN (i + PREFETCH_CHUNK_SIZE, batch->n_jobs);
+      for (; i < end; i++)
+        {
+          PrefetchJob *job = &batch->jobs[i];
+          GtkCssNodePrefetch *prefetch = job->node->prefetch;
+
+          prefetch->lookup = _gtk_css_lookup_new (NULL);
+          prefetch->lookup->threaded = TRUE;
+          prefetch->change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
+          _gtk_style_provider_private_lookup (prefetch->provider,
+                                              &job->matcher,
+                                              prefetch->lookup,
+                                              &prefetch->change);
+        }
+    }
+}
+
+static void
+prefetch_thread_func (gpointer data,
+                      gpointer user_data)
+{
+  PrefetchBatch *batch = data;
+
+  prefetch_batch_run (batch);
+
+  g_mutex_lock (&batch->mutex);
+  batch->n_running--;
+  g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+static gboolean
+gtk_css_node_init_node_matcher (GtkCssNode    *cssnode,
+                                GtkCssMatcher *matcher)
+{
+  return gtk_css_node_init_matcher (cssnode, matcher) &&
+         _gtk_css_matcher_is_node (matcher);
+}
+
+static gboolean
+gtk_css_node_children_are_nodes (GtkCssNode *cssnode)
+{
+  GtkCssMatcher matcher;
+  GtkCssNode *child;
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (!gtk_css_node_init_node_matcher (child, &matcher))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Collects the nodes that gtk_css_node_validate_internal() will most
+ * likely compute a new style for. @change is a guess for the changes
+ * that will be propagated from the parent. */
+static void
+gtk_css_node_collect_prefetch (GtkCssNode   *cssnode,
+                               GtkCssChange  change,
+                               GArray       *jobs)
+{
+  GtkCssChange child_change;
+  GtkCssNode *child;
+
+  if (!cssnode->invalid)
+    return;
+
+  change |= cssnode->pending_changes;
+  child_change = _gtk_css_change_for_child (change);
+
+  if (cssnode->style_is_invalid &&
+      gtk_css_style_needs_recreation (cssnode->style, change))
+    {
+      PrefetchJob job;
+
+      if (!gtk_css_node_init_node_matcher (cssnode, &job.matcher))
+        return;
+
+      /* the worker threads need it when matching */
+      gtk_css_node_update_ancestor_filter (cssnode);
+
+      job.node = cssnode;
+      if (cssnode->prefetch)
+        gtk_css_node_prefetch_free (cssnode->prefetch);
+      cssnode->prefetch = g_slice_new0 (GtkCssNodePrefetch);
+      cssnode->prefetch->provider = g_object_ref (gtk_css_node_get_style_provider (cssnode));
+      cssnode->prefetch->generation = lookup_generation;
+      g_array_append_val (jobs, job);
+
+      /* the new style will most likely differ */
+      child_change |= GTK_CSS_CHANGE_PARENT_STYLE;
+    }
+
+  if (!gtk_css_node_children_are_nodes (cssnode))
+    return;
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (child->visible)
+        gtk_css_node_collect_prefetch (child, child_change, jobs);
+    }
+}
+
+static void
+gtk_css_node_prefetch_styles (GtkCssNode *cssnode)
+{
+  PrefetchBatch batch;
+  GtkCssMatcher matcher;
+  GArray *jobs;
+  guint i, n_threads;
+
+  n_threads = gtk_css_node_get_n_style_threads ();
+  if (n_threads == 0)
+    return;
+
+  /* siblings of the root would need to be checked, too */
+  if (cssnode->parent != NULL ||
+      !gtk_css_node_init_node_matcher (cssnode, &matcher))
+    return;
+
+  jobs = g_array_new (FALSE, FALSE, sizeof (PrefetchJob));
+  gtk_css_node_collect_prefetch (cssnode, 0, jobs);
+
+  if (jobs->len < PREFETCH_MIN_NODES)
+    {
+      /* the nodes will compute their style the usual way */
+      for (i = 0; i < jobs->len; i++)
+        {
+          GtkCssNode *node = g_array_index (jobs, PrefetchJob, i).node;
+          g_clear_pointer (&node->prefetch, gtk_css_node_prefetch_free);
+        }
+      g_array_free (jobs, TRUE);
+      return;
+    }
+
+  if (prefetch_pool == NULL)
+    prefetch_pool = g_thread_pool_new (prefetch_thread_func, NULL, n_threads, FALSE, NULL);
+
+  batch.jobs = (PrefetchJob *) jobs->data;
+  batch.n_jobs = jobs->len;
+  batch.next_job = 0;
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+
+  n_threads = MIN (n_threads, (batch.n_jobs - 1) / PREFETCH_CHUNK_SIZE);
+  batch.n_running = n_threads;
+  for (i = 0; i < n_threads; i++)
+    g_thread_pool_push (prefetch_pool, &batch, NULL);
+
+  /* help out instead of just waiting */
+  prefetch_batch_run (&batch);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.n_running > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+  g_array_free (jobs, TRUE);
+}
+
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
@@ -1402,6 +1917,8 @@ gtk_css_node_validate (GtkCssNode *cssnode)
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
+  gtk_css_node_prefetch_styles (cssnode);
+
   gtk_css_node_validate_internal (cssnode, timestamp);
 }
 
@@ -18,6 +18,7 @@
 #ifndef __GTK_CSS_NODE_PRIVATE_H__
 #define __GTK_CSS_NODE_PRIVATE_H__
 
+#include "gtkcssancestorfilterprivate.h"
 #include "gtkcssnodedeclarationprivate.h"
 #include "gtkcssnodestylecacheprivate.h"
 #include "gtkcssstylechangeprivate.h"
@@ -34,6 +35,7 @@ G_BEGIN_DECLS
 #define GTK_CSS_NODE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GTK_TYPE_CSS_NODE, GtkCssNodeClass))
 
 typedef struct _GtkCssNodeClass         GtkCssNodeClass;
+typedef struct _GtkCssNodePrefetch      GtkCssNodePrefetch;
 
 struct _GtkCssNode
 {
@@ -48,8 +50,12 @@ struct _GtkCssNode
   GtkCssNodeDeclaration *decl;
   GtkCssStyle           *style;
   GtkCssNodeStyleCache  *cache;                 /* cache for children to look up styles */
+  GtkCssNodePrefetch    *prefetch;              /* lookup done by a worker thread or NULL */
 
   GtkCssChange           pending_changes;       /* changes that accumulated since the style was last computed */
+  GtkCssChange           ignored_changes;       /* changes caused by pending_changes that no style depends on */
+
+  GtkCssAncestorFilter   ancestor_filter;       /* names, ids and classes of all parents, for selector matching */
 
   guint                  visible :1;            /* node will be skipped when validating or computing styles */
   guint                  invalid :1;            /* node or a child needs to be validated (even if just for animation) */
@@ -60,6 +66,7 @@ struct _GtkCssNode
    * So if a valid style is computed, one has to previously ensure that the parent's and the previous sibling's style
    * are valid. This allows both validation and invalidation to run in O(nodes-in-tree) */
   guint                  style_is_invalid :1;   /* the style needs to be recomputed */
+  guint                  ancestor_filter_is_valid :1; /* ancestor_filter is up to date and can be used for matching */
 };
 
 struct _GtkCssNodeClass
@@ -156,10 +163,17 @@ GList *                 gtk_css_node_list_regions       (GtkCssNode            *
 const GtkCssNodeDeclaration *
                         gtk_css_node_get_declaration    (GtkCssNode            *cssnode);
 GtkCssStyle *           gtk_css_node_get_style          (GtkCssNode            *cssnode);
+const GtkCssAncestorFilter *
+                        gtk_css_node_get_ancestor_filter(GtkCssNode            *cssnode);
 
 
 void                    gtk_css_node_invalidate_style_provider
                                                         (GtkCssNode            *cssnode);
+void                    gtk_css_node_invalidate_prefetched_styles
+                                                        (void);
+void                    gtk_css_node_invalidate_changed_selectors
+                                                        (GtkCssNode            *cssnode,
+                                                         GPtrArray             *keys);
 void                    gtk_css_node_invalidate_frame_clock
                                                         (GtkCssNode            *cssnode,
                                                          gboolean               just_timestamp);
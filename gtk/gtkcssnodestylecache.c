@@ -22,15 +22,57 @@
 #include "gtkdebug.h"
 #include "gtkcssstaticstyleprivate.h"
 
+/* All cached styles live in one process-wide table, so that identical
+ * node trees (like multiple instances of the same window) share their
+ * styles. An entry is identified by its parent entry, the style provider,
+ * the node declaration and the position of the node among its siblings.
+ * As the parent entry itself is identified by its parent, a key covers
+ * the declarations of all ancestors, which is what selectors match on.
+ *
+ * The table only keeps a limited number of entries alive. Entries are
+ * evicted in least recently used order when the memory budget is
+ * exceeded. Nodes keep their entries alive on their own.
+ */
+
+/* in kilobytes, can be overridden with GTK_STYLE_CACHE_SIZE */
+#define DEFAULT_BUDGET 2048
+
+/* An estimate, the values themselves are shared between styles */
+#define ENTRY_SIZE (sizeof (GtkCssNodeStyleCache) + sizeof (GtkCssStaticStyle))
+
 struct _GtkCssNodeStyleCache {
-  guint        ref_count;
-  GtkCssStyle *style;
-  GHashTable  *children;
+  guint                    ref_count;
+  GtkCssNodeStyleCache    *parent;
+  GtkStyleProviderPrivate *provider;
+  GtkCssNodeDeclaration   *decl;
+  guint                    is_first :1;
+  guint                    is_last :1;
+  guint                    in_cache :1;
+  GtkCssStyle             *style;
+  GList                    lru_link;
 };
 
-#define UNPACK_DECLARATION(packed) ((GtkCssNodeDeclaration *) (GPOINTER_TO_SIZE (packed) & ~0x3))
-#define UNPACK_FLAGS(packed) (GPOINTER_TO_SIZE (packed) & 0x3)
-#define PACK(decl, first_child, last_child) GSIZE_TO_POINTER (GPOINTER_TO_SIZE (decl) | ((first_child) ? 0x2 : 0) | ((last_child) ? 0x1 : 0))
+static GHashTable *cache = NULL;
+static GQueue lru = G_QUEUE_INIT;
+static gsize budget = 0;
+static GtkCssNodeStyleCacheStats stats = { 0, };
+
+static gsize
+gtk_css_node_style_cache_get_budget (void)
+{
+  if (G_UNLIKELY (budget == 0))
+    {
+      const char *env = g_getenv ("GTK_STYLE_CACHE_SIZE");
+      guint64 size = 0;
+
+      if (env)
+        size = g_ascii_strtoull (env, NULL, 10);
+
+      budget = (size > 0 ? size : DEFAULT_BUDGET) * 1024;
+    }
+
+  return budget;
+}
 
 GtkCssNodeStyleCache *
 gtk_css_node_style_cache_new (GtkCssStyle *style)
@@ -41,6 +83,7 @@ gtk_css_node_style_cache_new (GtkCssStyle *style)
 
   result->ref_count = 1;
   result->style = g_object_ref (style);
+  result->lru_link.data = result;
 
   return result;
 }
@@ -61,9 +104,15 @@ gtk_css_node_style_cache_unref (GtkCssNodeStyleCache *cache)
   if (cache->ref_count > 0)
     return;
 
+  g_assert (!cache->in_cache);
+
   g_object_unref (cache->style);
-  if (cache->children)
-    g_hash_table_unref (cache->children);
+  if (cache->decl)
+    gtk_css_node_declaration_unref (cache->decl);
+  if (cache->provider)
+    g_object_unref (cache->provider);
+  if (cache->parent)
+    gtk_css_node_style_cache_unref (cache->parent);
 
   g_slice_free (GtkCssNodeStyleCache, cache);
 }
@@ -112,71 +161,140 @@ may_be_stored_in_cache (GtkCssStyle *style)
 }
 
 static guint
-gtk_css_node_style_cache_decl_hash (gconstpointer item)
+gtk_css_node_style_cache_hash (gconstpointer item)
 {
-  return gtk_css_node_declaration_hash (UNPACK_DECLARATION (item)) << 2
-    | UNPACK_FLAGS (item);
+  const GtkCssNodeStyleCache *entry = item;
+  guint hash;
+
+  hash = gtk_css_node_declaration_hash (entry->decl);
+  hash ^= GPOINTER_TO_UINT (entry->parent) * 31;
+  hash ^= GPOINTER_TO_UINT (entry->provider);
+
+  return hash << 2 | entry->is_first << 1 | entry->is_last;
 }
 
 static gboolean
-gtk_css_node_style_cache_decl_equal (gconstpointer item1,
-                                     gconstpointer item2)
+gtk_css_node_style_cache_equal (gconstpointer item1,
+                                gconstpointer item2)
 {
-  if (UNPACK_FLAGS (item1) != UNPACK_FLAGS (item2))
-    return FALSE;
-
-  return gtk_css_node_declaration_equal (UNPACK_DECLARATION (item1),
-                                         UNPACK_DECLARATION (item2));
+  const GtkCssNodeStyleCache *entry1 = item1;
+  const GtkCssNodeStyleCache *entry2 = item2;
+
+  return entry1->parent == entry2->parent &&
+         entry1->provider == entry2->provider &&
+         entry1->is_first == entry2->is_first &&
+         entry1->is_last == entry2->is_last &&
+         gtk_css_node_declaration_equal (entry1->decl, entry2->decl);
 }
 
 static void
-gtk_css_node_style_cache_decl_free (gpointer item)
+gtk_css_node_style_cache_evict (GtkCssNodeStyleCache *entry)
 {
-  gtk_css_node_declaration_unref (UNPACK_DECLARATION (item));
+  g_assert (entry->in_cache);
+
+  g_hash_table_remove (cache, entry);
+  g_queue_unlink (&lru, &entry->lru_link);
+  entry->in_cache = FALSE;
+  stats.size -= ENTRY_SIZE;
+  stats.n_entries--;
+  stats.evictions++;
+
+  gtk_css_node_style_cache_unref (entry);
 }
 
 GtkCssNodeStyleCache *
-gtk_css_node_style_cache_insert (GtkCssNodeStyleCache   *parent,
-                                 GtkCssNodeDeclaration  *decl,
-                                 gboolean                is_first,
-                                 gboolean                is_last,
-                                 GtkCssStyle            *style)
+gtk_css_node_style_cache_insert (GtkCssNodeStyleCache    *parent,
+                                 GtkStyleProviderPrivate *provider,
+                                 GtkCssNodeDeclaration   *decl,
+                                 gboolean                 is_first,
+                                 gboolean                 is_last,
+                                 GtkCssStyle             *style)
 {
-  GtkCssNodeStyleCache *result;
+  GtkCssNodeStyleCache *result, *existing;
 
   if (!may_be_stored_in_cache (style))
     return NULL;
 
-  if (parent->children == NULL)
-    parent->children = g_hash_table_new_full (gtk_css_node_style_cache_decl_hash,
-                                              gtk_css_node_style_cache_decl_equal,
-                                              gtk_css_node_style_cache_decl_free,
-                                              (GDestroyNotify) gtk_css_node_style_cache_unref);
+  if (cache == NULL)
+    cache = g_hash_table_new (gtk_css_node_style_cache_hash,
+                              gtk_css_node_style_cache_equal);
 
   result = gtk_css_node_style_cache_new (style);
-
-  g_hash_table_insert (parent->children,
-                       PACK (gtk_css_node_declaration_ref (decl), is_first, is_last),
-                       gtk_css_node_style_cache_ref (result));
+  result->parent = parent ? gtk_css_node_style_cache_ref (parent) : NULL;
+  result->provider = g_object_ref (provider);
+  result->decl = gtk_css_node_declaration_ref (decl);
+  result->is_first = is_first;
+  result->is_last = is_last;
+
+  existing = g_hash_table_lookup (cache, result);
+  if (existing)
+    {
+      /* not counted as an eviction, it's the same style */
+      gtk_css_node_style_cache_evict (existing);
+      stats.evictions--;
+    }
+
+  g_hash_table_add (cache, gtk_css_node_style_cache_ref (result));
+  g_queue_push_head_link (&lru, &result->lru_link);
+  result->in_cache = TRUE;
+  stats.size += ENTRY_SIZE;
+  stats.n_entries++;
+
+  while (stats.size > gtk_css_node_style_cache_get_budget () && lru.tail)
+    gtk_css_node_style_cache_evict (lru.tail->data);
 
   return result;
 }
 
 GtkCssNodeStyleCache *
-gtk_css_node_style_cache_lookup (GtkCssNodeStyleCache   *parent,
-                                 GtkCssNodeDeclaration  *decl,
-                                 gboolean                is_first,
-                                 gboolean                is_last)
+gtk_css_node_style_cache_lookup (GtkCssNodeStyleCache    *parent,
+                                 GtkStyleProviderPrivate *provider,
+                                 GtkCssNodeDeclaration   *decl,
+                                 gboolean                 is_first,
+                                 gboolean                 is_last)
 {
+  GtkCssNodeStyleCache key = { 0, };
   GtkCssNodeStyleCache *result;
 
-  if (parent->children == NULL)
-    return NULL;
+  if (cache == NULL)
+    {
+      stats.misses++;
+      return NULL;
+    }
+
+  key.parent = parent;
+  key.provider = provider;
+  key.decl = decl;
+  key.is_first = is_first;
+  key.is_last = is_last;
 
-  result = g_hash_table_lookup (parent->children, PACK (decl, is_first, is_last));
+  result = g_hash_table_lookup (cache, &key);
   if (result == NULL)
-    return NULL;
+    {
+      stats.misses++;
+      return NULL;
+    }
+
+  stats.hits++;
+  g_queue_unlink (&lru, &result->lru_link);
+  g_queue_push_head_link (&lru, &result->lru_link);
 
   return gtk_css_node_style_cache_ref (result);
 }
 
+void
+gtk_css_node_style_cache_clear (void)
+{
+  while (lru.tail)
+    {
+      gtk_css_node_style_cache_evict (lru.tail->data);
+      stats.evictions--;
+    }
+}
+
+void
+gtk_css_node_style_cache_get_stats (GtkCssNodeStyleCacheStats *out_stats)
+{
+  *out_stats = stats;
+  out_stats->budget = gtk_css_node_style_cache_get_budget ();
+}
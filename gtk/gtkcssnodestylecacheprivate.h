@@ -20,10 +20,21 @@
 
 #include "gtkcssnodedeclarationprivate.h"
 #include "gtkcssstyleprivate.h"
+#include "gtkstyleproviderprivate.h"
 
 G_BEGIN_DECLS
 
 typedef struct _GtkCssNodeStyleCache GtkCssNodeStyleCache;
+typedef struct _GtkCssNodeStyleCacheStats GtkCssNodeStyleCacheStats;
+
+struct _GtkCssNodeStyleCacheStats {
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+  guint   n_entries;
+  gsize   size;             /* estimated, in bytes */
+  gsize   budget;
+};
 
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_new            (GtkCssStyle            *style);
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_ref            (GtkCssNodeStyleCache   *cache);
@@ -32,15 +43,20 @@ void                    gtk_css_node_style_cache_unref          (GtkCssNodeStyle
 GtkCssStyle *           gtk_css_node_style_cache_get_style      (GtkCssNodeStyleCache   *cache);
 
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_insert         (GtkCssNodeStyleCache   *parent,
+                                                                 GtkStyleProviderPrivate *provider,
                                                                  GtkCssNodeDeclaration  *decl,
                                                                  gboolean                is_first,
                                                                  gboolean                is_last,
                                                                  GtkCssStyle            *style);
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_lookup         (GtkCssNodeStyleCache   *parent,
+                                                                 GtkStyleProviderPrivate *provider,
                                                                  GtkCssNodeDeclaration  *decl,
                                                                  gboolean                is_first,
                                                                  gboolean                is_last);
 
+void                    gtk_css_node_style_cache_clear          (void);
+void                    gtk_css_node_style_cache_get_stats      (GtkCssNodeStyleCacheStats *out_stats);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_NODE_STYLE_CACHE_PRIVATE_H__ */
@@ -28,6 +28,8 @@
 #include "gtkbitmaskprivate.h"
 #include "gtkcssarrayvalueprivate.h"
 #include "gtkcsscolorvalueprivate.h"
+#include "gtkcssimageurlprivate.h"
+#include "gtkcssinitialvalueprivate.h"
 #include "gtkcsskeyframesprivate.h"
 #include "gtkcssparserprivate.h"
 #include "gtkcsssectionprivate.h"
@@ -79,6 +81,9 @@ typedef struct GtkCssRuleset GtkCssRuleset;
 typedef struct _GtkCssScanner GtkCssScanner;
 typedef struct _PropertyValue PropertyValue;
 typedef struct _WidgetPropertyValue WidgetPropertyValue;
+typedef struct _RulesetInfo RulesetInfo;
+typedef struct _ReloadState ReloadState;
+typedef struct _CompiledSource CompiledSource;
 typedef enum ParserScope ParserScope;
 typedef enum ParserSymbol ParserSymbol;
 
@@ -86,6 +91,7 @@ struct _PropertyValue {
   GtkCssStyleProperty *property;
   GtkCssValue         *value;
   GtkCssSection       *section;
+  const char          *text;    /* not yet parsed value from a compiled style sheet */
 };
 
 struct _WidgetPropertyValue {
@@ -96,6 +102,24 @@ struct _WidgetPropertyValue {
   GtkCssSection *section;
 };
 
+/* What is needed to find out which rulesets changed on reload.
+ * Only created when reloading, not for every load. */
+struct _RulesetInfo {
+  char *text;                   /* selector and declarations */
+  GtkCssSelectorKey key;
+};
+
+struct _ReloadState {
+  GPtrArray *ruleset_infos;     /* NULL if the provider was empty */
+  char *definitions;
+};
+
+/* A file that went into a compiled style sheet */
+struct _CompiledSource {
+  GFile *file;
+  char *checksum;
+};
+
 struct GtkCssRuleset
 {
   GtkCssSelector *selector;
@@ -104,6 +128,7 @@ struct GtkCssRuleset
   PropertyValue *styles;
   GtkBitmask *set_styles;
   guint n_styles;
+  guint position;               /* in source order */
   guint owns_styles : 1;
   guint owns_widget_style : 1;
 };
@@ -126,7 +151,11 @@ struct _GtkCssProviderPrivate
 
   GArray *rulesets;
   GtkCssSelectorTree *tree;
+  GtkCssDependencies *dependencies;     /* what nodes depend on, for invalidation */
   GResource *resource;
+
+  GBytes *compiled;             /* data of a loaded compiled style sheet */
+  GPtrArray *sources;           /* CompiledSource, only when compiling */
 };
 
 enum {
@@ -152,6 +181,9 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GFile          *file,
                                 const char     *data,
                                 GError        **error);
+static void gtk_css_ruleset_print_declarations (const GtkCssRuleset *ruleset,
+                                                GString             *str);
+static char *gtk_css_provider_print_definitions (GtkCssProvider *css_provider);
 
 GQuark
 gtk_css_provider_error_quark (void)
@@ -284,6 +316,43 @@ gtk_css_ruleset_clear (GtkCssRuleset *ruleset)
   memset (ruleset, 0, sizeof (GtkCssRuleset));
 }
 
+static RulesetInfo *
+ruleset_info_new (const GtkCssRuleset *ruleset)
+{
+  RulesetInfo *info;
+  GString *str;
+
+  info = g_slice_new (RulesetInfo);
+
+  /* The selector is usually freed by now, but the tree keeps it */
+  str = g_string_new (NULL);
+  _gtk_css_selector_tree_match_print (ruleset->selector_match, str);
+  gtk_css_ruleset_print_declarations (ruleset, str);
+  info->text = g_string_free (str, FALSE);
+
+  _gtk_css_selector_tree_match_key_init (&info->key, ruleset->selector_match);
+
+  return info;
+}
+
+static void
+ruleset_info_free (gpointer data)
+{
+  RulesetInfo *info = data;
+
+  g_free (info->text);
+  _gtk_css_selector_key_clear (&info->key);
+
+  g_slice_free (RulesetInfo, info);
+}
+
+static gboolean
+ruleset_info_equal (const RulesetInfo *a,
+                    const RulesetInfo *b)
+{
+  return strcmp (a->text, b->text) == 0;
+}
+
 static WidgetPropertyValue *
 widget_property_value_new (char *name, GtkCssSection *section)
 {
@@ -391,12 +460,40 @@ gtk_css_ruleset_add (GtkCssRuleset       *ruleset,
     }
 
   ruleset->styles[i].value = value;
+  ruleset->styles[i].text = NULL;
   if (gtk_keep_css_sections)
     ruleset->styles[i].section = gtk_css_section_ref (section);
   else
     ruleset->styles[i].section = NULL;
 }
 
+/* Adds a value from a compiled style sheet. It is only parsed
+ * once it is needed, see gtk_css_provider_get_property_value().
+ * @text must stay around as long as the ruleset. */
+static void
+gtk_css_ruleset_add_compiled (GtkCssRuleset       *ruleset,
+                              GtkCssStyleProperty *property,
+                              const char          *text)
+{
+  guint i;
+
+  if (ruleset->set_styles == NULL)
+    ruleset->set_styles = _gtk_bitmask_new ();
+
+  ruleset->set_styles = _gtk_bitmask_set (ruleset->set_styles,
+                                          _gtk_css_style_property_get_id (property),
+                                          TRUE);
+
+  ruleset->owns_styles = TRUE;
+
+  i = ruleset->n_styles++;
+  ruleset->styles = g_realloc (ruleset->styles, ruleset->n_styles * sizeof (PropertyValue));
+  ruleset->styles[i].property = property;
+  ruleset->styles[i].value = NULL;
+  ruleset->styles[i].section = NULL;
+  ruleset->styles[i].text = text;
+}
+
 static void
 gtk_css_scanner_destroy (GtkCssScanner *scanner)
 {
@@ -564,6 +661,41 @@ verify_tree_match_results (GtkCssProvider *provider,
 #endif
 }
 
+static void
+verify_tree_filter_results (GtkCssProvider      *provider,
+                            const GtkCssMatcher *matcher,
+                            GPtrArray           *tree_rules)
+{
+#ifdef VERIFY_TREE
+  GPtrArray *unfiltered_rules;
+  guint i, n_filtered, n_unfiltered;
+
+  unfiltered_rules = _gtk_css_selector_tree_match_all_unfiltered (provider->priv->tree, matcher);
+
+  n_filtered = tree_rules ? tree_rules->len : 0;
+  n_unfiltered = unfiltered_rules ? unfiltered_rules->len : 0;
+
+  if (n_filtered != n_unfiltered)
+    g_error ("ancestor filter changed number of matched rules from %u to %u\n",
+             n_unfiltered, n_filtered);
+
+  /* both arrays are sorted */
+  for (i = 0; i < n_filtered; i++)
+    {
+      if (tree_rules->pdata[i] != unfiltered_rules->pdata[i])
+        {
+          GtkCssRuleset *ruleset = unfiltered_rules->pdata[i];
+
+          g_error ("ancestor filter wrongly rejected rule '%s'\n",
+                   _gtk_css_selector_to_string (ruleset->selector));
+        }
+    }
+
+  if (unfiltered_rules)
+    g_ptr_array_free (unfiltered_rules, TRUE);
+#endif
+}
+
 static void
 verify_tree_get_change_results (GtkCssProvider *provider,
 				const GtkCssMatcher *matcher,
@@ -725,6 +857,45 @@ gtk_css_style_provider_get_keyframes (GtkStyleProviderPrivate *provider,
   return g_hash_table_lookup (css_provider->priv->keyframes, name);
 }
 
+/* Returns %NULL if the value still needs to be parsed and @lookup is
+ * done by a worker thread, see gtk_css_node_validate(). Parsing creates
+ * shared values and may emit errors, so it only happens on the main
+ * thread, which redoes such lookups itself. */
+static GtkCssValue *
+gtk_css_provider_get_property_value (GtkCssProvider *css_provider,
+                                     PropertyValue  *prop,
+                                     GtkCssLookup   *lookup)
+{
+  GtkCssScanner *scanner;
+  GtkCssValue *value;
+
+  if (prop->value)
+    return prop->value;
+
+  if (lookup->threaded)
+    return NULL;
+
+  scanner = gtk_css_scanner_new (css_provider, NULL, NULL, NULL, prop->text);
+  gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_VALUE);
+
+  value = _gtk_style_property_parse_value (GTK_STYLE_PROPERTY (prop->property),
+                                           scanner->parser);
+  if (value == NULL)
+    {
+      /* The compiled file was checked to be written by this version
+       * of GTK+, so this should not happen. The error has been emitted
+       * already, don't try again. */
+      value = _gtk_css_initial_value_new ();
+    }
+
+  gtk_css_scanner_pop_section (scanner, GTK_CSS_SECTION_VALUE);
+  gtk_css_scanner_destroy (scanner);
+
+  prop->value = value;
+
+  return value;
+}
+
 static void
 gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
                                const GtkCssMatcher     *matcher,
@@ -742,6 +913,7 @@ gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
   priv = css_provider->priv;
 
   tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
+  verify_tree_filter_results (css_provider, matcher, tree_rules);
   if (tree_rules)
     {
       verify_tree_match_results (css_provider, matcher, tree_rules);
@@ -761,14 +933,22 @@ gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
             {
               GtkCssStyleProperty *prop = ruleset->styles[j].property;
               guint id = _gtk_css_style_property_get_id (prop);
+              GtkCssValue *value;
 
               if (!_gtk_css_lookup_is_missing (lookup, id))
                 continue;
 
+              value = gtk_css_provider_get_property_value (css_provider, &ruleset->styles[j], lookup);
+              if (value == NULL)
+                {
+                  lookup->incomplete = TRUE;
+                  continue;
+                }
+
               _gtk_css_lookup_set (lookup,
                                    id,
                                    ruleset->styles[j].section,
-                                  ruleset->styles[j].value);
+                                   value);
             }
 
           if (_gtk_bitmask_is_empty (_gtk_css_lookup_get_missing (lookup)))
@@ -813,6 +993,7 @@ gtk_css_provider_finalize (GObject *object)
 
   g_array_free (priv->rulesets, TRUE);
   _gtk_css_selector_tree_free (priv->tree);
+  g_clear_pointer (&priv->dependencies, gtk_css_dependencies_free);
 
   g_hash_table_destroy (priv->symbolic_colors);
   g_hash_table_destroy (priv->keyframes);
@@ -824,6 +1005,11 @@ gtk_css_provider_finalize (GObject *object)
       priv->resource = NULL;
     }
 
+  if (priv->compiled)
+    g_bytes_unref (priv->compiled);
+  if (priv->sources)
+    g_ptr_array_unref (priv->sources);
+
   G_OBJECT_CLASS (gtk_css_provider_parent_class)->finalize (object);
 }
 
@@ -952,7 +1138,139 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
   g_array_set_size (priv->rulesets, 0);
   _gtk_css_selector_tree_free (priv->tree);
   priv->tree = NULL;
+  g_clear_pointer (&priv->dependencies, gtk_css_dependencies_free);
 
+  /* after the rulesets, they point into it */
+  if (priv->compiled)
+    {
+      g_bytes_unref (priv->compiled);
+      priv->compiled = NULL;
+    }
+  if (priv->sources)
+    g_ptr_array_set_size (priv->sources, 0);
+}
+
+/* If a reload changes fewer rulesets than this, only the nodes affected
+ * by those rulesets get restyled. Otherwise everything does. */
+#define MAX_INCREMENTAL_CHANGES 64
+
+/* Returns the RulesetInfos of all rulesets in source order */
+static GPtrArray *
+gtk_css_provider_get_ruleset_infos (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GPtrArray *infos;
+  guint i;
+
+  infos = g_ptr_array_new_with_free_func (ruleset_info_free);
+  g_ptr_array_set_size (infos, priv->rulesets->len);
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+
+      g_ptr_array_index (infos, ruleset->position) = ruleset_info_new (ruleset);
+    }
+
+  return infos;
+}
+
+static void
+gtk_css_provider_save_state (GtkCssProvider *css_provider,
+                             ReloadState    *state)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+
+  /* The first load changes everything anyway */
+  if (priv->rulesets->len == 0 &&
+      g_hash_table_size (priv->symbolic_colors) == 0 &&
+      g_hash_table_size (priv->keyframes) == 0)
+    {
+      state->definitions = NULL;
+      state->ruleset_infos = NULL;
+      return;
+    }
+
+  state->definitions = gtk_css_provider_print_definitions (css_provider);
+  state->ruleset_infos = gtk_css_provider_get_ruleset_infos (css_provider);
+}
+
+/* Emits the change from @state to the current contents. Rulesets are
+ * compared in source order: all rulesets between the first and the
+ * last difference are considered changed, so that reordering rules is
+ * noticed, too.
+ */
+static void
+gtk_css_provider_emit_changes (GtkCssProvider *css_provider,
+                               ReloadState    *state)
+{
+  GPtrArray *old = state->ruleset_infos;
+  GPtrArray *new = NULL;
+  char *definitions;
+  guint prefix, suffix, min_len, n_changed, i;
+
+  if (old == NULL)
+    {
+      _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+      return;
+    }
+
+  definitions = gtk_css_provider_print_definitions (css_provider);
+  if (!g_str_equal (definitions, state->definitions))
+    {
+      /* colors and keyframes can be used by any ruleset */
+      _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+      goto out;
+    }
+
+  new = gtk_css_provider_get_ruleset_infos (css_provider);
+
+  min_len = MIN (old->len, new->len);
+
+  for (prefix = 0; prefix < min_len; prefix++)
+    {
+      if (!ruleset_info_equal (g_ptr_array_index (old, prefix),
+                               g_ptr_array_index (new, prefix)))
+        break;
+    }
+
+  for (suffix = 0; suffix < min_len - prefix; suffix++)
+    {
+      if (!ruleset_info_equal (g_ptr_array_index (old, old->len - suffix - 1),
+                               g_ptr_array_index (new, new->len - suffix - 1)))
+        break;
+    }
+
+  n_changed = old->len + new->len - 2 * (prefix + suffix);
+
+  if (n_changed == 0)
+    {
+      /* nothing changed */
+    }
+  else if (n_changed > MAX_INCREMENTAL_CHANGES)
+    {
+      _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+    }
+  else
+    {
+      GPtrArray *keys = g_ptr_array_sized_new (n_changed);
+
+      for (i = prefix; i < old->len - suffix; i++)
+        g_ptr_array_add (keys, &((RulesetInfo *) g_ptr_array_index (old, i))->key);
+      for (i = prefix; i < new->len - suffix; i++)
+        g_ptr_array_add (keys, &((RulesetInfo *) g_ptr_array_index (new, i))->key);
+
+      _gtk_style_provider_private_changed_selectors (GTK_STYLE_PROVIDER_PRIVATE (css_provider), keys);
+
+      g_ptr_array_unref (keys);
+    }
+
+out:
+  if (new)
+    g_ptr_array_unref (new);
+  g_free (definitions);
+  g_free (state->definitions);
+  g_ptr_array_unref (state->ruleset_infos);
 }
 
 static void
@@ -1123,6 +1441,17 @@ parse_binding_set (GtkCssScanner *scanner)
       return FALSE;
     }
 
+  if (scanner->provider->priv->sources)
+    {
+      /* binding sets are registered globally, there is nothing to
+       * write into the compiled file */
+      gtk_css_provider_error_literal (scanner->provider,
+                                      scanner,
+                                      GTK_CSS_PROVIDER_ERROR,
+                                      GTK_CSS_PROVIDER_ERROR_FAILED,
+                                      "@binding-set can not be used in compiled style sheets");
+    }
+
   name = _gtk_css_parser_try_ident (scanner->parser, TRUE);
   if (name == NULL)
     {
@@ -1672,9 +2001,14 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
   GtkCssSelectorTreeBuilder *builder;
   guint i;
 
+  for (i = 0; i < priv->rulesets->len; i++)
+    g_array_index (priv->rulesets, GtkCssRuleset, i).position = i;
+
   g_array_sort (priv->rulesets, gtk_css_provider_compare_rule);
 
   builder = _gtk_css_selector_tree_builder_new ();
+  g_clear_pointer (&priv->dependencies, gtk_css_dependencies_free);
+  priv->dependencies = gtk_css_dependencies_new ();
   for (i = 0; i < priv->rulesets->len; i++)
     {
       GtkCssRuleset *ruleset;
@@ -1685,20 +2019,25 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
 					  ruleset->selector,
 					  &ruleset->selector_match,
 					  ruleset);
+      _gtk_css_selector_add_dependencies (ruleset->selector, priv->dependencies);
     }
 
   priv->tree = _gtk_css_selector_tree_builder_build (builder);
   _gtk_css_selector_tree_builder_free (builder);
 
 #ifndef VERIFY_TREE
-  for (i = 0; i < priv->rulesets->len; i++)
+  /* compiling needs the selectors to write them out */
+  if (priv->sources == NULL)
     {
-      GtkCssRuleset *ruleset;
+      for (i = 0; i < priv->rulesets->len; i++)
+        {
+          GtkCssRuleset *ruleset;
 
-      ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+          ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
 
-      _gtk_css_selector_free (ruleset->selector);
-      ruleset->selector = NULL;
+          _gtk_css_selector_free (ruleset->selector);
+          ruleset->selector = NULL;
+        }
     }
 #endif
 }
@@ -1725,12 +2064,23 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
   if (text == NULL)
     {
       GError *load_error = NULL;
+      gsize length;
 
       if (g_file_load_contents (file, NULL,
-                                &free_data, NULL,
+                                &free_data, &length,
                                 NULL, &load_error))
         {
           text = free_data;
+
+          if (css_provider->priv->sources)
+            {
+              CompiledSource *source = g_slice_new (CompiledSource);
+
+              source->file = g_object_ref (file);
+              source->checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                              (const guchar *) text, length);
+              g_ptr_array_add (css_provider->priv->sources, source);
+            }
         }
       else
         {
@@ -1819,6 +2169,7 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
                                  gssize           length,
                                  GError         **error)
 {
+  ReloadState state;
   char *free_data;
   gboolean ret;
 
@@ -1836,13 +2187,14 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
       data = free_data;
     }
 
+  gtk_css_provider_save_state (css_provider, &state);
   gtk_css_provider_reset (css_provider);
 
   ret = gtk_css_provider_load_internal (css_provider, NULL, NULL, data, error);
 
   g_free (free_data);
 
-  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+  gtk_css_provider_emit_changes (css_provider, &state);
 
   return ret;
 }
@@ -1866,16 +2218,18 @@ gtk_css_provider_load_from_file (GtkCssProvider  *css_provider,
                                  GFile           *file,
                                  GError         **error)
 {
+  ReloadState state;
   gboolean success;
 
   g_return_val_if_fail (GTK_IS_CSS_PROVIDER (css_provider), FALSE);
   g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
+  gtk_css_provider_save_state (css_provider, &state);
   gtk_css_provider_reset (css_provider);
 
   success = gtk_css_provider_load_internal (css_provider, NULL, file, NULL, error);
 
-  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+  gtk_css_provider_emit_changes (css_provider, &state);
 
   return success;
 }
@@ -1950,6 +2304,674 @@ gtk_css_provider_load_from_resource (GtkCssProvider *css_provider,
   g_object_unref (file);
 }
 
+/*** Compiled style sheets ***/
+
+/* A compiled style sheet contains the rulesets of a style sheet in the
+ * order they are matched in, with the selectors in binary form and the
+ * values as text that is only parsed when a value is first used. This
+ * way, only the few values that an application actually uses are ever
+ * parsed. Colors and keyframes are stored as CSS.
+ *
+ * All numbers are 32bit in host byte order, offsets are relative to the
+ * start of the data. Strings are referenced by their offset into the
+ * string table.
+ *
+ * A ruleset is:
+ *   guint32 n_selector_elements, n_styles, n_widget_styles;
+ *   guint32 selector[n_selector_elements * GTK_CSS_SELECTOR_SERIALIZED_WORDS];
+ *   guint32 styles[n_styles * 2];                 property name, value
+ *   guint32 widget_styles[n_widget_styles * 2];   name, value
+ *
+ * A source is:
+ *   guint32 is_relative, location, checksum;
+ */
+#define COMPILED_MAGIC "GtkCss\r\n"
+#define COMPILED_VERSION 1
+#define COMPILED_BYTE_ORDER 0x01020304
+#define COMPILED_RULESET_HEADER_WORDS 3
+#define COMPILED_SOURCE_WORDS 3
+
+typedef struct _CompiledHeader CompiledHeader;
+typedef struct _CompiledWriter CompiledWriter;
+typedef struct _CompiledReader CompiledReader;
+
+struct _CompiledHeader {
+  char    magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 gtk_version;          /* string */
+  guint32 definitions;          /* string */
+  guint32 n_sources;
+  guint32 sources;
+  guint32 n_rulesets;
+  guint32 rulesets;
+  guint32 strings;
+  guint32 strings_size;
+};
+
+struct _CompiledWriter {
+  GString *strings;
+  GHashTable *string_refs;
+};
+
+struct _CompiledReader {
+  const guint8 *data;
+  gsize size;
+  const CompiledHeader *header;
+};
+
+static void
+compiled_source_free (gpointer data)
+{
+  CompiledSource *source = data;
+
+  g_object_unref (source->file);
+  g_free (source->checksum);
+
+  g_slice_free (CompiledSource, source);
+}
+
+static guint32
+compiled_writer_add_string (const char *string,
+                            gpointer    data)
+{
+  CompiledWriter *writer = data;
+  gpointer ref;
+
+  if (g_hash_table_lookup_extended (writer->string_refs, string, NULL, &ref))
+    return GPOINTER_TO_UINT (ref);
+
+  ref = GUINT_TO_POINTER (writer->strings->len);
+  /* including the terminating NUL */
+  g_string_append_len (writer->strings, string, strlen (string) + 1);
+  g_hash_table_insert (writer->string_refs, g_strdup (string), ref);
+
+  return GPOINTER_TO_UINT (ref);
+}
+
+static void
+compiled_append (GArray  *words,
+                 guint32  word)
+{
+  g_array_append_val (words, word);
+}
+
+static void
+gtk_css_provider_write_sources (GtkCssProvider *css_provider,
+                                GFile          *file,
+                                CompiledWriter *writer,
+                                GArray         *words)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GFile *dir;
+  guint i;
+
+  /* Files next to the style sheet are stored relative to it, so that
+   * the compiled file stays valid when both are moved. */
+  dir = g_file_get_parent (file);
+
+  for (i = 0; i < priv->sources->len; i++)
+    {
+      CompiledSource *source = g_ptr_array_index (priv->sources, i);
+      char *location;
+
+      location = dir ? g_file_get_relative_path (dir, source->file) : NULL;
+      if (location)
+        {
+          compiled_append (words, TRUE);
+        }
+      else
+        {
+          location = g_file_get_uri (source->file);
+          compiled_append (words, FALSE);
+        }
+
+      compiled_append (words, compiled_writer_add_string (location, writer));
+      compiled_append (words, compiled_writer_add_string (source->checksum, writer));
+
+      g_free (location);
+    }
+
+  if (dir)
+    g_object_unref (dir);
+}
+
+static void
+gtk_css_provider_write_rulesets (GtkCssProvider *css_provider,
+                                 CompiledWriter *writer,
+                                 GArray         *words)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  WidgetPropertyValue *widget_value;
+  GString *str;
+  guint i, j, n_elements, n_widget_styles, start;
+
+  str = g_string_new (NULL);
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+
+      n_elements = _gtk_css_selector_get_n_elements (ruleset->selector);
+      n_widget_styles = 0;
+      for (widget_value = ruleset->widget_style; widget_value; widget_value = widget_value->next)
+        n_widget_styles++;
+
+      compiled_append (words, n_elements);
+      compiled_append (words, ruleset->n_styles);
+      compiled_append (words, n_widget_styles);
+
+      start = words->len;
+      g_array_set_size (words, start + n_elements * GTK_CSS_SELECTOR_SERIALIZED_WORDS);
+      _gtk_css_selector_serialize (ruleset->selector,
+                                   &g_array_index (words, guint32, start),
+                                   compiled_writer_add_string,
+                                   writer);
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          PropertyValue *prop = &ruleset->styles[j];
+
+          g_string_set_size (str, 0);
+          _gtk_css_value_print (prop->value, str);
+
+          compiled_append (words, compiled_writer_add_string (_gtk_style_property_get_name (GTK_STYLE_PROPERTY (prop->property)), writer));
+          compiled_append (words, compiled_writer_add_string (str->str, writer));
+        }
+
+      for (widget_value = ruleset->widget_style; widget_value; widget_value = widget_value->next)
+        {
+          compiled_append (words, compiled_writer_add_string (widget_value->name, writer));
+          compiled_append (words, compiled_writer_add_string (widget_value->value, writer));
+        }
+    }
+
+  g_string_free (str, TRUE);
+}
+
+/**
+ * gtk_css_provider_compile:
+ * @file: the style sheet to compile
+ * @error: (out) (allow-none): return location for a #GError, or %NULL
+ *
+ * Compiles the style sheet in @file into a form that can be loaded
+ * much faster with gtk_css_provider_load_from_compiled(). Files
+ * imported by @file are compiled in, too.
+ *
+ * Images referenced with url() are not compiled in, they are loaded
+ * from their files when they are used.
+ *
+ * Style sheets using @binding-set can not be compiled. Compiled
+ * style sheets can only be loaded by the same version of GTK+ on
+ * the same architecture.
+ *
+ * This is what `gtk-css-tool compile` does.
+ *
+ * Returns: (transfer full): the compiled style sheet, or %NULL if
+ *     @file could not be loaded or contains errors
+ *
+ * Since: 3.20
+ */
+GBytes *
+gtk_css_provider_compile (GFile   *file,
+                          GError **error)
+{
+  GtkCssProvider *css_provider;
+  GtkCssProviderPrivate *priv;
+  CompiledHeader header;
+  CompiledWriter writer;
+  GArray *sources, *rulesets;
+  GByteArray *data;
+  GError *local_error = NULL;
+  char *definitions;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  css_provider = gtk_css_provider_new ();
+  priv = css_provider->priv;
+  priv->sources = g_ptr_array_new_with_free_func (compiled_source_free);
+
+  if (!gtk_css_provider_load_internal (css_provider, NULL, file, NULL, &local_error))
+    {
+      g_propagate_error (error, local_error);
+      g_object_unref (css_provider);
+      return NULL;
+    }
+
+  writer.strings = g_string_new (NULL);
+  writer.string_refs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  sources = g_array_new (FALSE, FALSE, sizeof (guint32));
+  rulesets = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  gtk_css_provider_write_sources (css_provider, file, &writer, sources);
+
+  /* Images are loaded from their files again when loading the compiled
+   * style sheet, so that changed files are picked up */
+  _gtk_css_image_url_set_print_uris (TRUE);
+  gtk_css_provider_write_rulesets (css_provider, &writer, rulesets);
+  definitions = gtk_css_provider_print_definitions (css_provider);
+  _gtk_css_image_url_set_print_uris (FALSE);
+
+  memset (&header, 0, sizeof (CompiledHeader));
+  memcpy (header.magic, COMPILED_MAGIC, sizeof (header.magic));
+  header.version = COMPILED_VERSION;
+  header.byte_order = COMPILED_BYTE_ORDER;
+  header.gtk_version = compiled_writer_add_string (PACKAGE_VERSION, &writer);
+  header.definitions = compiled_writer_add_string (definitions, &writer);
+  header.n_sources = priv->sources->len;
+  header.sources = sizeof (CompiledHeader);
+  header.n_rulesets = priv->rulesets->len;
+  header.rulesets = header.sources + sources->len * sizeof (guint32);
+  header.strings = header.rulesets + rulesets->len * sizeof (guint32);
+  header.strings_size = writer.strings->len;
+
+  data = g_byte_array_sized_new (header.strings + header.strings_size);
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (CompiledHeader));
+  g_byte_array_append (data, (const guint8 *) sources->data, sources->len * sizeof (guint32));
+  g_byte_array_append (data, (const guint8 *) rulesets->data, rulesets->len * sizeof (guint32));
+  g_byte_array_append (data, (const guint8 *) writer.strings->str, writer.strings->len);
+
+  g_free (definitions);
+  g_array_free (sources, TRUE);
+  g_array_free (rulesets, TRUE);
+  g_string_free (writer.strings, TRUE);
+  g_hash_table_destroy (writer.string_refs);
+  g_object_unref (css_provider);
+
+  return g_byte_array_free_to_bytes (data);
+}
+
+static const char *
+compiled_reader_get_string (guint32  ref,
+                            gpointer data)
+{
+  const CompiledReader *reader = data;
+
+  if (ref >= reader->header->strings_size)
+    return NULL;
+
+  /* the string table is NUL-terminated, see gtk_css_provider_load_compiled_internal() */
+  return (const char *) reader->data + reader->header->strings + ref;
+}
+
+static const guint32 *
+compiled_reader_get_words (const CompiledReader *reader,
+                           guint64               offset,
+                           guint64               n_words)
+{
+  if (offset + n_words * sizeof (guint32) > reader->size)
+    return NULL;
+
+  return (const guint32 *) (reader->data + offset);
+}
+
+static void
+gtk_css_provider_compiled_error (GError     **error,
+                                 const char  *message)
+{
+  g_set_error_literal (error,
+                       GTK_CSS_PROVIDER_ERROR,
+                       GTK_CSS_PROVIDER_ERROR_FAILED,
+                       message);
+}
+
+static gboolean
+gtk_css_provider_check_sources (const CompiledReader  *reader,
+                                GFile                 *file,
+                                GError               **error)
+{
+  const guint32 *words;
+  GFile *dir;
+  gboolean result = TRUE;
+  guint i;
+
+  words = compiled_reader_get_words (reader,
+                                     reader->header->sources,
+                                     (guint64) reader->header->n_sources * COMPILED_SOURCE_WORDS);
+  if (words == NULL)
+    {
+      gtk_css_provider_compiled_error (error, "Compiled style sheet is corrupt");
+      return FALSE;
+    }
+
+  dir = g_file_get_parent (file);
+
+  for (i = 0; i < reader->header->n_sources && result; i++, words += COMPILED_SOURCE_WORDS)
+    {
+      const char *location, *checksum;
+      char *contents, *new_checksum;
+      GFile *source;
+      gsize length;
+
+      location = compiled_reader_get_string (words[1], (gpointer) reader);
+      checksum = compiled_reader_get_string (words[2], (gpointer) reader);
+      if (location == NULL || checksum == NULL || (words[0] && dir == NULL))
+        {
+          gtk_css_provider_compiled_error (error, "Compiled style sheet is corrupt");
+          result = FALSE;
+          break;
+        }
+
+      if (words[0])
+        source = g_file_resolve_relative_path (dir, location);
+      else
+        source = g_file_new_for_uri (location);
+
+      if (g_file_load_contents (source, NULL, &contents, &length, NULL, NULL))
+        {
+          new_checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                      (const guchar *) contents, length);
+          result = g_str_equal (checksum, new_checksum);
+          g_free (new_checksum);
+          g_free (contents);
+        }
+      else
+        result = FALSE;
+
+      if (!result)
+        gtk_css_provider_compiled_error (error, "Compiled style sheet is out of date");
+
+      g_object_unref (source);
+    }
+
+  if (dir)
+    g_object_unref (dir);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_read_ruleset (GtkCssProvider  *css_provider,
+                               CompiledReader  *reader,
+                               guint64         *offset,
+                               GtkCssRuleset   *ruleset)
+{
+  const guint32 *words;
+  guint n_elements, n_styles, n_widget_styles, i;
+
+  memset (ruleset, 0, sizeof (GtkCssRuleset));
+
+  words = compiled_reader_get_words (reader, *offset, COMPILED_RULESET_HEADER_WORDS);
+  if (words == NULL)
+    return FALSE;
+
+  n_elements = words[0];
+  n_styles = words[1];
+  n_widget_styles = words[2];
+
+  words = compiled_reader_get_words (reader,
+                                     *offset,
+                                     COMPILED_RULESET_HEADER_WORDS
+                                     + (guint64) n_elements * GTK_CSS_SELECTOR_SERIALIZED_WORDS
+                                     + (guint64) n_styles * 2
+                                     + (guint64) n_widget_styles * 2);
+  if (words == NULL)
+    return FALSE;
+  words += COMPILED_RULESET_HEADER_WORDS;
+
+  ruleset->selector = _gtk_css_selector_deserialize (words, n_elements,
+                                                     compiled_reader_get_string,
+                                                     reader);
+  if (ruleset->selector == NULL)
+    return FALSE;
+  words += n_elements * GTK_CSS_SELECTOR_SERIALIZED_WORDS;
+
+  for (i = 0; i < n_styles; i++, words += 2)
+    {
+      GtkStyleProperty *property;
+      const char *name, *text;
+
+      name = compiled_reader_get_string (words[0], reader);
+      text = compiled_reader_get_string (words[1], reader);
+      if (name == NULL || text == NULL)
+        return FALSE;
+
+      property = _gtk_style_property_lookup (name);
+      if (!GTK_IS_CSS_STYLE_PROPERTY (property))
+        return FALSE;
+
+      gtk_css_ruleset_add_compiled (ruleset, GTK_CSS_STYLE_PROPERTY (property), text);
+    }
+
+  for (i = 0; i < n_widget_styles; i++, words += 2)
+    {
+      WidgetPropertyValue *value;
+      const char *name, *text;
+
+      name = compiled_reader_get_string (words[0], reader);
+      text = compiled_reader_get_string (words[1], reader);
+      if (name == NULL || text == NULL)
+        return FALSE;
+
+      value = g_slice_new0 (WidgetPropertyValue);
+      value->name = g_strdup (name);
+      value->value = g_strdup (text);
+
+      gtk_css_ruleset_add_style (ruleset, value->name, value);
+    }
+
+  *offset = (const guint8 *) words - reader->data;
+
+  return TRUE;
+}
+
+/* Loads @bytes into the freshly reset @css_provider. On failure, the
+ * provider needs to be reset again. */
+static gboolean
+gtk_css_provider_load_compiled_internal (GtkCssProvider  *css_provider,
+                                         GBytes          *bytes,
+                                         GFile           *source,
+                                         GError         **error)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  CompiledReader reader;
+  GtkCssScanner *scanner;
+  const char *gtk_version, *definitions;
+  guint64 offset;
+  guint i;
+
+  reader.data = g_bytes_get_data (bytes, &reader.size);
+  reader.header = (const CompiledHeader *) reader.data;
+
+  if (reader.size < sizeof (CompiledHeader) ||
+      memcmp (reader.header->magic, COMPILED_MAGIC, sizeof (reader.header->magic)) != 0)
+    {
+      gtk_css_provider_compiled_error (error, "Not a compiled style sheet");
+      return FALSE;
+    }
+
+  if (reader.header->version != COMPILED_VERSION ||
+      reader.header->byte_order != COMPILED_BYTE_ORDER)
+    {
+      gtk_css_provider_compiled_error (error, "Unsupported compiled style sheet format");
+      return FALSE;
+    }
+
+  if (reader.header->strings_size == 0 ||
+      (guint64) reader.header->strings + reader.header->strings_size > reader.size ||
+      reader.data[reader.header->strings + reader.header->strings_size - 1] != '\0')
+    {
+      gtk_css_provider_compiled_error (error, "Compiled style sheet is corrupt");
+      return FALSE;
+    }
+
+  gtk_version = compiled_reader_get_string (reader.header->gtk_version, &reader);
+  definitions = compiled_reader_get_string (reader.header->definitions, &reader);
+  if (gtk_version == NULL || definitions == NULL)
+    {
+      gtk_css_provider_compiled_error (error, "Compiled style sheet is corrupt");
+      return FALSE;
+    }
+
+  /* values are stored as text, which may only be understood by this version */
+  if (!g_str_equal (gtk_version, PACKAGE_VERSION))
+    {
+      gtk_css_provider_compiled_error (error, "Compiled style sheet is for a different version of GTK+");
+      return FALSE;
+    }
+
+  if (source && !gtk_css_provider_check_sources (&reader, source, error))
+    return FALSE;
+
+  scanner = gtk_css_scanner_new (css_provider, NULL, NULL, NULL, definitions);
+  parse_stylesheet (scanner);
+  gtk_css_scanner_destroy (scanner);
+
+  offset = reader.header->rulesets;
+  for (i = 0; i < reader.header->n_rulesets; i++)
+    {
+      GtkCssRuleset ruleset;
+
+      if (!gtk_css_provider_read_ruleset (css_provider, &reader, &offset, &ruleset))
+        {
+          gtk_css_ruleset_clear (&ruleset);
+          gtk_css_provider_compiled_error (error, "Compiled style sheet is corrupt");
+          return FALSE;
+        }
+
+      g_array_append_val (priv->rulesets, ruleset);
+    }
+
+  priv->compiled = g_bytes_ref (bytes);
+
+  gtk_css_provider_postprocess (css_provider);
+
+  return TRUE;
+}
+
+static GBytes *
+gtk_css_provider_load_compiled_bytes (GFile   *file,
+                                      GError **error)
+{
+  GBytes *bytes;
+
+  if (g_file_has_uri_scheme (file, "resource"))
+    {
+      char *uri, *path;
+
+      uri = g_file_get_uri (file);
+      path = g_uri_unescape_string (uri + strlen ("resource://"), NULL);
+      bytes = g_resources_lookup_data (path, 0, error);
+      g_free (path);
+      g_free (uri);
+    }
+  else if (g_file_is_native (file))
+    {
+      GMappedFile *mapped;
+      char *path;
+
+      path = g_file_get_path (file);
+      mapped = g_mapped_file_new (path, FALSE, error);
+      g_free (path);
+      if (mapped == NULL)
+        return NULL;
+
+      bytes = g_mapped_file_get_bytes (mapped);
+      g_mapped_file_unref (mapped);
+    }
+  else
+    {
+      char *contents;
+      gsize length;
+
+      if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+        return NULL;
+
+      bytes = g_bytes_new_take (contents, length);
+    }
+
+  if (bytes == NULL)
+    return NULL;
+
+  /* numbers are read in place */
+  if (GPOINTER_TO_SIZE (g_bytes_get_data (bytes, NULL)) % sizeof (guint32) != 0)
+    {
+      GBytes *copy;
+      gconstpointer data;
+      gsize size;
+
+      data = g_bytes_get_data (bytes, &size);
+      copy = g_bytes_new (data, size);
+      g_bytes_unref (bytes);
+      bytes = copy;
+    }
+
+  return bytes;
+}
+
+/**
+ * gtk_css_provider_load_from_compiled:
+ * @css_provider: a #GtkCssProvider
+ * @compiled: a file containing a style sheet compiled with
+ *     gtk_css_provider_compile()
+ * @source: (allow-none): the style sheet @compiled was compiled from
+ * @error: (out) (allow-none): return location for a #GError, or %NULL
+ *
+ * Loads the compiled style sheet in @compiled into @css_provider,
+ * clearing any previously loaded information. This is much faster
+ * than parsing the style sheet. Local files are mapped into memory
+ * instead of being read.
+ *
+ * If @source is given, @compiled is only used when @source and the
+ * files it imports have not changed since compiling. Otherwise @source
+ * is loaded as with gtk_css_provider_load_from_file().
+ *
+ * Returns: %TRUE. %FALSE will only be returned if @compiled could not be
+ *     used and no @source was given, or if an @error is not %NULL and a
+ *     loading error occured in @source.
+ *
+ * Since: 3.20
+ **/
+gboolean
+gtk_css_provider_load_from_compiled (GtkCssProvider  *css_provider,
+                                     GFile           *compiled,
+                                     GFile           *source,
+                                     GError         **error)
+{
+  ReloadState state;
+  GError *local_error = NULL;
+  GBytes *bytes;
+  gboolean success;
+
+  g_return_val_if_fail (GTK_IS_CSS_PROVIDER (css_provider), FALSE);
+  g_return_val_if_fail (G_IS_FILE (compiled), FALSE);
+  g_return_val_if_fail (source == NULL || G_IS_FILE (source), FALSE);
+
+  /* compiled style sheets have no sections to show in the inspector */
+  if (source && gtk_keep_css_sections)
+    return gtk_css_provider_load_from_file (css_provider, source, error);
+
+  gtk_css_provider_save_state (css_provider, &state);
+  gtk_css_provider_reset (css_provider);
+
+  bytes = gtk_css_provider_load_compiled_bytes (compiled, &local_error);
+  if (bytes)
+    {
+      success = gtk_css_provider_load_compiled_internal (css_provider, bytes, source, &local_error);
+      g_bytes_unref (bytes);
+    }
+  else
+    success = FALSE;
+
+  if (!success)
+    {
+      gtk_css_provider_reset (css_provider);
+
+      if (source)
+        {
+          g_clear_error (&local_error);
+          success = gtk_css_provider_load_internal (css_provider, NULL, source, NULL, error);
+        }
+      else
+        g_propagate_error (error, local_error);
+    }
+
+  gtk_css_provider_emit_changes (css_provider, &state);
+
+  return success;
+}
+
 /**
  * gtk_css_provider_get_default:
  *
@@ -2077,6 +3099,43 @@ _gtk_css_find_theme (const gchar *name,
   return path;
 }
 
+/* Built-in themes are compiled when installing GTK+, as they can't
+ * be compiled before being included in the library. */
+static void
+gtk_css_provider_load_builtin (GtkCssProvider *provider,
+                               const char     *resource_path)
+{
+  char *compiled_path, *escaped, *uri;
+  GFile *compiled, *source;
+
+  compiled_path = g_strconcat (_gtk_get_libdir (),
+                               G_DIR_SEPARATOR_S "gtk-3.0" G_DIR_SEPARATOR_S GTK_BINARY_VERSION,
+                               resource_path + strlen ("/org/gtk/libgtk"),
+                               ".compiled",
+                               NULL);
+
+  if (!g_file_test (compiled_path, G_FILE_TEST_IS_REGULAR))
+    {
+      gtk_css_provider_load_from_resource (provider, resource_path);
+      g_free (compiled_path);
+      return;
+    }
+
+  escaped = g_uri_escape_string (resource_path,
+                                 G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+  uri = g_strconcat ("resource://", escaped, NULL);
+  source = g_file_new_for_uri (uri);
+  compiled = g_file_new_for_path (compiled_path);
+
+  gtk_css_provider_load_from_compiled (provider, compiled, source, NULL);
+
+  g_object_unref (compiled);
+  g_object_unref (source);
+  g_free (uri);
+  g_free (escaped);
+  g_free (compiled_path);
+}
+
 /**
  * _gtk_css_provider_load_named:
  * @provider: a #GtkCssProvider
@@ -2112,7 +3171,7 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
 
   if (g_resources_get_info (resource_path, 0, NULL, NULL, NULL))
     {
-      gtk_css_provider_load_from_resource (provider, resource_path);
+      gtk_css_provider_load_builtin (provider, resource_path);
       g_free (resource_path);
       return;
     }
@@ -2221,13 +3280,20 @@ compare_names (gconstpointer a, gconstpointer b)
 static void
 gtk_css_ruleset_print (const GtkCssRuleset *ruleset,
                        GString             *str)
+{
+  _gtk_css_selector_tree_match_print (ruleset->selector_match, str);
+
+  gtk_css_ruleset_print_declarations (ruleset, str);
+}
+
+static void
+gtk_css_ruleset_print_declarations (const GtkCssRuleset *ruleset,
+                                    GString             *str)
 {
   GList *values, *walk;
   WidgetPropertyValue *widget_value;
   guint i;
 
-  _gtk_css_selector_tree_match_print (ruleset->selector_match, str);
-
   g_string_append (str, " {\n");
 
   if (ruleset->styles)
@@ -2246,7 +3312,10 @@ gtk_css_ruleset_print (const GtkCssRuleset *ruleset,
           g_string_append (str, "  ");
           g_string_append (str, _gtk_style_property_get_name (GTK_STYLE_PROPERTY (prop->property)));
           g_string_append (str, ": ");
-          _gtk_css_value_print (prop->value, str);
+          if (prop->value)
+            _gtk_css_value_print (prop->value, str);
+          else
+            g_string_append (str, prop->text);
           g_string_append (str, ";\n");
         }
 
@@ -2331,6 +3400,19 @@ gtk_css_provider_print_keyframes (GHashTable *keyframes,
   g_list_free (keys);
 }
 
+static char *
+gtk_css_provider_print_definitions (GtkCssProvider *css_provider)
+{
+  GString *str;
+
+  str = g_string_new (NULL);
+
+  gtk_css_provider_print_colors (css_provider->priv->symbolic_colors, str);
+  gtk_css_provider_print_keyframes (css_provider->priv->keyframes, str);
+
+  return g_string_free (str, FALSE);
+}
+
 /**
  * gtk_css_provider_to_string:
  * @provider: the provider to write to a string
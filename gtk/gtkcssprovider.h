@@ -112,6 +112,15 @@ GDK_AVAILABLE_IN_3_16
 void             gtk_css_provider_load_from_resource (GtkCssProvider *css_provider,
                                                       const gchar    *resource_path);
 
+GDK_AVAILABLE_IN_3_20
+GBytes *         gtk_css_provider_compile            (GFile          *file,
+                                                      GError        **error);
+GDK_AVAILABLE_IN_3_20
+gboolean         gtk_css_provider_load_from_compiled (GtkCssProvider *css_provider,
+                                                      GFile          *compiled,
+                                                      GFile          *source,
+                                                      GError        **error);
+
 GDK_AVAILABLE_IN_ALL
 GtkCssProvider * gtk_css_provider_get_default (void);
 
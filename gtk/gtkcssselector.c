@@ -113,6 +113,7 @@ struct _GtkCssSelectorTree
   gint32 previous_offset;
   gint32 sibling_offset;
   gint32 matches_offset; /* pointers that we return as matches if selector matches */
+  guint32 filter_hash; /* ancestor filter hash of selector or 0 if it can't be filtered */
 };
 
 static gboolean
@@ -1431,6 +1432,238 @@ _gtk_css_selector_get_change (const GtkCssSelector *selector)
   return selector->class->get_change (selector, _gtk_css_selector_get_change (gtk_css_selector_previous (selector)));
 }
 
+/**
+ * _gtk_css_selector_add_dependencies:
+ * @selector: the selector
+ * @deps: the index to add to
+ *
+ * Adds the names, ids, classes and states mentioned by @selector to
+ * @deps, together with the relatives of the node that has them whose
+ * style they can change.
+ **/
+void
+_gtk_css_selector_add_dependencies (const GtkCssSelector *selector,
+                                    GtkCssDependencies   *deps)
+{
+  const GtkCssSelector *iter, *combinator;
+  GtkCssChange change;
+
+  for (iter = selector; iter; iter = gtk_css_selector_previous (iter))
+    {
+      if (!iter->class->is_simple)
+        continue;
+
+      change = iter->class->get_change (iter, 0);
+
+      /* the combinators between here and the last element
+       * decide which relatives depend on this element */
+      for (combinator = iter; combinator != selector; )
+        {
+          combinator--;
+          if (!combinator->class->is_simple)
+            change = combinator->class->get_change (combinator, change);
+        }
+
+      if (iter->class == &GTK_CSS_SELECTOR_NAME ||
+          iter->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        gtk_css_dependencies_add (deps, GTK_CSS_CHANGE_NAME, iter->name.name, change);
+      else if (iter->class == &GTK_CSS_SELECTOR_ID ||
+               iter->class == &GTK_CSS_SELECTOR_NOT_ID)
+        gtk_css_dependencies_add (deps, GTK_CSS_CHANGE_ID, iter->id.name, change);
+      else if (iter->class == &GTK_CSS_SELECTOR_CLASS ||
+               iter->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        gtk_css_dependencies_add (deps, GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (iter->style_class.style_class), change);
+      else if (iter->class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               iter->class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        gtk_css_dependencies_add (deps, GTK_CSS_CHANGE_STATE, GUINT_TO_POINTER (iter->state.state), change);
+      /* positions change with the tree and are handled there */
+    }
+}
+
+/******************** Compiled selectors *****************/
+
+/* The index into this array is what gets stored in compiled style
+ * sheets, so only ever append to it and bump the compiled format
+ * version in gtkcssprovider.c when changing it. */
+static const GtkCssSelectorClass *compiled_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION
+};
+
+static guint
+compiled_class_index (const GtkCssSelectorClass *class)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (compiled_classes); i++)
+    {
+      if (compiled_classes[i] == class)
+        return i;
+    }
+
+  g_assert_not_reached ();
+  return 0;
+}
+
+/**
+ * _gtk_css_selector_get_n_elements:
+ * @selector: a selector
+ *
+ * Returns: the number of simple selectors and combinators in
+ *     @selector, each of which is serialized into
+ *     %GTK_CSS_SELECTOR_SERIALIZED_WORDS words.
+ **/
+guint
+_gtk_css_selector_get_n_elements (const GtkCssSelector *selector)
+{
+  return gtk_css_selector_size (selector);
+}
+
+/**
+ * _gtk_css_selector_serialize:
+ * @selector: the selector to serialize
+ * @words: location to store _gtk_css_selector_get_n_elements() *
+ *     %GTK_CSS_SELECTOR_SERIALIZED_WORDS words
+ * @add_string: function that stores a string and returns a reference
+ *     to it
+ * @data: data to pass to @add_string
+ *
+ * Serializes @selector in a pointer-free form, for use in compiled
+ * style sheets.
+ **/
+void
+_gtk_css_selector_serialize (const GtkCssSelector         *selector,
+                             guint32                      *words,
+                             GtkCssSelectorAddStringFunc   add_string,
+                             gpointer                      data)
+{
+  const GtkCssSelectorClass *class;
+
+  for (; selector; selector = gtk_css_selector_previous (selector))
+    {
+      class = selector->class;
+
+      memset (words, 0, sizeof (guint32) * GTK_CSS_SELECTOR_SERIALIZED_WORDS);
+      words[0] = compiled_class_index (class);
+
+      if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+        words[1] = add_string (selector->name.name, data);
+      else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+        words[1] = add_string (selector->id.name, data);
+      else if (class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        words[1] = add_string (g_quark_to_string (selector->style_class.style_class), data);
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE || class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        words[1] = selector->state.state;
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION || class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          words[1] = selector->position.type;
+          words[2] = (guint32) (gint32) selector->position.a;
+          words[3] = (guint32) (gint32) selector->position.b;
+        }
+
+      words += GTK_CSS_SELECTOR_SERIALIZED_WORDS;
+    }
+}
+
+/**
+ * _gtk_css_selector_deserialize:
+ * @words: the data written by _gtk_css_selector_serialize()
+ * @n_elements: the number of elements in @words
+ * @get_string: function that returns the string for a reference
+ *     returned by the add_string function, or %NULL if the reference
+ *     is invalid
+ * @data: data to pass to @get_string
+ *
+ * Recreates a selector serialized with _gtk_css_selector_serialize().
+ * As @words may come from a corrupted file, it is validated.
+ *
+ * Returns: the new selector or %NULL if @words is invalid
+ **/
+GtkCssSelector *
+_gtk_css_selector_deserialize (const guint32                *words,
+                               guint                         n_elements,
+                               GtkCssSelectorGetStringFunc   get_string,
+                               gpointer                      data)
+{
+  const GtkCssSelectorClass *class;
+  GtkCssSelector *selector;
+  const char *string;
+  guint i;
+
+  if (n_elements == 0)
+    return NULL;
+
+  selector = g_malloc0 (sizeof (GtkCssSelector) * n_elements + sizeof (gpointer));
+
+  for (i = 0; i < n_elements; i++, words += GTK_CSS_SELECTOR_SERIALIZED_WORDS)
+    {
+      if (words[0] >= G_N_ELEMENTS (compiled_classes))
+        goto fail;
+
+      class = compiled_classes[words[0]];
+
+      /* combinators need a simple selector on both sides */
+      if (!class->is_simple &&
+          (i == 0 || i == n_elements - 1 || !selector[i - 1].class->is_simple))
+        goto fail;
+
+      selector[i].class = class;
+
+      if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME ||
+          class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID ||
+          class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        {
+          string = get_string (words[1], data);
+          if (string == NULL)
+            goto fail;
+
+          if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+            selector[i].name.name = g_intern_string (string);
+          else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+            selector[i].id.name = g_intern_string (string);
+          else
+            selector[i].style_class.style_class = g_quark_from_string (string);
+        }
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE || class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        {
+          selector[i].state.state = words[1];
+        }
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION || class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          if (words[1] > POSITION_SORTED)
+            goto fail;
+
+          selector[i].position.type = words[1];
+          selector[i].position.a = (gint32) words[2];
+          selector[i].position.b = (gint32) words[3];
+
+          if (selector[i].position.a != (gint32) words[2] ||
+              selector[i].position.b != (gint32) words[3])
+            goto fail;
+        }
+    }
+
+  return selector;
+
+fail:
+  g_free (selector);
+  return NULL;
+}
+
 /******************** SelectorTree handling *****************/
 
 static GHashTable *
@@ -1501,38 +1734,182 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
   return (GtkCssSelector *)gtk_css_selector_previous (selector);
 }
 
+static guint32
+gtk_css_selector_get_filter_hash (const GtkCssSelector *selector)
+{
+  if (selector->class == &GTK_CSS_SELECTOR_NAME)
+    return gtk_css_ancestor_filter_hash_name (selector->name.name);
+  else if (selector->class == &GTK_CSS_SELECTOR_ID)
+    return gtk_css_ancestor_filter_hash_id (selector->id.name);
+  else if (selector->class == &GTK_CSS_SELECTOR_CLASS)
+    return gtk_css_ancestor_filter_hash_class (selector->style_class.style_class);
+  else
+    return 0;
+}
+
+/**
+ * _gtk_css_selector_key_init:
+ * @key: the key to initialize
+ * @selector: the selector
+ *
+ * Initializes @key with the name, id and classes required by the
+ * last compound selector of @selector. An element without all of
+ * them can never be matched by @selector, no matter its state,
+ * position or ancestors.
+ **/
+static void
+gtk_css_selector_key_add (GtkCssSelectorKey     *key,
+                          GArray               **classes,
+                          const GtkCssSelector  *selector)
+{
+  if (selector->class == &GTK_CSS_SELECTOR_NAME)
+    key->name = selector->name.name;
+  else if (selector->class == &GTK_CSS_SELECTOR_ID)
+    key->id = selector->id.name;
+  else if (selector->class == &GTK_CSS_SELECTOR_CLASS)
+    {
+      if (*classes == NULL)
+        *classes = g_array_new (TRUE, FALSE, sizeof (GQuark));
+      g_array_append_val (*classes, selector->style_class.style_class);
+    }
+}
+
+void
+_gtk_css_selector_key_init (GtkCssSelectorKey    *key,
+                            const GtkCssSelector *selector)
+{
+  GArray *classes = NULL;
+
+  memset (key, 0, sizeof (GtkCssSelectorKey));
+
+  for (;
+       selector && selector->class->is_simple;
+       selector = gtk_css_selector_previous (selector))
+    gtk_css_selector_key_add (key, &classes, selector);
+
+  if (classes)
+    key->classes = (GQuark *) g_array_free (classes, FALSE);
+}
+
+void
+_gtk_css_selector_key_clear (GtkCssSelectorKey *key)
+{
+  g_free (key->classes);
+  key->classes = NULL;
+}
+
+gboolean
+_gtk_css_selector_key_matches (const GtkCssSelectorKey *key,
+                               const GtkCssMatcher     *matcher)
+{
+  const GQuark *c;
+
+  if (key->name && !_gtk_css_matcher_has_name (matcher, key->name))
+    return FALSE;
+
+  if (key->id && !_gtk_css_matcher_has_id (matcher, key->id))
+    return FALSE;
+
+  if (key->classes)
+    {
+      for (c = key->classes; *c; c++)
+        {
+          if (!_gtk_css_matcher_has_class (matcher, *c))
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+typedef struct {
+  GPtrArray *array;
+  gboolean   use_filter;
+} GtkCssSelectorTreeMatch;
+
+/* Checks if walking the parents for the combinator @tree can possibly
+ * find a match. Every alternative that follows the combinator needs to
+ * have its first selector's hash in the ancestor filter, otherwise no
+ * ancestor can match it. */
+static gboolean
+gtk_css_selector_tree_ancestors_may_match (const GtkCssSelectorTree   *tree,
+                                           const GtkCssAncestorFilter *filter)
+{
+  const GtkCssSelectorTree *prev;
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    {
+      if (prev->filter_hash == 0 ||
+          gtk_css_ancestor_filter_may_contain (filter, prev->filter_hash))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static gboolean
 gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
                                      const GtkCssMatcher  *matcher,
                                      gpointer              res)
 {
   const GtkCssSelectorTree *tree = (const GtkCssSelectorTree *) selector;
+  GtkCssSelectorTreeMatch *match = res;
+  const GtkCssAncestorFilter *filter;
   const GtkCssSelectorTree *prev;
 
   if (!gtk_css_selector_match (selector, matcher))
     return FALSE;
 
-  gtk_css_selector_tree_found_match (tree, res);
+  gtk_css_selector_tree_found_match (tree, &match->array);
+
+  filter = match->use_filter ? _gtk_css_matcher_get_ancestor_filter (matcher) : NULL;
 
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    {
+      if (filter &&
+          (prev->selector.class == &GTK_CSS_SELECTOR_DESCENDANT ||
+           prev->selector.class == &GTK_CSS_SELECTOR_CHILD) &&
+          !gtk_css_selector_tree_ancestors_may_match (prev, filter))
+        continue;
+
+      gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    }
 
   return FALSE;
 }
 
-GPtrArray *
-_gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
-				  const GtkCssMatcher *matcher)
+static GPtrArray *
+gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
+                                 const GtkCssMatcher      *matcher,
+                                 gboolean                  use_filter)
 {
-  GPtrArray *array = NULL;
+  GtkCssSelectorTreeMatch match = { NULL, use_filter };
 
   for (; tree != NULL;
        tree = gtk_css_selector_tree_get_sibling (tree))
-    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &match);
 
-  return array;
+  return match.array;
+}
+
+GPtrArray *
+_gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
+				  const GtkCssMatcher *matcher)
+{
+  return gtk_css_selector_tree_match_all (tree, matcher, TRUE);
+}
+
+/* Same as _gtk_css_selector_tree_match_all(), but without using the
+ * ancestor filter of @matcher. Used to verify the filtered results. */
+GPtrArray *
+_gtk_css_selector_tree_match_all_unfiltered (const GtkCssSelectorTree *tree,
+                                             const GtkCssMatcher      *matcher)
+{
+  return gtk_css_selector_tree_match_all (tree, matcher, FALSE);
 }
 
 /* When checking for changes via the tree we need to know if a rule further
@@ -1695,6 +2072,45 @@ _gtk_css_selector_tree_match_print (const GtkCssSelectorTree *tree,
     }
 }
 
+/**
+ * _gtk_css_selector_tree_match_key_init:
+ * @key: the key to initialize
+ * @tree: the tree node a ruleset's selector_match points to
+ *
+ * Like _gtk_css_selector_key_init(), for rulesets whose selector has
+ * been freed after building the tree.
+ **/
+void
+_gtk_css_selector_tree_match_key_init (GtkCssSelectorKey        *key,
+                                       const GtkCssSelectorTree *tree)
+{
+  GArray *classes = NULL;
+
+  memset (key, 0, sizeof (GtkCssSelectorKey));
+
+  /* The tree is walked from the first compound selector to the last
+   * one, and only the last one goes into the key */
+  for (; tree; tree = gtk_css_selector_tree_get_parent (tree))
+    {
+      if (tree->selector.class->is_simple)
+        {
+          gtk_css_selector_key_add (key, &classes, &tree->selector);
+        }
+      else
+        {
+          key->name = NULL;
+          key->id = NULL;
+          if (classes)
+            g_array_set_size (classes, 0);
+        }
+    }
+
+  if (classes && classes->len > 0)
+    key->classes = (GQuark *) g_array_free (classes, FALSE);
+  else if (classes)
+    g_array_free (classes, TRUE);
+}
+
 void
 _gtk_css_selector_tree_free (GtkCssSelectorTree *tree)
 {
@@ -1779,6 +2195,7 @@ subdivide_infos (GByteArray *array, GList *infos, gint32 parent_offset)
   tree = alloc_tree (array, &tree_offset);
   tree->parent_offset = parent_offset;
   tree->selector = max_selector;
+  tree->filter_hash = gtk_css_selector_get_filter_hash (&max_selector);
 
   exact_matches = NULL;
   for (l = infos; l != NULL; l = l->next)
@@ -18,6 +18,7 @@
 #ifndef __GTK_CSS_SELECTOR_PRIVATE_H__
 #define __GTK_CSS_SELECTOR_PRIVATE_H__
 
+#include "gtk/gtkcssdependenciesprivate.h"
 #include "gtk/gtkcssmatcherprivate.h"
 #include "gtk/gtkcssparserprivate.h"
 
@@ -26,6 +27,23 @@ G_BEGIN_DECLS
 typedef union _GtkCssSelector GtkCssSelector;
 typedef struct _GtkCssSelectorTree GtkCssSelectorTree;
 typedef struct _GtkCssSelectorTreeBuilder GtkCssSelectorTreeBuilder;
+typedef struct _GtkCssSelectorKey GtkCssSelectorKey;
+
+/* The name, id and classes that an element must have to be matched
+ * by a selector. Everything else in the selector is ignored. */
+struct _GtkCssSelectorKey {
+  /*interned*/ const char *name;       /* or NULL */
+  /*interned*/ const char *id;         /* or NULL */
+  GQuark                  *classes;    /* 0-terminated or NULL */
+};
+
+/* Number of guint32 each element of a serialized selector takes */
+#define GTK_CSS_SELECTOR_SERIALIZED_WORDS 4
+
+typedef guint32      (* GtkCssSelectorAddStringFunc) (const char *string,
+                                                      gpointer    data);
+typedef const char * (* GtkCssSelectorGetStringFunc) (guint32     ref,
+                                                      gpointer    data);
 
 GtkCssSelector *  _gtk_css_selector_parse           (GtkCssParser           *parser);
 void              _gtk_css_selector_free            (GtkCssSelector         *selector);
@@ -37,16 +55,39 @@ void              _gtk_css_selector_print           (const GtkCssSelector   *sel
 gboolean          _gtk_css_selector_matches         (const GtkCssSelector   *selector,
                                                      const GtkCssMatcher    *matcher);
 GtkCssChange      _gtk_css_selector_get_change      (const GtkCssSelector   *selector);
+void              _gtk_css_selector_add_dependencies (const GtkCssSelector  *selector,
+                                                     GtkCssDependencies     *deps);
 int               _gtk_css_selector_compare         (const GtkCssSelector   *a,
                                                      const GtkCssSelector   *b);
 
+guint             _gtk_css_selector_get_n_elements  (const GtkCssSelector   *selector);
+void              _gtk_css_selector_serialize       (const GtkCssSelector   *selector,
+                                                     guint32                *words,
+                                                     GtkCssSelectorAddStringFunc add_string,
+                                                     gpointer                data);
+GtkCssSelector *  _gtk_css_selector_deserialize     (const guint32          *words,
+                                                     guint                   n_elements,
+                                                     GtkCssSelectorGetStringFunc get_string,
+                                                     gpointer                data);
+
+void              _gtk_css_selector_key_init        (GtkCssSelectorKey      *key,
+                                                     const GtkCssSelector   *selector);
+void              _gtk_css_selector_key_clear       (GtkCssSelectorKey      *key);
+gboolean          _gtk_css_selector_key_matches     (const GtkCssSelectorKey *key,
+                                                     const GtkCssMatcher    *matcher);
+
 void         _gtk_css_selector_tree_free             (GtkCssSelectorTree       *tree);
 GPtrArray *  _gtk_css_selector_tree_match_all        (const GtkCssSelectorTree *tree,
 						      const GtkCssMatcher      *matcher);
+GPtrArray *  _gtk_css_selector_tree_match_all_unfiltered
+                                                     (const GtkCssSelectorTree *tree,
+						      const GtkCssMatcher      *matcher);
 GtkCssChange _gtk_css_selector_tree_get_change_all   (const GtkCssSelectorTree *tree,
 						      const GtkCssMatcher *matcher);
 void         _gtk_css_selector_tree_match_print      (const GtkCssSelectorTree *tree,
 						      GString                  *str);
+void         _gtk_css_selector_tree_match_key_init   (GtkCssSelectorKey        *key,
+						      const GtkCssSelectorTree *tree);
 
 
 GtkCssSelectorTreeBuilder *_gtk_css_selector_tree_builder_new   (void);
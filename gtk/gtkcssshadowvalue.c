@@ -30,6 +30,7 @@
 #include "gtkpango.h"
 
 #include <math.h>
+#include <string.h>
 
 struct _GtkCssValue {
   GTK_CSS_VALUE_BASE
@@ -628,27 +629,145 @@ draw_shadow (const GtkCssValue   *shadow,
     gtk_css_shadow_value_finish_drawing (shadow, shadow_cr, blur_flags);
 }
 
+/* Blurred masks for the corners and sides of outset shadows. The
+ * spread and the size of the box don't need to be part of the key:
+ * the spread only changes the corner radii and the sides are
+ * stretched to any length. So resizing a window does not need to
+ * blur anything once its shadow has been drawn.
+ *
+ * The masks are kept in a least recently used order and the oldest
+ * ones are dropped when they exceed SHADOW_MASK_CACHE_MAX_SIZE.
+ */
+#define SHADOW_MASK_CACHE_MAX_SIZE (4 * 1024 * 1024)
+
+typedef enum {
+  SHADOW_MASK_CORNER,
+  SHADOW_MASK_SIDE
+} ShadowMaskType;
+
 typedef struct {
+  ShadowMaskType type;
   double radius;
-  GtkRoundedBoxCorner corner;
-} CornerMask;
+  double scale;
+  GtkRoundedBoxCorner corner;   /* for corners */
+  double offset;                /* for sides, the subpixel position of the edge */
+} ShadowMaskKey;
+
+typedef struct {
+  ShadowMaskKey key;
+  cairo_surface_t *surface;
+  gsize size;
+  GList link;
+} ShadowMask;
+
+static GHashTable *shadow_mask_cache = NULL;
+static GQueue shadow_mask_lru = G_QUEUE_INIT;
+static gsize shadow_mask_cache_size = 0;
 
 static guint
-corner_mask_hash (CornerMask *mask)
+shadow_mask_key_hash (gconstpointer data)
 {
-  return ((guint)mask->radius << 24) ^
-    ((guint)(mask->corner.horizontal*4)) << 12 ^
-    ((guint)(mask->corner.vertical*4)) << 0;
+  const ShadowMaskKey *key = data;
+
+  return ((guint)key->radius << 24) ^
+    ((guint)(key->corner.horizontal*4)) << 12 ^
+    ((guint)(key->corner.vertical*4)) << 0 ^
+    ((guint)(key->offset*256)) << 4 ^
+    ((guint)key->scale) << 20 ^
+    key->type;
 }
 
 static gboolean
-corner_mask_equal (CornerMask *mask1,
-                   CornerMask *mask2)
+shadow_mask_key_equal (gconstpointer data1,
+                       gconstpointer data2)
 {
+  const ShadowMaskKey *key1 = data1;
+  const ShadowMaskKey *key2 = data2;
+
   return
-    mask1->radius == mask2->radius &&
-    mask1->corner.horizontal == mask2->corner.horizontal &&
-    mask1->corner.vertical == mask2->corner.vertical;
+    key1->type == key2->type &&
+    key1->radius == key2->radius &&
+    key1->scale == key2->scale &&
+    key1->corner.horizontal == key2->corner.horizontal &&
+    key1->corner.vertical == key2->corner.vertical &&
+    key1->offset == key2->offset;
+}
+
+static void
+shadow_mask_free (ShadowMask *mask)
+{
+  cairo_surface_destroy (mask->surface);
+  g_slice_free (ShadowMask, mask);
+}
+
+static cairo_surface_t *
+shadow_mask_cache_lookup (const ShadowMaskKey *key)
+{
+  ShadowMask *mask;
+
+  if (shadow_mask_cache == NULL)
+    return NULL;
+
+  mask = g_hash_table_lookup (shadow_mask_cache, key);
+  if (mask == NULL)
+    return NULL;
+
+  g_queue_unlink (&shadow_mask_lru, &mask->link);
+  g_queue_push_head_link (&shadow_mask_lru, &mask->link);
+
+  return mask->surface;
+}
+
+/* Takes ownership of @surface */
+static void
+shadow_mask_cache_insert (const ShadowMaskKey *key,
+                          cairo_surface_t     *surface)
+{
+  ShadowMask *mask;
+
+  if (shadow_mask_cache == NULL)
+    shadow_mask_cache = g_hash_table_new_full (shadow_mask_key_hash,
+                                               shadow_mask_key_equal,
+                                               NULL, (GDestroyNotify) shadow_mask_free);
+
+  mask = g_slice_new0 (ShadowMask);
+  mask->key = *key;
+  mask->surface = surface;
+  mask->size = cairo_image_surface_get_stride (surface) * cairo_image_surface_get_height (surface);
+  mask->link.data = mask;
+
+  /* keep the new mask even if it is larger than the cache */
+  while (shadow_mask_lru.length > 0 &&
+         shadow_mask_cache_size + mask->size > SHADOW_MASK_CACHE_MAX_SIZE)
+    {
+      ShadowMask *oldest = g_queue_peek_tail (&shadow_mask_lru);
+
+      g_queue_unlink (&shadow_mask_lru, &oldest->link);
+      shadow_mask_cache_size -= oldest->size;
+      g_hash_table_remove (shadow_mask_cache, &oldest->key);
+    }
+
+  g_queue_push_head_link (&shadow_mask_lru, &mask->link);
+  shadow_mask_cache_size += mask->size;
+  g_hash_table_insert (shadow_mask_cache, &mask->key, mask);
+}
+
+static void
+shadow_mask_key_init (ShadowMaskKey  *key,
+                      ShadowMaskType  type,
+                      double          radius,
+                      cairo_t        *cr)
+{
+  double x_scale, y_scale;
+
+  x_scale = y_scale = 1;
+  cairo_surface_get_device_scale (cairo_get_target (cr), &x_scale, &y_scale);
+
+  /* zero the padding, too */
+  memset (key, 0, sizeof (ShadowMaskKey));
+  key->type = type;
+  key->radius = radius;
+  key->scale = x_scale;
 }
 
 static void
@@ -667,9 +786,8 @@ draw_shadow_corner (const GtkCssValue   *shadow,
   cairo_pattern_t *pattern;
   cairo_matrix_t matrix;
   double sx, sy;
-  static GHashTable *corner_mask_cache = NULL;
   double max_other;
-  CornerMask key;
+  ShadowMaskKey key;
   gboolean overlapped;
 
   radius = _gtk_css_number_value_get (shadow->radius, 0);
@@ -756,15 +874,10 @@ draw_shadow_corner (const GtkCssValue   *shadow,
    * mask, so we cache rendered masks based on the blur radius and the
    * corner radius.
    */
-  if (corner_mask_cache == NULL)
-    corner_mask_cache = g_hash_table_new_full ((GHashFunc)corner_mask_hash,
-                                               (GEqualFunc)corner_mask_equal,
-                                               g_free, (GDestroyNotify)cairo_surface_destroy);
-
-  key.radius = radius;
+  shadow_mask_key_init (&key, SHADOW_MASK_CORNER, radius, cr);
   key.corner = box->corner[corner];
 
-  mask = g_hash_table_lookup (corner_mask_cache, &key);
+  mask = shadow_mask_cache_lookup (&key);
   if (mask == NULL)
     {
       mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
@@ -777,7 +890,7 @@ draw_shadow_corner (const GtkCssValue   *shadow,
       cairo_fill (mask_cr);
       _gtk_cairo_blur_surface (mask, radius, GTK_BLUR_X | GTK_BLUR_Y);
       cairo_destroy (mask_cr);
-      g_hash_table_insert (corner_mask_cache, g_memdup (&key, sizeof (key)), mask);
+      shadow_mask_cache_insert (&key, mask);
     }
 
   gdk_cairo_set_source_rgba (cr, _gtk_css_rgba_value_get_rgba (shadow->color));
@@ -801,6 +914,11 @@ draw_shadow_side (const GtkCssValue   *shadow,
   GtkBlurFlags blur_flags = GTK_BLUR_REPEAT;
   gdouble radius, clip_radius;
   int x1, x2, y1, y2;
+  cairo_surface_t *mask;
+  cairo_pattern_t *pattern;
+  cairo_matrix_t matrix;
+  double edge, base, s, depth;
+  ShadowMaskKey key;
 
   radius = _gtk_css_number_value_get (shadow->radius, 0);
   clip_radius = _gtk_cairo_blur_compute_pixels (radius);
@@ -846,7 +964,83 @@ draw_shadow_side (const GtkCssValue   *shadow,
 
   cairo_rectangle (cr, x1, y1, x2 - x1, y2 - y1);
   cairo_clip (cr);
-  draw_shadow (shadow, cr, box, clip_box, blur_flags);
+
+  if (side == GTK_CSS_TOP || side == GTK_CSS_BOTTOM)
+    depth = box->box.height;
+  else
+    depth = box->box.width;
+
+  if (shadow->inset || depth < 2 * clip_radius + 1)
+    {
+      /* Fall back to generic path if inset or if the blur reaches
+         the opposite side of the box */
+      draw_shadow (shadow, cr, box, clip_box, blur_flags);
+      return;
+    }
+
+  if (has_empty_clip (cr))
+    return;
+
+  /* The corners have already been drawn, so what remains of an
+   * outset side is a straight edge of the box. Its blurred profile
+   * only depends on the blur radius and where the edge falls inside
+   * a pixel, so we cache a mask of it for a top side and flip and
+   * stretch it to every side of every box.
+   */
+  switch (side)
+    {
+    case GTK_CSS_TOP:
+      edge = box->box.y;
+      s = 1;
+      break;
+    case GTK_CSS_BOTTOM:
+      edge = - (box->box.y + box->box.height);
+      s = -1;
+      break;
+    case GTK_CSS_LEFT:
+      edge = box->box.x;
+      s = 1;
+      break;
+    case GTK_CSS_RIGHT:
+    default:
+      edge = - (box->box.x + box->box.width);
+      s = -1;
+      break;
+    }
+
+  base = floor (edge) - 2 * clip_radius;
+
+  shadow_mask_key_init (&key, SHADOW_MASK_SIDE, radius, cr);
+  key.offset = edge - floor (edge);
+
+  mask = shadow_mask_cache_lookup (&key);
+  if (mask == NULL)
+    {
+      cairo_t *mask_cr;
+      int height = 4 * clip_radius + 2;
+
+      /* at device resolution, like the text shadows */
+      mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
+                                                 1, ceil (height * key.scale));
+      cairo_surface_set_device_scale (mask, key.scale, key.scale);
+      mask_cr = cairo_create (mask);
+      cairo_rectangle (mask_cr, 0, 2 * clip_radius + key.offset, 1, height);
+      cairo_fill (mask_cr);
+      _gtk_cairo_blur_surface (mask, radius * key.scale, GTK_BLUR_Y);
+      cairo_destroy (mask_cr);
+      shadow_mask_cache_insert (&key, mask);
+    }
+
+  gdk_cairo_set_source_rgba (cr, _gtk_css_rgba_value_get_rgba (shadow->color));
+  pattern = cairo_pattern_create_for_surface (mask);
+  cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+  if (side == GTK_CSS_TOP || side == GTK_CSS_BOTTOM)
+    cairo_matrix_init (&matrix, 1, 0, 0, s, 0, -base);
+  else
+    cairo_matrix_init (&matrix, 0, s, 1, 0, 0, -base);
+  cairo_pattern_set_matrix (pattern, &matrix);
+  cairo_mask (cr, pattern);
+  cairo_pattern_destroy (pattern);
 }
 
 void
@@ -40,6 +40,268 @@
 
 G_DEFINE_TYPE (GtkCssStaticStyle, gtk_css_static_style, GTK_TYPE_CSS_STYLE)
 
+struct _GtkCssValues {
+  gint ref_count;
+  guint group :8;
+  guint shared :1;              /* in shared_values, must not be modified */
+  GtkCssValue *values[1];
+};
+
+static guint8 property_group[GTK_CSS_PROPERTY_N_PROPERTIES];
+static guint8 property_index[GTK_CSS_PROPERTY_N_PROPERTIES];
+static guint group_size[GTK_CSS_VALUES_N_GROUPS];
+
+/* Groups shared between styles, see gtk_css_values_share(). Neither
+ * this table nor the reference counts of groups are locked: styles
+ * are only computed and freed on the main thread. */
+static GHashTable *shared_values = NULL;
+
+static GtkCssValuesGroup
+gtk_css_values_group_for_property (guint id)
+{
+  switch (id)
+    {
+    case GTK_CSS_PROPERTY_COLOR:
+    case GTK_CSS_PROPERTY_DPI:
+    case GTK_CSS_PROPERTY_FONT_SIZE:
+    case GTK_CSS_PROPERTY_FONT_FAMILY:
+    case GTK_CSS_PROPERTY_FONT_STYLE:
+    case GTK_CSS_PROPERTY_FONT_VARIANT:
+    case GTK_CSS_PROPERTY_FONT_WEIGHT:
+    case GTK_CSS_PROPERTY_FONT_STRETCH:
+      return GTK_CSS_VALUES_FONT;
+
+    case GTK_CSS_PROPERTY_LETTER_SPACING:
+    case GTK_CSS_PROPERTY_TEXT_DECORATION_LINE:
+    case GTK_CSS_PROPERTY_TEXT_DECORATION_COLOR:
+    case GTK_CSS_PROPERTY_TEXT_DECORATION_STYLE:
+    case GTK_CSS_PROPERTY_TEXT_SHADOW:
+    case GTK_CSS_PROPERTY_CARET_COLOR:
+    case GTK_CSS_PROPERTY_SECONDARY_CARET_COLOR:
+      return GTK_CSS_VALUES_TEXT;
+
+    case GTK_CSS_PROPERTY_ICON_THEME:
+    case GTK_CSS_PROPERTY_ICON_PALETTE:
+    case GTK_CSS_PROPERTY_ICON_SOURCE:
+    case GTK_CSS_PROPERTY_ICON_SHADOW:
+    case GTK_CSS_PROPERTY_ICON_STYLE:
+    case GTK_CSS_PROPERTY_ICON_TRANSFORM:
+    case GTK_CSS_PROPERTY_ICON_EFFECT:
+      return GTK_CSS_VALUES_ICON;
+
+    case GTK_CSS_PROPERTY_BACKGROUND_COLOR:
+    case GTK_CSS_PROPERTY_BOX_SHADOW:
+    case GTK_CSS_PROPERTY_BACKGROUND_CLIP:
+    case GTK_CSS_PROPERTY_BACKGROUND_ORIGIN:
+    case GTK_CSS_PROPERTY_BACKGROUND_SIZE:
+    case GTK_CSS_PROPERTY_BACKGROUND_POSITION:
+    case GTK_CSS_PROPERTY_BACKGROUND_REPEAT:
+    case GTK_CSS_PROPERTY_BACKGROUND_IMAGE:
+      return GTK_CSS_VALUES_BACKGROUND;
+
+    case GTK_CSS_PROPERTY_BORDER_TOP_STYLE:
+    case GTK_CSS_PROPERTY_BORDER_TOP_WIDTH:
+    case GTK_CSS_PROPERTY_BORDER_LEFT_STYLE:
+    case GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH:
+    case GTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE:
+    case GTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH:
+    case GTK_CSS_PROPERTY_BORDER_RIGHT_STYLE:
+    case GTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH:
+    case GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS:
+    case GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS:
+    case GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS:
+    case GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS:
+    case GTK_CSS_PROPERTY_BORDER_TOP_COLOR:
+    case GTK_CSS_PROPERTY_BORDER_RIGHT_COLOR:
+    case GTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR:
+    case GTK_CSS_PROPERTY_BORDER_LEFT_COLOR:
+    case GTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE:
+    case GTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT:
+    case GTK_CSS_PROPERTY_BORDER_IMAGE_SLICE:
+    case GTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH:
+      return GTK_CSS_VALUES_BORDER;
+
+    case GTK_CSS_PROPERTY_OUTLINE_STYLE:
+    case GTK_CSS_PROPERTY_OUTLINE_WIDTH:
+    case GTK_CSS_PROPERTY_OUTLINE_OFFSET:
+    case GTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS:
+    case GTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS:
+    case GTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS:
+    case GTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS:
+    case GTK_CSS_PROPERTY_OUTLINE_COLOR:
+      return GTK_CSS_VALUES_OUTLINE;
+
+    case GTK_CSS_PROPERTY_MARGIN_TOP:
+    case GTK_CSS_PROPERTY_MARGIN_LEFT:
+    case GTK_CSS_PROPERTY_MARGIN_BOTTOM:
+    case GTK_CSS_PROPERTY_MARGIN_RIGHT:
+    case GTK_CSS_PROPERTY_PADDING_TOP:
+    case GTK_CSS_PROPERTY_PADDING_LEFT:
+    case GTK_CSS_PROPERTY_PADDING_BOTTOM:
+    case GTK_CSS_PROPERTY_PADDING_RIGHT:
+    case GTK_CSS_PROPERTY_MIN_WIDTH:
+    case GTK_CSS_PROPERTY_MIN_HEIGHT:
+      return GTK_CSS_VALUES_SIZE;
+
+    case GTK_CSS_PROPERTY_TRANSITION_PROPERTY:
+    case GTK_CSS_PROPERTY_TRANSITION_DURATION:
+    case GTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION:
+    case GTK_CSS_PROPERTY_TRANSITION_DELAY:
+    case GTK_CSS_PROPERTY_ANIMATION_NAME:
+    case GTK_CSS_PROPERTY_ANIMATION_DURATION:
+    case GTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION:
+    case GTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT:
+    case GTK_CSS_PROPERTY_ANIMATION_DIRECTION:
+    case GTK_CSS_PROPERTY_ANIMATION_PLAY_STATE:
+    case GTK_CSS_PROPERTY_ANIMATION_DELAY:
+    case GTK_CSS_PROPERTY_ANIMATION_FILL_MODE:
+      return GTK_CSS_VALUES_ANIMATION;
+
+    case GTK_CSS_PROPERTY_OPACITY:
+    case GTK_CSS_PROPERTY_ENGINE:
+    case GTK_CSS_PROPERTY_GTK_KEY_BINDINGS:
+    default:
+      return GTK_CSS_VALUES_OTHER;
+    }
+}
+
+static void
+gtk_css_values_init_groups (void)
+{
+  guint id;
+
+  for (id = 0; id < GTK_CSS_PROPERTY_N_PROPERTIES; id++)
+    {
+      GtkCssValuesGroup group = gtk_css_values_group_for_property (id);
+
+      property_group[id] = group;
+      property_index[id] = group_size[group]++;
+    }
+}
+
+static GtkCssValues *
+gtk_css_values_new (GtkCssValuesGroup group)
+{
+  GtkCssValues *values;
+
+  values = g_malloc0 (sizeof (GtkCssValues) + sizeof (GtkCssValue *) * (group_size[group] - 1));
+  values->ref_count = 1;
+  values->group = group;
+
+  return values;
+}
+
+static GtkCssValues *
+gtk_css_values_ref (GtkCssValues *values)
+{
+  values->ref_count++;
+
+  return values;
+}
+
+static void
+gtk_css_values_unref (GtkCssValues *values)
+{
+  guint i;
+
+  values->ref_count--;
+  if (values->ref_count > 0)
+    return;
+
+  if (values->shared)
+    g_hash_table_remove (shared_values, values);
+
+  for (i = 0; i < group_size[values->group]; i++)
+    {
+      if (values->values[i])
+        _gtk_css_value_unref (values->values[i]);
+    }
+
+  g_free (values);
+}
+
+static GtkCssValues *
+gtk_css_values_copy (const GtkCssValues *values)
+{
+  GtkCssValues *copy;
+  guint i;
+
+  copy = gtk_css_values_new (values->group);
+
+  for (i = 0; i < group_size[values->group]; i++)
+    {
+      if (values->values[i])
+        copy->values[i] = _gtk_css_value_ref (values->values[i]);
+    }
+
+  return copy;
+}
+
+static guint
+gtk_css_values_hash (gconstpointer data)
+{
+  const GtkCssValues *values = data;
+  guint i, hash;
+
+  hash = values->group;
+
+  for (i = 0; i < group_size[values->group]; i++)
+    {
+      hash = (hash << 5) - hash;
+      if (values->values[i])
+        hash += _gtk_css_value_hash (values->values[i]);
+    }
+
+  return hash;
+}
+
+static gboolean
+gtk_css_values_equal (gconstpointer data1,
+                      gconstpointer data2)
+{
+  const GtkCssValues *values1 = data1;
+  const GtkCssValues *values2 = data2;
+  guint i;
+
+  if (values1->group != values2->group)
+    return FALSE;
+
+  for (i = 0; i < group_size[values1->group]; i++)
+    {
+      if (!_gtk_css_value_equal0 (values1->values[i], values2->values[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Takes ownership of @values and returns a group with equal values
+ * that may be shared with other styles. */
+static GtkCssValues *
+gtk_css_values_share (GtkCssValues *values)
+{
+  GtkCssValues *shared;
+
+  if (values->shared)
+    return values;
+
+  if (G_UNLIKELY (shared_values == NULL))
+    shared_values = g_hash_table_new (gtk_css_values_hash, gtk_css_values_equal);
+
+  shared = g_hash_table_lookup (shared_values, values);
+  if (shared)
+    {
+      gtk_css_values_ref (shared);
+      gtk_css_values_unref (values);
+      return shared;
+    }
+
+  values->shared = TRUE;
+  g_hash_table_add (shared_values, values);
+
+  return values;
+}
+
 static GtkCssValue *
 gtk_css_static_style_get_value (GtkCssStyle *style,
                                 guint        id)
@@ -53,7 +315,10 @@ gtk_css_static_style_get_value (GtkCssStyle *style,
       return _gtk_css_style_property_get_initial_value (prop);
     }
 
-  return sstyle->values[id];
+  if (sstyle->groups[property_group[id]] == NULL)
+    return NULL;
+
+  return sstyle->groups[property_group[id]]->values[property_index[id]];
 }
 
 static GtkCssSection *
@@ -75,10 +340,13 @@ gtk_css_static_style_dispose (GObject *object)
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+  for (i = 0; i < GTK_CSS_VALUES_N_GROUPS; i++)
     {
-      if (style->values[i])
-        _gtk_css_value_unref (style->values[i]);
+      if (style->groups[i])
+        {
+          gtk_css_values_unref (style->groups[i]);
+          style->groups[i] = NULL;
+        }
     }
   if (style->sections)
     {
@@ -99,6 +367,8 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 
   style_class->get_value = gtk_css_static_style_get_value;
   style_class->get_section = gtk_css_static_style_get_section;
+
+  gtk_css_values_init_groups ();
 }
 
 static void
@@ -119,9 +389,25 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *style,
                                 GtkCssValue       *value,
                                 GtkCssSection     *section)
 {
-  if (style->values[id])
-    _gtk_css_value_unref (style->values[id]);
-  style->values[id] = _gtk_css_value_ref (value);
+  GtkCssValues **group = &style->groups[property_group[id]];
+  GtkCssValue **slot;
+
+  /* copy on write */
+  if (*group == NULL)
+    {
+      *group = gtk_css_values_new (property_group[id]);
+    }
+  else if ((*group)->shared || (*group)->ref_count > 1)
+    {
+      GtkCssValues *copy = gtk_css_values_copy (*group);
+      gtk_css_values_unref (*group);
+      *group = copy;
+    }
+
+  slot = &(*group)->values[property_index[id]];
+  if (*slot)
+    _gtk_css_value_unref (*slot);
+  *slot = _gtk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -168,7 +454,7 @@ gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
                                   const GtkCssMatcher     *matcher,
                                   GtkCssStyle             *parent)
 {
-  GtkCssStaticStyle *result;
+  GtkCssStyle *result;
   GtkCssLookup *lookup;
   GtkCssChange change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
 
@@ -180,6 +466,26 @@ gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
                                         lookup,
                                         &change);
 
+  result = gtk_css_static_style_new_from_lookup (provider, lookup, change, parent);
+
+  _gtk_css_lookup_free (lookup);
+
+  return result;
+}
+
+/* The second half of gtk_css_static_style_new_compute(): turns the
+ * winning declarations of an already done @lookup into computed
+ * values. This must happen on the main thread, computing values
+ * refs values, loads images and looks at settings. */
+GtkCssStyle *
+gtk_css_static_style_new_from_lookup (GtkStyleProviderPrivate *provider,
+                                      GtkCssLookup            *lookup,
+                                      GtkCssChange             change,
+                                      GtkCssStyle             *parent)
+{
+  GtkCssStaticStyle *result;
+  guint i;
+
   result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
 
   result->change = change;
@@ -189,7 +495,11 @@ gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
                            result,
                            parent);
 
-  _gtk_css_lookup_free (lookup);
+  for (i = 0; i < GTK_CSS_VALUES_N_GROUPS; i++)
+    {
+      if (result->groups[i])
+        result->groups[i] = gtk_css_values_share (result->groups[i]);
+    }
 
   return GTK_CSS_STYLE (result);
 }
@@ -227,6 +537,7 @@ gtk_css_static_style_compute_value (GtkCssStaticStyle       *style,
     _gtk_css_value_ref (specified);
 
   value = _gtk_css_value_compute (specified, id, provider, GTK_CSS_STYLE (style), parent_style);
+  value = _gtk_css_value_intern (value);
 
   gtk_css_static_style_set_value (style, id, value, section);
 
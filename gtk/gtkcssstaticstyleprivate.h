@@ -34,12 +34,29 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyle           GtkCssStaticStyle;
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssValues                GtkCssValues;
+
+/* Values are stored in groups of related properties. Groups are
+ * refcounted, shared between all styles with equal values for all
+ * properties in the group and copied when they are modified. */
+typedef enum {
+  GTK_CSS_VALUES_FONT,
+  GTK_CSS_VALUES_TEXT,
+  GTK_CSS_VALUES_ICON,
+  GTK_CSS_VALUES_BACKGROUND,
+  GTK_CSS_VALUES_BORDER,
+  GTK_CSS_VALUES_OUTLINE,
+  GTK_CSS_VALUES_SIZE,
+  GTK_CSS_VALUES_ANIMATION,
+  GTK_CSS_VALUES_OTHER,
+  GTK_CSS_VALUES_N_GROUPS
+} GtkCssValuesGroup;
 
 struct _GtkCssStaticStyle
 {
   GtkCssStyle parent;
 
-  GtkCssValue           *values[GTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
+  GtkCssValues          *groups[GTK_CSS_VALUES_N_GROUPS]; /* the values */
   GPtrArray             *sections;             /* sections the values are defined in */
 
   GtkCssChange           change;               /* change as returned by value lookup */
@@ -56,6 +73,10 @@ GtkCssStyle *           gtk_css_static_style_get_default        (void);
 GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProviderPrivate *provider,
                                                                  const GtkCssMatcher    *matcher,
                                                                  GtkCssStyle            *parent);
+GtkCssStyle *           gtk_css_static_style_new_from_lookup    (GtkStyleProviderPrivate *provider,
+                                                                 struct _GtkCssLookup   *lookup,
+                                                                 GtkCssChange            change,
+                                                                 GtkCssStyle            *parent);
 
 void                    gtk_css_static_style_compute_value      (GtkCssStaticStyle      *style,
                                                                  GtkStyleProviderPrivate*provider,
@@ -19,8 +19,77 @@
 
 #include "gtkcssstylechangeprivate.h"
 
+#include "gtkcssanimatedstyleprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 
+static void
+gtk_css_style_compare_value (GtkCssStyleChange *change,
+                             guint              id)
+{
+  if (!_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, id),
+                             gtk_css_style_get_value (change->new_style, id)))
+    {
+      change->affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (id));
+      change->changes = _gtk_bitmask_set (change->changes, id, TRUE);
+    }
+}
+
+static GtkCssStyle *
+gtk_css_style_get_intrinsic_style (GtkCssStyle *style)
+{
+  if (GTK_IS_CSS_ANIMATED_STYLE (style))
+    return GTK_CSS_ANIMATED_STYLE (style)->style;
+
+  return style;
+}
+
+static GPtrArray *
+gtk_css_style_get_animated_values (GtkCssStyle *style)
+{
+  if (GTK_IS_CSS_ANIMATED_STYLE (style))
+    return GTK_CSS_ANIMATED_STYLE (style)->animated_values;
+
+  return NULL;
+}
+
+/* If both styles animate the same intrinsic style, which is the case
+ * for every frame of a running animation, only the animated
+ * properties can differ. */
+static void
+gtk_css_style_compare_animated_values (GtkCssStyleChange *change)
+{
+  GPtrArray *old_values, *new_values;
+  guint i;
+
+  old_values = gtk_css_style_get_animated_values (change->old_style);
+  new_values = gtk_css_style_get_animated_values (change->new_style);
+
+  if (old_values)
+    {
+      for (i = 0; i < old_values->len; i++)
+        {
+          if (g_ptr_array_index (old_values, i))
+            gtk_css_style_compare_value (change, i);
+        }
+    }
+
+  if (new_values)
+    {
+      for (i = 0; i < new_values->len; i++)
+        {
+          if (g_ptr_array_index (new_values, i) == NULL)
+            continue;
+
+          if (old_values && i < old_values->len && g_ptr_array_index (old_values, i))
+            continue;
+
+          gtk_css_style_compare_value (change, i);
+        }
+    }
+
+  change->n_compared = GTK_CSS_PROPERTY_N_PROPERTIES;
+}
+
 void
 gtk_css_style_change_init (GtkCssStyleChange *change,
                            GtkCssStyle       *old_style,
@@ -37,6 +106,8 @@ gtk_css_style_change_init (GtkCssStyleChange *change,
   /* Make sure we don't do extra work if old and new are equal. */
   if (old_style == new_style)
     change->n_compared = GTK_CSS_PROPERTY_N_PROPERTIES;
+  else if (gtk_css_style_get_intrinsic_style (old_style) == gtk_css_style_get_intrinsic_style (new_style))
+    gtk_css_style_compare_animated_values (change);
 }
 
 void
@@ -65,12 +136,7 @@ gtk_css_style_compare_next_value (GtkCssStyleChange *change)
   if (change->n_compared == GTK_CSS_PROPERTY_N_PROPERTIES)
     return FALSE;
 
-  if (!_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, change->n_compared),
-                             gtk_css_style_get_value (change->new_style, change->n_compared)))
-    {
-      change->affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (change->n_compared));
-      change->changes = _gtk_bitmask_set (change->changes, change->n_compared, TRUE);
-    }
+  gtk_css_style_compare_value (change, change->n_compared);
 
   change->n_compared++;
 
@@ -75,6 +75,16 @@ _gtk_css_change_for_child (GtkCssChange match)
 #undef PARENT_SHIFT
 }
 
+/* @match and all the changes it causes for the following siblings,
+ * the children and the children of the following siblings */
+GtkCssChange
+_gtk_css_change_for_dependents (GtkCssChange match)
+{
+  GtkCssChange sibling = _gtk_css_change_for_sibling (match);
+
+  return match | sibling | _gtk_css_change_for_child (match) | _gtk_css_change_for_child (sibling);
+}
+
 void
 gtk_css_change_print (GtkCssChange  change,
                       GString      *string)
@@ -376,6 +376,7 @@ typedef enum /*< skip >*/ {
 
 GtkCssChange            _gtk_css_change_for_sibling              (GtkCssChange       match);
 GtkCssChange            _gtk_css_change_for_child                (GtkCssChange       match);
+GtkCssChange            _gtk_css_change_for_dependents           (GtkCssChange       match);
 
 GtkCssDimension         gtk_css_unit_get_dimension               (GtkCssUnit         unit);
 
@@ -29,6 +29,16 @@ struct _GtkCssValue {
 
 G_DEFINE_BOXED_TYPE (GtkCssValue, _gtk_css_value, _gtk_css_value_ref, _gtk_css_value_unref)
 
+/* Set of computed values that are shared between styles.
+ * The set does not hold a reference, values remove themselves
+ * when they are freed.
+ *
+ * Like the reference counts of values, the set is not locked, so
+ * values must only be created and freed on the main thread. Style
+ * lookups in worker threads, see gtk_css_node_validate(), neither
+ * parse nor compute values for that reason. */
+static GHashTable *interned_values = NULL;
+
 GtkCssValue *
 _gtk_css_value_alloc (const GtkCssValueClass *klass,
                       gsize                   size)
@@ -63,6 +73,10 @@ _gtk_css_value_unref (GtkCssValue *value)
   if (value->ref_count > 0)
     return;
 
+  if (value->class->hash && interned_values &&
+      g_hash_table_lookup (interned_values, value) == value)
+    g_hash_table_remove (interned_values, value);
+
   value->class->free (value);
 }
 
@@ -127,6 +141,65 @@ _gtk_css_value_equal0 (const GtkCssValue *value1,
   return _gtk_css_value_equal (value1, value2);
 }
 
+guint
+_gtk_css_value_hash (const GtkCssValue *value)
+{
+  guint hash;
+
+  gtk_internal_return_val_if_fail (value != NULL, 0);
+
+  hash = GPOINTER_TO_UINT (value->class);
+  if (value->class->hash)
+    hash ^= value->class->hash (value);
+
+  return hash;
+}
+
+/**
+ * _gtk_css_value_intern:
+ * @value: (transfer full): a computed value
+ *
+ * Looks up a value equal to @value in the set of shared values and
+ * returns it instead of @value. If no such value exists, @value is
+ * added to the set. Values whose class does not provide a hash
+ * function are returned unchanged.
+ *
+ * Sharing values saves memory and makes comparisons of equal values
+ * in different styles trivial, because _gtk_css_value_equal() checks
+ * for identical pointers first.
+ *
+ * Returns: (transfer full): the shared value
+ **/
+GtkCssValue *
+_gtk_css_value_intern (GtkCssValue *value)
+{
+  GtkCssValue *interned;
+
+  gtk_internal_return_val_if_fail (value != NULL, NULL);
+
+  if (value->class->hash == NULL)
+    return value;
+
+  if (G_UNLIKELY (interned_values == NULL))
+    interned_values = g_hash_table_new ((GHashFunc) _gtk_css_value_hash,
+                                        (GEqualFunc) _gtk_css_value_equal);
+
+  interned = g_hash_table_lookup (interned_values, value);
+  if (interned == value)
+    return value;
+
+  if (interned)
+    {
+      _gtk_css_value_ref (interned);
+      _gtk_css_value_unref (value);
+      return interned;
+    }
+
+  g_hash_table_add (interned_values, value);
+
+  return value;
+}
+
 GtkCssValue *
 _gtk_css_value_transition (GtkCssValue *start,
                            GtkCssValue *end,
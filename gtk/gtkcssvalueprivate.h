@@ -53,6 +53,8 @@ struct _GtkCssValueClass {
                                                        double                      progress);
   void          (* print)                             (const GtkCssValue          *value,
                                                        GString                    *string);
+  /* NULL if the value can't be interned */
+  guint         (* hash)                              (const GtkCssValue          *value);
 };
 
 GType        _gtk_css_value_get_type                  (void) G_GNUC_CONST;
@@ -73,6 +75,8 @@ gboolean     _gtk_css_value_equal                     (const GtkCssValue
                                                        const GtkCssValue          *value2);
 gboolean     _gtk_css_value_equal0                    (const GtkCssValue          *value1,
                                                        const GtkCssValue          *value2);
+guint        _gtk_css_value_hash                      (const GtkCssValue          *value);
+GtkCssValue *_gtk_css_value_intern                    (GtkCssValue                *value) G_GNUC_WARN_UNUSED_RESULT;
 GtkCssValue *_gtk_css_value_transition                (GtkCssValue                *start,
                                                        GtkCssValue                *end,
                                                        guint                       property_id,
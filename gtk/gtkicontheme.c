@@ -363,6 +363,7 @@ static BuiltinIcon *find_builtin_icon         (const gchar      *icon_name,
 static void         remove_from_lru_cache     (GtkIconTheme     *icon_theme,
                                                GtkIconInfo      *icon_info);
 static gboolean     icon_info_ensure_scale_and_pixbuf (GtkIconInfo* icon_info);
+static void         symbolic_mask_cache_clear (void);
 
 static guint signal_changed = 0;
 
@@ -801,6 +802,7 @@ do_theme_change (GtkIconTheme *icon_theme)
   GtkIconThemePrivate *priv = icon_theme->priv;
 
   g_hash_table_remove_all (priv->info_cache);
+  symbolic_mask_cache_clear ();
 
   if (!priv->themes_valid)
     return;
@@ -4274,17 +4276,6 @@ symbolic_cache_get_proxy (SymbolicPixbufCache *symbolic_cache,
   return symbolic_cache->proxy_pixbuf;
 }
 
-static gchar *
-rgba_to_string_noalpha (const GdkRGBA *rgba)
-{
-  GdkRGBA color;
-
-  color = *rgba;
-  color.alpha = 1.0;
-
-  return gdk_rgba_to_string (&color);
-}
-
 static void
 rgba_to_pixel(const GdkRGBA  *rgba,
 	      guint8 pixel[4])
@@ -4295,26 +4286,31 @@ rgba_to_pixel(const GdkRGBA  *rgba,
   pixel[3] = 255;
 }
 
-GdkPixbuf *
-gtk_icon_theme_color_symbolic_pixbuf (GdkPixbuf     *symbolic,
-                                      const GdkRGBA *fg_color,
-                                      const GdkRGBA *success_color,
-                                      const GdkRGBA *warning_color,
-                                      const GdkRGBA *error_color)
+/* Rounds the way gdk_rgba_to_string() does, which is how colors
+ * got into symbolic SVGs before they were recolored from masks.
+ */
+static void
+rgba_to_pixel_rounded (const GdkRGBA *rgba,
+                       guint8         pixel[4])
+{
+  pixel[0] = 0.5 + CLAMP (rgba->red, 0., 1.) * 255.;
+  pixel[1] = 0.5 + CLAMP (rgba->green, 0., 1.) * 255.;
+  pixel[2] = 0.5 + CLAMP (rgba->blue, 0., 1.) * 255.;
+  pixel[3] = 255;
+}
+
+static GdkPixbuf *
+color_symbolic_pixbuf (GdkPixbuf    *symbolic,
+                       int           alpha,
+                       const guint8  fg_pixel[4],
+                       const guint8  success_pixel[4],
+                       const guint8  warning_pixel[4],
+                       const guint8  error_pixel[4])
 {
   int width, height, x, y, src_stride, dst_stride;
   guchar *src_data, *dst_data;
   guchar *src_row, *dst_row;
-  int alpha;
   GdkPixbuf *colored;
-  guint8 fg_pixel[4], success_pixel[4], warning_pixel[4], error_pixel[4];
-
-  alpha = fg_color->alpha * 255;
-
-  rgba_to_pixel (fg_color, fg_pixel);
-  rgba_to_pixel (success_color, success_pixel);
-  rgba_to_pixel (warning_color, warning_pixel);
-  rgba_to_pixel (error_color, error_pixel);
 
   width = gdk_pixbuf_get_width (symbolic);
   height = gdk_pixbuf_get_height (symbolic);
@@ -4379,6 +4375,168 @@ gtk_icon_theme_color_symbolic_pixbuf (GdkPixbuf     *symbolic,
   return colored;
 }
 
+GdkPixbuf *
+gtk_icon_theme_color_symbolic_pixbuf (GdkPixbuf     *symbolic,
+                                      const GdkRGBA *fg_color,
+                                      const GdkRGBA *success_color,
+                                      const GdkRGBA *warning_color,
+                                      const GdkRGBA *error_color)
+{
+  guint8 fg_pixel[4], success_pixel[4], warning_pixel[4], error_pixel[4];
+
+  rgba_to_pixel (fg_color, fg_pixel);
+  rgba_to_pixel (success_color, success_pixel);
+  rgba_to_pixel (warning_color, warning_pixel);
+  rgba_to_pixel (error_color, error_pixel);
+
+  return color_symbolic_pixbuf (symbolic, fg_color->alpha * 255,
+                                fg_pixel, success_pixel, warning_pixel, error_pixel);
+}
+
+static const GdkRGBA symbolic_fg_default = { 0.7450980392156863, 0.7450980392156863, 0.7450980392156863, 1.0};
+static const GdkRGBA symbolic_success_default = { 0.3046921492332342,0.6015716792553597, 0.023437857633325704, 1.0};
+static const GdkRGBA symbolic_warning_default = {0.9570458533607996, 0.47266346227206835, 0.2421911955443656, 1.0 };
+static const GdkRGBA symbolic_error_default = { 0.796887159533074, 0 ,0, 1.0 };
+
+/* What symbolic SVGs were always rendered with */
+static const guint8 symbolic_svg_success_default[4] = { 78, 154, 6, 255 };
+static const guint8 symbolic_svg_warning_default[4] = { 245, 121, 62, 255 };
+static const guint8 symbolic_svg_error_default[4] = { 204, 0, 0, 255 };
+
+/* Symbolic SVG icons are only rendered once per file and size, into
+ * a mask that gets recolored for every set of colors, see
+ * gtk_icon_info_render_symbolic_mask(). The masks are shared by all
+ * icon themes and loaded from other threads too.
+ */
+#define MAX_SYMBOLIC_MASK_CACHE_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+  GFile *file;
+  gint width;
+  gint height;
+  GdkPixbuf *mask;
+  GList link;
+} SymbolicMask;
+
+G_LOCK_DEFINE_STATIC (symbolic_masks);
+static GHashTable *symbolic_masks = NULL;
+static GQueue symbolic_mask_lru = G_QUEUE_INIT;
+static gsize symbolic_mask_cache_size = 0;
+
+static guint
+symbolic_mask_hash (gconstpointer key)
+{
+  const SymbolicMask *mask = key;
+
+  return g_file_hash (mask->file) ^ (mask->width << 16) ^ mask->height;
+}
+
+static gboolean
+symbolic_mask_equal (gconstpointer a,
+                     gconstpointer b)
+{
+  const SymbolicMask *mask_a = a;
+  const SymbolicMask *mask_b = b;
+
+  return mask_a->width == mask_b->width &&
+         mask_a->height == mask_b->height &&
+         g_file_equal (mask_a->file, mask_b->file);
+}
+
+static void
+symbolic_mask_free (gpointer data)
+{
+  SymbolicMask *mask = data;
+
+  g_queue_unlink (&symbolic_mask_lru, &mask->link);
+  symbolic_mask_cache_size -= gdk_pixbuf_get_byte_length (mask->mask);
+
+  g_object_unref (mask->file);
+  g_object_unref (mask->mask);
+  g_slice_free (SymbolicMask, mask);
+}
+
+static GdkPixbuf *
+symbolic_mask_cache_lookup (GFile *file,
+                            gint   width,
+                            gint   height)
+{
+  SymbolicMask key, *mask;
+  GdkPixbuf *result = NULL;
+
+  key.file = file;
+  key.width = width;
+  key.height = height;
+
+  G_LOCK (symbolic_masks);
+
+  if (symbolic_masks != NULL)
+    {
+      mask = g_hash_table_lookup (symbolic_masks, &key);
+      if (mask != NULL)
+        {
+          g_queue_unlink (&symbolic_mask_lru, &mask->link);
+          g_queue_push_head_link (&symbolic_mask_lru, &mask->link);
+          result = g_object_ref (mask->mask);
+        }
+    }
+
+  G_UNLOCK (symbolic_masks);
+
+  return result;
+}
+
+static void
+symbolic_mask_cache_insert (GFile     *file,
+                            gint       width,
+                            gint       height,
+                            GdkPixbuf *pixbuf)
+{
+  SymbolicMask *mask, *last;
+
+  mask = g_slice_new0 (SymbolicMask);
+  mask->file = g_object_ref (file);
+  mask->width = width;
+  mask->height = height;
+  mask->mask = g_object_ref (pixbuf);
+  mask->link.data = mask;
+
+  G_LOCK (symbolic_masks);
+
+  if (symbolic_masks == NULL)
+    symbolic_masks = g_hash_table_new_full (symbolic_mask_hash,
+                                            symbolic_mask_equal,
+                                            NULL,
+                                            symbolic_mask_free);
+
+  /* Another thread might have rendered it at the same time */
+  g_hash_table_remove (symbolic_masks, mask);
+
+  g_hash_table_add (symbolic_masks, mask);
+  g_queue_push_head_link (&symbolic_mask_lru, &mask->link);
+  symbolic_mask_cache_size += gdk_pixbuf_get_byte_length (pixbuf);
+
+  while (symbolic_mask_cache_size > MAX_SYMBOLIC_MASK_CACHE_SIZE &&
+         symbolic_mask_lru.tail != &mask->link)
+    {
+      last = symbolic_mask_lru.tail->data;
+      g_hash_table_remove (symbolic_masks, last);
+    }
+
+  G_UNLOCK (symbolic_masks);
+}
+
+static void
+symbolic_mask_cache_clear (void)
+{
+  G_LOCK (symbolic_masks);
+
+  if (symbolic_masks != NULL)
+    g_hash_table_remove_all (symbolic_masks);
+
+  G_UNLOCK (symbolic_masks);
+}
+
 static GdkPixbuf *
 gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
                                  const GdkRGBA  *fg,
@@ -4387,11 +4545,6 @@ gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
                                  const GdkRGBA  *error_color,
                                  GError        **error)
 {
-  GdkRGBA fg_default = { 0.7450980392156863, 0.7450980392156863, 0.7450980392156863, 1.0};
-  GdkRGBA success_default = { 0.3046921492332342,0.6015716792553597, 0.023437857633325704, 1.0};
-  GdkRGBA warning_default = {0.9570458533607996, 0.47266346227206835, 0.2421911955443656, 1.0 };
-  GdkRGBA error_default = { 0.796887159533074, 0 ,0, 1.0 };
-
   if (!icon_info_ensure_scale_and_pixbuf (icon_info))
     {
       if (icon_info->load_error)
@@ -4411,65 +4564,133 @@ gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
     }
 
   return gtk_icon_theme_color_symbolic_pixbuf (icon_info->pixbuf,
-                                               fg ? fg : &fg_default,
-                                               success_color ? success_color : &success_default,
-                                               warning_color ? warning_color : &warning_default,
-                                               error_color ? error_color : &error_default);
+                                               fg ? fg : &symbolic_fg_default,
+                                               success_color ? success_color : &symbolic_success_default,
+                                               warning_color ? warning_color : &symbolic_warning_default,
+                                               error_color ? error_color : &symbolic_error_default);
 }
 
 static GdkPixbuf *
-gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
-                                 const GdkRGBA  *fg,
-                                 const GdkRGBA  *success_color,
-                                 const GdkRGBA  *warning_color,
-                                 const GdkRGBA  *error_color,
-                                 GError        **error)
+load_symbolic_svg (GtkIconInfo  *icon_info,
+                   const gchar  *escaped_file_data,
+                   const gchar  *css_fg,
+                   const gchar  *css_success,
+                   const gchar  *css_warning,
+                   const gchar  *css_error,
+                   gint          width,
+                   gint          height,
+                   GError      **error)
 {
   GInputStream *stream;
   GdkPixbuf *pixbuf;
-  gchar *css_fg;
-  gchar *css_success;
-  gchar *css_warning;
-  gchar *css_error;
   gchar *data;
-  gchar *width;
-  gchar *height;
-  gchar *file_data, *escaped_file_data;
-  gsize file_len;
-  gint symbolic_size;
-  double alpha;
-  gchar alphastr[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar *svg_width;
+  gchar *svg_height;
+
+  svg_width = g_strdup_printf ("%d", icon_info->symbolic_width);
+  svg_height = g_strdup_printf ("%d", icon_info->symbolic_height);
+
+  data = g_strconcat ("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+                      "<svg version=\"1.1\"\n"
+                      "     xmlns=\"http://www.w3.org/2000/svg\"\n"
+                      "     xmlns:xi=\"http://www.w3.org/2001/XInclude\"\n"
+                      "     width=\"", svg_width, "\"\n"
+                      "     height=\"", svg_height, "\">\n"
+                      "  <style type=\"text/css\">\n"
+                      "    rect,path {\n"
+                      "      fill: ", css_fg," !important;\n"
+                      "    }\n"
+                      "    .warning {\n"
+                      "      fill: ", css_warning, " !important;\n"
+                      "    }\n"
+                      "    .error {\n"
+                      "      fill: ", css_error ," !important;\n"
+                      "    }\n"
+                      "    .success {\n"
+                      "      fill: ", css_success, " !important;\n"
+                      "    }\n"
+                      "  </style>\n"
+                      "  <xi:include href=\"data:text/xml,", escaped_file_data, "\"/>\n"
+                      "</svg>",
+                      NULL);
+  g_free (svg_width);
+  g_free (svg_height);
 
-  alpha = fg->alpha;
+  stream = g_memory_input_stream_new_from_data (data, -1, g_free);
+  pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
+                                                width,
+                                                height,
+                                                TRUE,
+                                                NULL,
+                                                error);
+  g_object_unref (stream);
 
-  css_fg = rgba_to_string_noalpha (fg);
+  return pixbuf;
+}
 
-  css_success = css_warning = css_error = NULL;
+static void
+copy_plane (GdkPixbuf *src,
+            GdkPixbuf *dst,
+            gint       from_plane,
+            gint       to_plane)
+{
+  guchar *src_data, *dst_data;
+  guchar *src_row, *dst_row;
+  gint width, height, src_stride, dst_stride;
+  gint x, y;
 
-  if (warning_color)
-    css_warning = rgba_to_string_noalpha (warning_color);
-  else
-    css_warning = g_strdup ("rgb(245,121,62)");
+  width = MIN (gdk_pixbuf_get_width (src), gdk_pixbuf_get_width (dst));
+  height = MIN (gdk_pixbuf_get_height (src), gdk_pixbuf_get_height (dst));
 
-  if (error_color)
-    css_error = rgba_to_string_noalpha (error_color);
-  else
-    css_error = g_strdup ("rgb(204,0,0)");
+  src_stride = gdk_pixbuf_get_rowstride (src);
+  src_data = gdk_pixbuf_get_pixels (src);
 
-  if (success_color)
-    css_success = rgba_to_string_noalpha (success_color);
-  else
-    css_success = g_strdup ("rgb(78,154,6)");
+  dst_stride = gdk_pixbuf_get_rowstride (dst);
+  dst_data = gdk_pixbuf_get_pixels (dst);
+
+  for (y = 0; y < height; y++)
+    {
+      src_row = src_data + src_stride * y;
+      dst_row = dst_data + dst_stride * y;
+      for (x = 0; x < width; x++)
+        {
+          dst_row[to_plane] = src_row[from_plane];
+          src_row += 4;
+          dst_row += 4;
+        }
+    }
+}
+
+/* Renders the icon into the format of .symbolic.png files, which
+ * gtk_icon_theme_color_symbolic_pixbuf() can recolor: the red, green
+ * and blue channels hold how much of the success, warning and error
+ * colors go into each pixel, and the foreground color makes up the
+ * rest. This renders the SVG once for each class the icon uses, with
+ * that class in red and everything else in green. Icons using none of
+ * the classes are rendered once, for the alpha channel.
+ */
+static GdkPixbuf *
+gtk_icon_info_render_symbolic_mask (GtkIconInfo  *icon_info,
+                                    gint          width,
+                                    gint          height,
+                                    GError      **error)
+{
+  GInputStream *stream;
+  GdkPixbuf *pixbuf, *mask;
+  gchar *file_data, *escaped_file_data;
+  static const gchar *classes[] = { "success", "warning", "error" };
+  gboolean uses_class[3];
+  gboolean has_alpha;
+  gsize file_len;
+  gint symbolic_size;
+  gint plane;
 
   if (!g_file_load_contents (icon_info->icon_file, NULL, &file_data, &file_len, NULL, error))
     return NULL;
 
-  if (!icon_info_ensure_scale_and_pixbuf (icon_info))
-    {
-      g_propagate_error (error, icon_info->load_error);
-      icon_info->load_error = NULL;
-      return NULL;
-    }
+  /* A class the file doesn't mention can't color anything */
+  for (plane = 0; plane < 3; plane++)
+    uses_class[plane] = g_strstr_len (file_data, file_len, classes[plane]) != NULL;
 
   if (icon_info->symbolic_width == 0 ||
       icon_info->symbolic_height == 0)
@@ -4480,7 +4701,10 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
       g_object_unref (stream);
 
       if (!pixbuf)
-        return NULL;
+        {
+          g_free (file_data);
+          return NULL;
+        }
 
       icon_info->symbolic_width = gdk_pixbuf_get_width (pixbuf);
       icon_info->symbolic_height = gdk_pixbuf_get_height (pixbuf);
@@ -4500,58 +4724,112 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
              icon_info->dir_size * icon_info->dir_scale)
   );
 
-  width = g_strdup_printf ("%d", icon_info->symbolic_width);
-  height = g_strdup_printf ("%d", icon_info->symbolic_height);
-
   escaped_file_data = g_markup_escape_text (file_data, file_len);
   g_free (file_data);
 
-  g_ascii_dtostr (alphastr, G_ASCII_DTOSTR_BUF_SIZE, CLAMP (alpha, 0, 1));
+  mask = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+  gdk_pixbuf_fill (mask, 0);
+
+  has_alpha = FALSE;
+  for (plane = 0; plane < 4; plane++)
+    {
+      /* The last rendering is only needed for the alpha channel
+       * of icons using none of the classes.
+       */
+      if (plane < 3 ? !uses_class[plane] : has_alpha)
+        continue;
+
+      /* All colors are opaque, so every rendering has the final
+       * alpha channel.
+       */
+      pixbuf = load_symbolic_svg (icon_info,
+                                  escaped_file_data,
+                                  "rgb(0,255,0)",
+                                  plane == 0 ? "rgb(255,0,0)" : "rgb(0,255,0)",
+                                  plane == 1 ? "rgb(255,0,0)" : "rgb(0,255,0)",
+                                  plane == 2 ? "rgb(255,0,0)" : "rgb(0,255,0)",
+                                  width, height,
+                                  error);
+      if (pixbuf == NULL)
+        {
+          g_object_unref (mask);
+          g_free (escaped_file_data);
+          return NULL;
+        }
+
+      if (!has_alpha)
+        {
+          copy_plane (pixbuf, mask, 3, 3);
+          has_alpha = TRUE;
+        }
+
+      if (plane < 3)
+        copy_plane (pixbuf, mask, 0, plane);
+      g_object_unref (pixbuf);
+    }
 
-  data = g_strconcat ("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
-                      "<svg version=\"1.1\"\n"
-                      "     xmlns=\"http://www.w3.org/2000/svg\"\n"
-                      "     xmlns:xi=\"http://www.w3.org/2001/XInclude\"\n"
-                      "     width=\"", width, "\"\n"
-                      "     height=\"", height, "\">\n"
-                      "  <style type=\"text/css\">\n"
-                      "    rect,path {\n"
-                      "      fill: ", css_fg," !important;\n"
-                      "    }\n"
-                      "    .warning {\n"
-                      "      fill: ", css_warning, " !important;\n"
-                      "    }\n"
-                      "    .error {\n"
-                      "      fill: ", css_error ," !important;\n"
-                      "    }\n"
-                      "    .success {\n"
-                      "      fill: ", css_success, " !important;\n"
-                      "    }\n"
-                      "  </style>\n"
-                      "  <g opacity=\"", alphastr, "\" ><xi:include href=\"data:text/xml,", escaped_file_data, "\"/></g>\n"
-                      "</svg>",
-                      NULL);
   g_free (escaped_file_data);
-  g_free (css_fg);
-  g_free (css_warning);
-  g_free (css_error);
-  g_free (css_success);
-  g_free (width);
-  g_free (height);
 
-  stream = g_memory_input_stream_new_from_data (data, -1, g_free);
-  pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
-                                                gdk_pixbuf_get_width (icon_info->pixbuf),
-                                                gdk_pixbuf_get_height (icon_info->pixbuf),
-                                                TRUE,
-                                                NULL,
-                                                error);
-  g_object_unref (stream);
+  return mask;
+}
+
+static GdkPixbuf *
+gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
+                                 const GdkRGBA  *fg,
+                                 const GdkRGBA  *success_color,
+                                 const GdkRGBA  *warning_color,
+                                 const GdkRGBA  *error_color,
+                                 GError        **error)
+{
+  GdkPixbuf *mask, *pixbuf;
+  guint8 fg_pixel[4], success_pixel[4], warning_pixel[4], error_pixel[4];
+  gint width, height;
+
+  if (!icon_info_ensure_scale_and_pixbuf (icon_info))
+    {
+      g_propagate_error (error, icon_info->load_error);
+      icon_info->load_error = NULL;
+      return NULL;
+    }
+
+  width = gdk_pixbuf_get_width (icon_info->pixbuf);
+  height = gdk_pixbuf_get_height (icon_info->pixbuf);
+
+  mask = symbolic_mask_cache_lookup (icon_info->icon_file, width, height);
+  if (mask == NULL)
+    {
+      mask = gtk_icon_info_render_symbolic_mask (icon_info, width, height, error);
+      if (mask == NULL)
+        return NULL;
+
+      symbolic_mask_cache_insert (icon_info->icon_file, width, height, mask);
+    }
+
+  rgba_to_pixel_rounded (fg, fg_pixel);
+
+  if (success_color)
+    rgba_to_pixel_rounded (success_color, success_pixel);
+  else
+    memcpy (success_pixel, symbolic_svg_success_default, 4);
+
+  if (warning_color)
+    rgba_to_pixel_rounded (warning_color, warning_pixel);
+  else
+    memcpy (warning_pixel, symbolic_svg_warning_default, 4);
+
+  if (error_color)
+    rgba_to_pixel_rounded (error_color, error_pixel);
+  else
+    memcpy (error_pixel, symbolic_svg_error_default, 4);
+
+  pixbuf = color_symbolic_pixbuf (mask,
+                                  0.5 + CLAMP (fg->alpha, 0., 1.) * 255.,
+                                  fg_pixel, success_pixel, warning_pixel, error_pixel);
+  g_object_unref (mask);
 
   return pixbuf;
 }
 
-
 static GdkPixbuf *
 gtk_icon_info_load_symbolic_internal (GtkIconInfo    *icon_info,
 				      const GdkRGBA  *fg,
@@ -27,24 +27,51 @@
    to make scrolling more efficient */
 #define DEFAULT_EXTRA_SIZE 64
 
-/* When resizing viewport we allow this extra
-   size to avoid constantly reallocating when resizing */
-#define ALLOW_SMALLER_SIZE_FACTOR 0.5
-#define ALLOW_LARGER_SIZE_FACTOR  1.25
+/* The cache is made of square tiles in canvas coordinates, so that
+   scrolling only needs to render the tiles that come into view and
+   can keep the others as they are. */
+#define TILE_SIZE 128
 
-struct _GtkPixelCache {
+/* All the tiles of all the caches in the process are kept in the
+   order they were last drawn, and the least recently used ones are
+   dropped when they take more than this. Tiles that are needed for
+   the current draw are never dropped. */
+#define MAX_TILES_SIZE (32 * 1024 * 1024)
+
+/* Surfaces of dropped tiles are kept around for new tiles */
+#define MAX_POOLED_TILES 16
+
+/* The scratch surface tiles are repainted through is kept between
+   frames, and grown in steps of this */
+#define SCRATCH_STEP TILE_SIZE
+
+typedef struct _GtkPixelCacheTile GtkPixelCacheTile;
+
+struct _GtkPixelCacheTile {
+  GtkPixelCache *cache;
+  gint64 key;
+
+  /* Position in canvas coordinates */
+  int x;
+  int y;
+
+  /* The screen is referenced so that pooled surfaces are never
+     matched against an unrelated screen reusing its address */
   cairo_surface_t *surface;
-  cairo_content_t content;
+  GdkScreen *screen;
+  GdkVisual *visual;
+  int scale;
 
-  /* Valid if surface != NULL */
-  int surface_x;
-  int surface_y;
-  int surface_w;
-  int surface_h;
-  double surface_scale;
+  /* In tile coordinates, may be null if not dirty */
+  cairo_region_t *dirty;
 
-  /* may be null if not dirty */
-  cairo_region_t *surface_dirty;
+  guint serial;
+  GList link;
+};
+
+struct _GtkPixelCache {
+  GHashTable *tiles;
+  cairo_content_t content;
 
   /* background tracking for rgb/rgba */
   GtkStyleContext *style_context;
@@ -57,12 +84,176 @@ struct _GtkPixelCache {
   guint always_cache : 1;
 };
 
+static GQueue tile_lru = G_QUEUE_INIT;
+static gsize tiles_size = 0;
+static guint draw_serial = 0;
+static GSList *tile_pool = NULL;
+static guint n_pooled_tiles = 0;
+
+static cairo_surface_t *scratch_surface = NULL;
+static GdkScreen *scratch_screen = NULL;
+static GdkVisual *scratch_visual = NULL;
+static int scratch_scale = 0;
+static int scratch_width = 0;
+static int scratch_height = 0;
+
+static gsize
+gtk_pixel_cache_tile_get_size (GtkPixelCacheTile *tile)
+{
+  return 4 * TILE_SIZE * TILE_SIZE * tile->scale * tile->scale;
+}
+
+static gint64
+gtk_pixel_cache_tile_key (int x,
+                          int y)
+{
+  return (gint64) (((guint64) (guint32) x << 32) | (guint32) y);
+}
+
+/* Whether a surface created for screen, visual and scale can be
+   used in place of one similar to window */
+static gboolean
+gtk_pixel_cache_surface_matches (cairo_surface_t *surface,
+                                 GdkScreen       *screen,
+                                 GdkVisual       *visual,
+                                 int              scale,
+                                 GdkWindow       *window,
+                                 cairo_content_t  content)
+{
+  return screen == gdk_window_get_screen (window) &&
+         visual == gdk_window_get_visual (window) &&
+         scale == gdk_window_get_scale_factor (window) &&
+         cairo_surface_get_content (surface) == content;
+}
+
+static void
+gtk_pixel_cache_drop_scratch (void)
+{
+  g_clear_pointer (&scratch_surface, cairo_surface_destroy);
+  g_clear_object (&scratch_screen);
+  scratch_visual = NULL;
+  scratch_scale = 0;
+  scratch_width = 0;
+  scratch_height = 0;
+}
+
+static void
+gtk_pixel_cache_tile_destroy (GtkPixelCacheTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+  g_object_unref (tile->screen);
+  g_slice_free (GtkPixelCacheTile, tile);
+}
+
+static void
+gtk_pixel_cache_tile_free (GtkPixelCacheTile *tile)
+{
+  g_queue_unlink (&tile_lru, &tile->link);
+  tiles_size -= gtk_pixel_cache_tile_get_size (tile);
+
+  if (tile->dirty)
+    cairo_region_destroy (tile->dirty);
+  tile->dirty = NULL;
+  tile->cache = NULL;
+
+  if (n_pooled_tiles < MAX_POOLED_TILES)
+    {
+      tile_pool = g_slist_prepend (tile_pool, tile);
+      n_pooled_tiles++;
+    }
+  else
+    gtk_pixel_cache_tile_destroy (tile);
+
+  /* Nothing is cached anymore, no need to keep the scratch surface */
+  if (g_queue_is_empty (&tile_lru))
+    gtk_pixel_cache_drop_scratch ();
+}
+
+static GtkPixelCacheTile *
+gtk_pixel_cache_tile_new (GtkPixelCache   *cache,
+                          GdkWindow       *window,
+                          cairo_content_t  content,
+                          int              x,
+                          int              y)
+{
+  GtkPixelCacheTile *tile = NULL;
+  cairo_rectangle_int_t r;
+  GSList *l, *next;
+
+  for (l = tile_pool; l; l = next)
+    {
+      GtkPixelCacheTile *pooled = l->data;
+
+      next = l->next;
+
+      /* Surfaces of closed displays are of no use anymore */
+      if (gdk_display_is_closed (gdk_screen_get_display (pooled->screen)))
+        {
+          tile_pool = g_slist_delete_link (tile_pool, l);
+          n_pooled_tiles--;
+          gtk_pixel_cache_tile_destroy (pooled);
+          continue;
+        }
+
+      if (gtk_pixel_cache_surface_matches (pooled->surface, pooled->screen,
+                                           pooled->visual, pooled->scale,
+                                           window, content))
+        {
+          tile = pooled;
+          tile_pool = g_slist_delete_link (tile_pool, l);
+          n_pooled_tiles--;
+          break;
+        }
+    }
+
+  if (tile == NULL)
+    {
+      tile = g_slice_new0 (GtkPixelCacheTile);
+      tile->surface = gdk_window_create_similar_surface (window, content,
+                                                         TILE_SIZE, TILE_SIZE);
+      tile->screen = g_object_ref (gdk_window_get_screen (window));
+      tile->visual = gdk_window_get_visual (window);
+      tile->scale = gdk_window_get_scale_factor (window);
+      tile->link.data = tile;
+    }
+
+  tile->cache = cache;
+  tile->x = x;
+  tile->y = y;
+  tile->key = gtk_pixel_cache_tile_key (x, y);
+
+  r.x = 0;
+  r.y = 0;
+  r.width = TILE_SIZE;
+  r.height = TILE_SIZE;
+  tile->dirty = cairo_region_create_rectangle (&r);
+
+  g_queue_push_head_link (&tile_lru, &tile->link);
+  tiles_size += gtk_pixel_cache_tile_get_size (tile);
+
+  g_hash_table_insert (cache->tiles, &tile->key, tile);
+
+  return tile;
+}
+
+static void
+gtk_pixel_cache_tile_get_rect (GtkPixelCacheTile     *tile,
+                               cairo_rectangle_int_t *rect)
+{
+  rect->x = tile->x;
+  rect->y = tile->y;
+  rect->width = TILE_SIZE;
+  rect->height = TILE_SIZE;
+}
+
 GtkPixelCache *
 _gtk_pixel_cache_new ()
 {
   GtkPixelCache *cache;
 
   cache = g_new0 (GtkPixelCache, 1);
+  cache->tiles = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                        NULL, (GDestroyNotify) gtk_pixel_cache_tile_free);
   cache->extra_width = DEFAULT_EXTRA_SIZE;
   cache->extra_height = DEFAULT_EXTRA_SIZE;
 
@@ -76,21 +267,16 @@ _gtk_pixel_cache_free (GtkPixelCache *cache)
     return;
 
   if (cache->timeout_tag ||
-      cache->surface ||
-      cache->surface_dirty)
+      g_hash_table_size (cache->tiles) > 0)
     {
-      g_warning ("pixel cache freed that wasn't unmapped: tag %u surface %p sirty %p",
-                 cache->timeout_tag, cache->surface, cache->surface_dirty);
+      g_warning ("pixel cache freed that wasn't unmapped: tag %u tiles %u",
+                 cache->timeout_tag, g_hash_table_size (cache->tiles));
     }
 
   if (cache->timeout_tag)
     g_source_remove (cache->timeout_tag);
 
-  if (cache->surface != NULL)
-    cairo_surface_destroy (cache->surface);
-
-  if (cache->surface_dirty != NULL)
-    cairo_region_destroy (cache->surface_dirty);
+  g_hash_table_unref (cache->tiles);
 
   g_clear_object (&cache->style_context);
 
@@ -131,68 +317,136 @@ void
 _gtk_pixel_cache_invalidate (GtkPixelCache  *cache,
                              cairo_region_t *region)
 {
+  GHashTableIter iter;
+  GtkPixelCacheTile *tile;
   cairo_rectangle_int_t r;
-  cairo_region_t *free_region = NULL;
+  cairo_region_t *tile_region;
 
-  if (cache->surface == NULL ||
-      (region != NULL && cairo_region_is_empty (region)))
+  if (region != NULL && cairo_region_is_empty (region))
     return;
 
-  if (region == NULL)
+  g_hash_table_iter_init (&iter, cache->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
     {
-      r.x = cache->surface_x;
-      r.y = cache->surface_y;
-      r.width = cache->surface_w;
-      r.height = cache->surface_h;
+      gtk_pixel_cache_tile_get_rect (tile, &r);
+
+      if (region != NULL &&
+          cairo_region_contains_rectangle (region, &r) == CAIRO_REGION_OVERLAP_OUT)
+        continue;
+
+      if (region == NULL ||
+          cairo_region_contains_rectangle (region, &r) == CAIRO_REGION_OVERLAP_IN)
+        {
+          if (tile->dirty)
+            cairo_region_destroy (tile->dirty);
+          r.x = 0;
+          r.y = 0;
+          tile->dirty = cairo_region_create_rectangle (&r);
+          continue;
+        }
+
+      tile_region = cairo_region_copy (region);
+      cairo_region_intersect_rectangle (tile_region, &r);
+      cairo_region_translate (tile_region, -tile->x, -tile->y);
 
-      free_region = region =
-        cairo_region_create_rectangle (&r);
+      if (tile->dirty == NULL)
+        tile->dirty = tile_region;
+      else
+        {
+          cairo_region_union (tile->dirty, tile_region);
+          cairo_region_destroy (tile_region);
+        }
     }
+}
 
-  if (cache->surface_dirty == NULL)
+static int
+tile_floor (int x)
+{
+  if (x >= 0)
+    return x / TILE_SIZE * TILE_SIZE;
+  else
+    return - ((- x - 1) / TILE_SIZE + 1) * TILE_SIZE;
+}
+
+/* The part of the canvas we keep: the view, plus some of the
+   extra size on each side the canvas can be scrolled to. */
+static void
+gtk_pixel_cache_get_cached_area (GtkPixelCache         *cache,
+                                 cairo_rectangle_int_t *view_rect,
+                                 cairo_rectangle_int_t *canvas_rect,
+                                 cairo_rectangle_int_t *area)
+{
+  int x1, y1, x2, y2;
+
+  /* Position of view inside canvas */
+  x1 = -canvas_rect->x;
+  y1 = -canvas_rect->y;
+  x2 = x1 + view_rect->width;
+  y2 = y1 + view_rect->height;
+
+  if (canvas_rect->width > view_rect->width)
     {
-      cache->surface_dirty = cairo_region_copy (region);
-      cairo_region_translate (cache->surface_dirty,
-                              -cache->surface_x,
-                              -cache->surface_y);
+      x1 = MIN (x1, MAX (x1 - (int) cache->extra_width / 2, 0));
+      x2 = MAX (x2, MIN (x2 + (int) cache->extra_width / 2, canvas_rect->width));
     }
-  else
+
+  if (canvas_rect->height > view_rect->height)
     {
-      cairo_region_translate (region,
-                              -cache->surface_x,
-                              -cache->surface_y);
-      cairo_region_union (cache->surface_dirty, region);
-      cairo_region_translate (region,
-                              cache->surface_x,
-                              cache->surface_y);
+      y1 = MIN (y1, MAX (y1 - (int) cache->extra_height / 2, 0));
+      y2 = MAX (y2, MIN (y2 + (int) cache->extra_height / 2, canvas_rect->height));
     }
 
-  if (free_region)
-    cairo_region_destroy (free_region);
+  area->x = x1;
+  area->y = y1;
+  area->width = x2 - x1;
+  area->height = y2 - y1;
+}
 
-  r.x = 0;
-  r.y = 0;
-  r.width = cache->surface_w;
-  r.height = cache->surface_h;
+static gboolean
+tile_is_outside_area (gpointer key,
+                      gpointer value,
+                      gpointer user_data)
+{
+  GtkPixelCacheTile *tile = value;
+  cairo_rectangle_int_t *area = user_data;
 
-  cairo_region_intersect_rectangle (cache->surface_dirty, &r);
+  return tile->x + TILE_SIZE <= area->x ||
+         tile->x >= area->x + area->width ||
+         tile->y + TILE_SIZE <= area->y ||
+         tile->y >= area->y + area->height;
 }
 
-static void
-_gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
-                                           GdkWindow             *window,
-                                           cairo_rectangle_int_t *view_rect,
-                                           cairo_rectangle_int_t *canvas_rect)
+static gboolean
+gtk_pixel_cache_should_cache (GtkPixelCache         *cache,
+                              cairo_rectangle_int_t *view_rect,
+                              cairo_rectangle_int_t *canvas_rect)
 {
-  cairo_rectangle_int_t rect;
-  int surface_w, surface_h;
-  cairo_content_t content;
-
 #ifdef G_ENABLE_DEBUG
   if (GTK_DEBUG_CHECK (NO_PIXEL_CACHE))
-    return;
+    return FALSE;
 #endif
 
+  /* Don't cache if view >= canvas, as we won't
+   * be scrolling then anyway, unless the widget requested it.
+   */
+  return cache->always_cache ||
+         view_rect->width < canvas_rect->width ||
+         view_rect->height < canvas_rect->height;
+}
+
+static void
+gtk_pixel_cache_update_tiles (GtkPixelCache         *cache,
+                              GdkWindow             *window,
+                              cairo_rectangle_int_t *view_rect,
+                              cairo_rectangle_int_t *canvas_rect)
+{
+  cairo_rectangle_int_t area;
+  cairo_content_t content;
+  GHashTableIter iter;
+  GtkPixelCacheTile *tile;
+  gint64 key;
+  int x, y;
+
   content = cache->content;
   if (!content)
     {
@@ -202,190 +456,190 @@ _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
         content = CAIRO_CONTENT_COLOR;
     }
 
-  surface_w = view_rect->width;
-  if (canvas_rect->width > surface_w)
-    surface_w = MIN (surface_w + cache->extra_width, canvas_rect->width);
-
-  surface_h = view_rect->height;
-  if (canvas_rect->height > surface_h)
-    surface_h = MIN (surface_h + cache->extra_height, canvas_rect->height);
-
-  /* If current surface can't fit view_rect or is too large, kill it */
-  if (cache->surface != NULL &&
-      (cairo_surface_get_content (cache->surface) != content ||
-       cache->surface_w < MAX(view_rect->width, surface_w * ALLOW_SMALLER_SIZE_FACTOR) ||
-       cache->surface_w > surface_w * ALLOW_LARGER_SIZE_FACTOR ||
-       cache->surface_h < MAX(view_rect->height, surface_h * ALLOW_SMALLER_SIZE_FACTOR) ||
-       cache->surface_h > surface_h * ALLOW_LARGER_SIZE_FACTOR ||
-       cache->surface_scale != gdk_window_get_scale_factor (window)))
+  /* If the tiles don't fit the window anymore, kill them */
+  g_hash_table_iter_init (&iter, cache->tiles);
+  if (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile) &&
+      !gtk_pixel_cache_surface_matches (tile->surface, tile->screen,
+                                        tile->visual, tile->scale,
+                                        window, content))
+    g_hash_table_remove_all (cache->tiles);
+
+  /* Drop the tiles that were scrolled away, we don't get
+   * invalidations for them anymore */
+  gtk_pixel_cache_get_cached_area (cache, view_rect, canvas_rect, &area);
+  g_hash_table_foreach_remove (cache->tiles, tile_is_outside_area, &area);
+
+  for (y = tile_floor (area.y); y < area.y + area.height; y += TILE_SIZE)
     {
-      cairo_surface_destroy (cache->surface);
-      cache->surface = NULL;
-      if (cache->surface_dirty)
-        cairo_region_destroy (cache->surface_dirty);
-      cache->surface_dirty = NULL;
+      for (x = tile_floor (area.x); x < area.x + area.width; x += TILE_SIZE)
+        {
+          key = gtk_pixel_cache_tile_key (x, y);
+          tile = g_hash_table_lookup (cache->tiles, &key);
+          if (tile == NULL)
+            tile = gtk_pixel_cache_tile_new (cache, window, content, x, y);
+          else
+            {
+              g_queue_unlink (&tile_lru, &tile->link);
+              g_queue_push_head_link (&tile_lru, &tile->link);
+            }
+
+          tile->serial = draw_serial;
+        }
     }
 
-  /* Don't allocate a surface if view >= canvas, as we won't
-   * be scrolling then anyway, unless the widget requested it.
-   */
-  if (cache->surface == NULL &&
-      (cache->always_cache ||
-       (view_rect->width < canvas_rect->width ||
-        view_rect->height < canvas_rect->height)))
+  /* Now make room for them */
+  while (tiles_size > MAX_TILES_SIZE)
+    {
+      tile = g_queue_peek_tail (&tile_lru);
+      if (tile == NULL || tile->serial == draw_serial)
+        break;
+
+      g_hash_table_remove (tile->cache->tiles, &tile->key);
+    }
+}
+
+/* Returns a surface of at least width x height similar to window,
+   reusing the one of the previous frame when it is big enough */
+static cairo_surface_t *
+gtk_pixel_cache_get_scratch (GdkWindow       *window,
+                             cairo_content_t  content,
+                             int              width,
+                             int              height)
+{
+  if (scratch_surface != NULL &&
+      (!gtk_pixel_cache_surface_matches (scratch_surface, scratch_screen,
+                                         scratch_visual, scratch_scale,
+                                         window, content) ||
+       scratch_width < width ||
+       scratch_height < height))
     {
-      cache->surface_x = -canvas_rect->x;
-      cache->surface_y = -canvas_rect->y;
-      cache->surface_w = surface_w;
-      cache->surface_h = surface_h;
-      cache->surface_scale = gdk_window_get_scale_factor (window);
-
-      cache->surface =
-        gdk_window_create_similar_surface (window, content,
-                                           surface_w, surface_h);
-      rect.x = 0;
-      rect.y = 0;
-      rect.width = surface_w;
-      rect.height = surface_h;
-      cache->surface_dirty =
-        cairo_region_create_rectangle (&rect);
+      width = MAX (width, scratch_width);
+      height = MAX (height, scratch_height);
+      gtk_pixel_cache_drop_scratch ();
     }
+
+  if (scratch_surface == NULL)
+    {
+      scratch_width = (width + SCRATCH_STEP - 1) / SCRATCH_STEP * SCRATCH_STEP;
+      scratch_height = (height + SCRATCH_STEP - 1) / SCRATCH_STEP * SCRATCH_STEP;
+      scratch_surface = gdk_window_create_similar_surface (window, content,
+                                                           scratch_width,
+                                                           scratch_height);
+      scratch_screen = g_object_ref (gdk_window_get_screen (window));
+      scratch_visual = gdk_window_get_visual (window);
+      scratch_scale = gdk_window_get_scale_factor (window);
+    }
+
+  return scratch_surface;
 }
 
+/* The dirty parts of all tiles are drawn in one go into a scratch
+   surface covering them, and copied from there into the tiles, so
+   that the widget is only drawn once per frame. */
 static void
-_gtk_pixel_cache_set_position (GtkPixelCache         *cache,
+gtk_pixel_cache_repaint_tiles (GtkPixelCache         *cache,
+                               GdkWindow             *window,
+                               GtkPixelCacheDrawFunc  draw,
                                cairo_rectangle_int_t *view_rect,
-                               cairo_rectangle_int_t *canvas_rect)
+                               cairo_rectangle_int_t *canvas_rect,
+                               gpointer               user_data)
 {
-  cairo_rectangle_int_t r, view_pos;
-  cairo_region_t *copy_region;
-  int new_surf_x, new_surf_y;
+  GHashTableIter iter;
+  GtkPixelCacheTile *tile;
+  cairo_region_t *region_dirty, *tile_region;
+  cairo_rectangle_int_t extents;
+  cairo_surface_t *surface;
+  cairo_content_t content;
   cairo_t *backing_cr;
 
-  if (cache->surface == NULL)
-    return;
+  region_dirty = cairo_region_create ();
+  content = CAIRO_CONTENT_COLOR_ALPHA;
 
-  /* Position of view inside canvas */
-  view_pos.x = -canvas_rect->x;
-  view_pos.y = -canvas_rect->y;
-  view_pos.width = view_rect->width;
-  view_pos.height = view_rect->height;
-
-  /* Reposition so all is visible */
-  if (view_pos.x < cache->surface_x ||
-      view_pos.x + view_pos.width > cache->surface_x + cache->surface_w ||
-      view_pos.y < cache->surface_y ||
-      view_pos.y + view_pos.height > cache->surface_y + cache->surface_h)
+  g_hash_table_iter_init (&iter, cache->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
     {
-      new_surf_x = cache->surface_x;
-      if (view_pos.x < cache->surface_x)
-        new_surf_x = MAX (view_pos.x + view_pos.width - cache->surface_w, 0);
-      else if (view_pos.x + view_pos.width >
-               cache->surface_x + cache->surface_w)
-        new_surf_x = MIN (view_pos.x, canvas_rect->width - cache->surface_w);
-
-      new_surf_y = cache->surface_y;
-      if (view_pos.y < cache->surface_y)
-        new_surf_y = MAX (view_pos.y + view_pos.height - cache->surface_h, 0);
-      else if (view_pos.y + view_pos.height >
-               cache->surface_y + cache->surface_h)
-        new_surf_y = MIN (view_pos.y, canvas_rect->height - cache->surface_h);
-
-      r.x = 0;
-      r.y = 0;
-      r.width = cache->surface_w;
-      r.height = cache->surface_h;
-      copy_region = cairo_region_create_rectangle (&r);
-
-      if (cache->surface_dirty)
-        {
-          cairo_region_subtract (copy_region, cache->surface_dirty);
-          cairo_region_destroy (cache->surface_dirty);
-          cache->surface_dirty = NULL;
-        }
+      if (tile->dirty == NULL)
+        continue;
+
+      tile_region = cairo_region_copy (tile->dirty);
+      cairo_region_translate (tile_region, tile->x, tile->y);
+      cairo_region_union (region_dirty, tile_region);
+      cairo_region_destroy (tile_region);
+      content = cairo_surface_get_content (tile->surface);
+    }
 
-      cairo_region_translate (copy_region,
-                              cache->surface_x - new_surf_x,
-                              cache->surface_y - new_surf_y);
-      cairo_region_intersect_rectangle (copy_region, &r);
-
-      backing_cr = cairo_create (cache->surface);
-      gdk_cairo_region (backing_cr, copy_region);
-      cairo_set_operator (backing_cr, CAIRO_OPERATOR_SOURCE);
-      cairo_clip (backing_cr);
-      cairo_push_group (backing_cr);
-      cairo_set_source_surface (backing_cr, cache->surface,
-                                cache->surface_x - new_surf_x,
-                                cache->surface_y - new_surf_y);
-      cairo_paint (backing_cr);
-      cairo_pop_group_to_source (backing_cr);
-      cairo_paint (backing_cr);
-      cairo_destroy (backing_cr);
+  if (cairo_region_is_empty (region_dirty))
+    {
+      cairo_region_destroy (region_dirty);
+      return;
+    }
 
-      cache->surface_x = new_surf_x;
-      cache->surface_y = new_surf_y;
+  cairo_region_get_extents (region_dirty, &extents);
+  surface = gtk_pixel_cache_get_scratch (window, content,
+                                         extents.width, extents.height);
 
-      cairo_region_xor_rectangle (copy_region, &r);
-      cache->surface_dirty = copy_region;
-    }
-}
+  backing_cr = cairo_create (surface);
+  cairo_translate (backing_cr, -extents.x, -extents.y);
+  gdk_cairo_region (backing_cr, region_dirty);
+  cairo_clip (backing_cr);
 
-static void
-_gtk_pixel_cache_repaint (GtkPixelCache         *cache,
-                          GtkPixelCacheDrawFunc  draw,
-                          cairo_rectangle_int_t *view_rect,
-                          cairo_rectangle_int_t *canvas_rect,
-                          gpointer               user_data)
-{
-  cairo_t *backing_cr;
-  cairo_region_t *region_dirty = cache->surface_dirty;
-  cache->surface_dirty = NULL;
+  /* Clear what the previous frame left there */
+  cairo_save (backing_cr);
+  cairo_set_operator (backing_cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (backing_cr);
+  cairo_restore (backing_cr);
+
+  cairo_translate (backing_cr,
+                   -canvas_rect->x - view_rect->x,
+                   -canvas_rect->y - view_rect->y);
 
-  if (cache->surface &&
-      region_dirty &&
-      !cairo_region_is_empty (region_dirty))
+  cairo_save (backing_cr);
+  draw (backing_cr, user_data);
+  cairo_restore (backing_cr);
+
+#ifdef G_ENABLE_DEBUG
+  if (GTK_DEBUG_CHECK (PIXEL_CACHE))
     {
-      backing_cr = cairo_create (cache->surface);
-      gdk_cairo_region (backing_cr, region_dirty);
-      cairo_clip (backing_cr);
-      cairo_translate (backing_cr,
-                       -cache->surface_x - canvas_rect->x - view_rect->x,
-                       -cache->surface_y - canvas_rect->y - view_rect->y);
-
-      cairo_save (backing_cr);
-      cairo_set_source_rgba (backing_cr,
-                             0.0, 0, 0, 0.0);
-      cairo_set_operator (backing_cr, CAIRO_OPERATOR_SOURCE);
+      GdkRGBA colors[] = {
+        { 1, 0, 0, 0.08},
+        { 0, 1, 0, 0.08},
+        { 0, 0, 1, 0.08},
+        { 1, 0, 1, 0.08},
+        { 1, 1, 0, 0.08},
+        { 0, 1, 1, 0.08},
+      };
+      static int current_color = 0;
+
+      gdk_cairo_set_source_rgba (backing_cr, &colors[(current_color++) % G_N_ELEMENTS (colors)]);
       cairo_paint (backing_cr);
-      cairo_restore (backing_cr);
+    }
+#endif
 
-      cairo_save (backing_cr);
-      draw (backing_cr, user_data);
-      cairo_restore (backing_cr);
+  cairo_destroy (backing_cr);
+  cairo_region_destroy (region_dirty);
 
-#ifdef G_ENABLE_DEBUG
-      if (GTK_DEBUG_CHECK (PIXEL_CACHE))
+  g_hash_table_iter_init (&iter, cache->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+    {
+      if (tile->dirty == NULL)
+        continue;
+
+      if (!cairo_region_is_empty (tile->dirty))
         {
-          GdkRGBA colors[] = {
-            { 1, 0, 0, 0.08},
-            { 0, 1, 0, 0.08},
-            { 0, 0, 1, 0.08},
-            { 1, 0, 1, 0.08},
-            { 1, 1, 0, 0.08},
-            { 0, 1, 1, 0.08},
-          };
-          static int current_color = 0;
-
-          gdk_cairo_set_source_rgba (backing_cr, &colors[(current_color++) % G_N_ELEMENTS (colors)]);
+          backing_cr = cairo_create (tile->surface);
+          gdk_cairo_region (backing_cr, tile->dirty);
+          cairo_clip (backing_cr);
+          cairo_set_operator (backing_cr, CAIRO_OPERATOR_SOURCE);
+          cairo_set_source_surface (backing_cr, surface,
+                                    extents.x - tile->x,
+                                    extents.y - tile->y);
           cairo_paint (backing_cr);
+          cairo_destroy (backing_cr);
         }
-#endif
 
-      cairo_destroy (backing_cr);
+      cairo_region_destroy (tile->dirty);
+      tile->dirty = NULL;
     }
-
-  if (region_dirty)
-    cairo_region_destroy (region_dirty);
 }
 
 static void
@@ -397,14 +651,7 @@ gtk_pixel_cache_blow_cache (GtkPixelCache *cache)
       cache->timeout_tag = 0;
     }
 
-  if (cache->surface)
-    {
-      cairo_surface_destroy (cache->surface);
-      cache->surface = NULL;
-      if (cache->surface_dirty)
-        cairo_region_destroy (cache->surface_dirty);
-      cache->surface_dirty = NULL;
-    }
+  g_hash_table_remove_all (cache->tiles);
 }
 
 static gboolean
@@ -442,6 +689,11 @@ _gtk_pixel_cache_draw (GtkPixelCache         *cache,
                        GtkPixelCacheDrawFunc  draw,
                        gpointer               user_data)
 {
+  GHashTableIter iter;
+  GtkPixelCacheTile *tile;
+  cairo_rectangle_int_t r;
+  gboolean use_tiles;
+
   if (cache->timeout_tag)
     g_source_remove (cache->timeout_tag);
 
@@ -449,22 +701,45 @@ _gtk_pixel_cache_draw (GtkPixelCache         *cache,
                                               blow_cache_cb, cache);
   g_source_set_name_by_id (cache->timeout_tag, "[gtk+] blow_cache_cb");
 
-  _gtk_pixel_cache_create_surface_if_needed (cache, window,
-                                             view_rect, canvas_rect);
-  _gtk_pixel_cache_set_position (cache, view_rect, canvas_rect);
-  _gtk_pixel_cache_repaint (cache, draw, view_rect, canvas_rect, user_data);
+  draw_serial++;
+
+  if (gtk_pixel_cache_should_cache (cache, view_rect, canvas_rect))
+    gtk_pixel_cache_update_tiles (cache, window, view_rect, canvas_rect);
+  else
+    g_hash_table_remove_all (cache->tiles);
+
+  use_tiles = g_hash_table_size (cache->tiles) > 0 && context_is_unscaled (cr);
+
+  gtk_pixel_cache_repaint_tiles (cache, window, draw, view_rect, canvas_rect, user_data);
 
-  if (cache->surface && context_is_unscaled (cr) &&
+  g_hash_table_iter_init (&iter, cache->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+    {
       /* Don't use backing surface if rendering elsewhere */
-      cairo_surface_get_type (cache->surface) == cairo_surface_get_type (cairo_get_target (cr)))
+      if (cairo_surface_get_type (tile->surface) != cairo_surface_get_type (cairo_get_target (cr)))
+        use_tiles = FALSE;
+    }
+
+  if (use_tiles)
     {
       cairo_save (cr);
-      cairo_set_source_surface (cr, cache->surface,
-                                cache->surface_x + view_rect->x + canvas_rect->x,
-                                cache->surface_y + view_rect->y + canvas_rect->y);
-      cairo_rectangle (cr, view_rect->x, view_rect->y,
-                       view_rect->width, view_rect->height);
-      cairo_fill (cr);
+
+      g_hash_table_iter_init (&iter, cache->tiles);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+        {
+          gtk_pixel_cache_tile_get_rect (tile, &r);
+          r.x += view_rect->x + canvas_rect->x;
+          r.y += view_rect->y + canvas_rect->y;
+          if (!gdk_rectangle_intersect (&r, view_rect, &r))
+            continue;
+
+          cairo_set_source_surface (cr, tile->surface,
+                                    tile->x + view_rect->x + canvas_rect->x,
+                                    tile->y + view_rect->y + canvas_rect->y);
+          gdk_cairo_rectangle (cr, &r);
+          cairo_fill (cr);
+        }
+
       cairo_restore (cr);
     }
   else
@@ -338,12 +338,10 @@ _cairo_ellipsis_negative (cairo_t *cr,
   cairo_set_matrix (cr, &save);
 }
 
-void
-_gtk_rounded_box_path (const GtkRoundedBox *box,
-                       cairo_t             *cr)
+static void
+gtk_rounded_box_build_path (const GtkRoundedBox *box,
+                            cairo_t             *cr)
 {
-  cairo_new_sub_path (cr);
-
   _cairo_ellipsis (cr,
                    box->box.x + box->corner[GTK_CSS_TOP_LEFT].horizontal,
                    box->box.y + box->corner[GTK_CSS_TOP_LEFT].vertical,
@@ -372,6 +370,154 @@ _gtk_rounded_box_path (const GtkRoundedBox *box,
   cairo_close_path (cr);
 }
 
+/* Complete paths of rounded boxes, at 0,0. Widgets are drawn with
+ * the same few sizes and radii over and over again, so this saves
+ * building them from the arcs every time. The least recently used
+ * ones are dropped when there are more than MAX_CACHED_PATHS.
+ */
+#define MAX_CACHED_PATHS 128
+
+typedef struct {
+  GtkRoundedBox box;
+  cairo_path_t *path;
+  GList link;
+} CachedPath;
+
+static GHashTable *path_cache = NULL;
+static GQueue path_cache_lru = G_QUEUE_INIT;
+
+static guint
+cached_path_hash (gconstpointer data)
+{
+  const GtkRoundedBox *box = data;
+  guint hash;
+  int i;
+
+  hash = g_double_hash (&box->box.width) ^ (g_double_hash (&box->box.height) << 8);
+  for (i = 0; i < 4; i++)
+    hash = hash * 31 + g_double_hash (&box->corner[i].horizontal) + g_double_hash (&box->corner[i].vertical);
+
+  return hash;
+}
+
+static gboolean
+cached_path_equal (gconstpointer data1,
+                   gconstpointer data2)
+{
+  const GtkRoundedBox *box1 = data1;
+  const GtkRoundedBox *box2 = data2;
+  int i;
+
+  if (box1->box.width != box2->box.width ||
+      box1->box.height != box2->box.height)
+    return FALSE;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (box1->corner[i].horizontal != box2->corner[i].horizontal ||
+          box1->corner[i].vertical != box2->corner[i].vertical)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+cached_path_free (CachedPath *cached)
+{
+  g_queue_unlink (&path_cache_lru, &cached->link);
+  cairo_path_destroy (cached->path);
+  g_slice_free (CachedPath, cached);
+}
+
+static cairo_path_t *
+gtk_rounded_box_get_path (const GtkRoundedBox *box)
+{
+  CachedPath *cached;
+  GtkRoundedBox key;
+
+  if (path_cache == NULL)
+    path_cache = g_hash_table_new_full (cached_path_hash,
+                                        cached_path_equal,
+                                        NULL, (GDestroyNotify) cached_path_free);
+
+  key = *box;
+  key.box.x = 0;
+  key.box.y = 0;
+
+  cached = g_hash_table_lookup (path_cache, &key);
+  if (cached)
+    {
+      g_queue_unlink (&path_cache_lru, &cached->link);
+      g_queue_push_head_link (&path_cache_lru, &cached->link);
+    }
+  else
+    {
+      cairo_surface_t *surface;
+      cairo_t *tmp;
+
+      if (path_cache_lru.length >= MAX_CACHED_PATHS)
+        {
+          CachedPath *oldest = g_queue_peek_tail (&path_cache_lru);
+          g_hash_table_remove (path_cache, &oldest->box);
+        }
+
+      surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1, 1);
+      tmp = cairo_create (surface);
+
+      cached = g_slice_new (CachedPath);
+      cached->box = key;
+      gtk_rounded_box_build_path (&cached->box, tmp);
+      cached->path = cairo_copy_path (tmp);
+      cached->link.data = cached;
+      cached->link.prev = cached->link.next = NULL;
+
+      cairo_destroy (tmp);
+      cairo_surface_destroy (surface);
+
+      g_hash_table_insert (path_cache, &cached->box, cached);
+      g_queue_push_head_link (&path_cache_lru, &cached->link);
+    }
+
+  return cached->path;
+}
+
+static gboolean
+gtk_rounded_box_is_rectangle (const GtkRoundedBox *box)
+{
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (box->corner[i].horizontal > 0 && box->corner[i].vertical > 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+_gtk_rounded_box_path (const GtkRoundedBox *box,
+                       cairo_t             *cr)
+{
+  cairo_matrix_t save;
+
+  cairo_new_sub_path (cr);
+
+  if (gtk_rounded_box_is_rectangle (box))
+    {
+      cairo_rectangle (cr,
+                       box->box.x, box->box.y,
+                       box->box.width, box->box.height);
+      return;
+    }
+
+  cairo_get_matrix (cr, &save);
+  cairo_translate (cr, box->box.x, box->box.y);
+  cairo_append_path (cr, gtk_rounded_box_get_path (box));
+  cairo_set_matrix (cr, &save);
+}
+
 double
 _gtk_rounded_box_guess_length (const GtkRoundedBox *box,
                                GtkCssSide           side)
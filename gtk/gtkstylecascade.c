@@ -19,6 +19,7 @@
 
 #include "gtkstylecascadeprivate.h"
 
+#include "gtkcssdependenciesprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstyleproviderprivate.h"
 #include "gtkprivate.h"
@@ -279,6 +280,8 @@ style_provider_data_clear (gpointer data_)
   GtkStyleProviderData *data = data_;
 
   g_signal_handler_disconnect (data->provider, data->changed_signal_id);
+  if (!GTK_IS_STYLE_PROVIDER_PRIVATE (data->provider))
+    gtk_css_dependencies_remove_unknown ();
   g_object_unref (data->provider);
 }
 
@@ -314,14 +317,14 @@ _gtk_style_cascade_set_parent (GtkStyleCascade *cascade,
       g_object_ref (parent);
       g_signal_connect_swapped (parent,
                                 "-gtk-private-changed",
-                                G_CALLBACK (_gtk_style_provider_private_changed),
+                                G_CALLBACK (_gtk_style_provider_private_changed_selectors),
                                 cascade);
     }
 
   if (cascade->parent)
     {
       g_signal_handlers_disconnect_by_func (cascade->parent, 
-                                            _gtk_style_provider_private_changed,
+                                            _gtk_style_provider_private_changed_selectors,
                                             cascade);
       g_object_unref (cascade->parent);
     }
@@ -345,8 +348,11 @@ _gtk_style_cascade_add_provider (GtkStyleCascade  *cascade,
   data.priority = priority;
   data.changed_signal_id = g_signal_connect_swapped (provider,
                                                      "-gtk-private-changed",
-                                                     G_CALLBACK (_gtk_style_provider_private_changed),
+                                                     G_CALLBACK (_gtk_style_provider_private_changed_selectors),
                                                      cascade);
+  /* we can't know what its style properties depend on */
+  if (!GTK_IS_STYLE_PROVIDER_PRIVATE (provider))
+    gtk_css_dependencies_add_unknown ();
 
   /* ensure it gets removed first */
   _gtk_style_cascade_remove_provider (cascade, provider);
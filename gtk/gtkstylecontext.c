@@ -283,9 +283,13 @@ gtk_style_context_pop_style_node (GtkStyleContext *context)
 
 static void
 gtk_style_context_cascade_changed (GtkStyleCascade *cascade,
+                                   GPtrArray       *keys,
                                    GtkStyleContext *context)
 {
-  gtk_css_node_invalidate_style_provider (gtk_style_context_get_root (context));
+  if (keys)
+    gtk_css_node_invalidate_changed_selectors (gtk_style_context_get_root (context), keys);
+  else
+    gtk_css_node_invalidate_style_provider (gtk_style_context_get_root (context));
 }
 
 static void
@@ -318,7 +322,7 @@ gtk_style_context_set_cascade (GtkStyleContext *context,
   priv->cascade = cascade;
 
   if (cascade && priv->cssnode != NULL)
-    gtk_style_context_cascade_changed (cascade, context);
+    gtk_style_context_cascade_changed (cascade, NULL, context);
 }
 
 static void
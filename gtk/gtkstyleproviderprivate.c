@@ -19,6 +19,8 @@
 
 #include "gtkstyleproviderprivate.h"
 
+#include "gtkcssnodeprivate.h"
+#include "gtkcssnodestylecacheprivate.h"
 #include "gtkintl.h"
 #include "gtkstyleprovider.h"
 #include "gtkprivate.h"
@@ -40,8 +42,8 @@ _gtk_style_provider_private_default_init (GtkStyleProviderPrivateInterface *ifac
                                    G_SIGNAL_RUN_LAST,
                                    G_STRUCT_OFFSET (GtkStyleProviderPrivateInterface, changed),
                                    NULL, NULL,
-                                   g_cclosure_marshal_VOID__VOID,
-                                   G_TYPE_NONE, 0);
+                                   g_cclosure_marshal_VOID__POINTER,
+                                   G_TYPE_NONE, 1, G_TYPE_POINTER);
 
 }
 
@@ -107,10 +109,31 @@ _gtk_style_provider_private_lookup (GtkStyleProviderPrivate *provider,
 
 void
 _gtk_style_provider_private_changed (GtkStyleProviderPrivate *provider)
+{
+  _gtk_style_provider_private_changed_selectors (provider, NULL);
+}
+
+/**
+ * _gtk_style_provider_private_changed_selectors:
+ * @provider: the provider that changed
+ * @keys: (element-type GtkCssSelectorKey) (allow-none): keys of all
+ *     selectors whose rules changed, or %NULL
+ *
+ * Like _gtk_style_provider_private_changed(), but only elements matching
+ * one of @keys can have a different style now. The keys are passed on
+ * to the handlers of the changed signal.
+ **/
+void
+_gtk_style_provider_private_changed_selectors (GtkStyleProviderPrivate *provider,
+                                               GPtrArray               *keys)
 {
   gtk_internal_return_if_fail (GTK_IS_STYLE_PROVIDER_PRIVATE (provider));
 
-  g_signal_emit (provider, signals[CHANGED], 0);
+  /* Cached styles and lookups might have been done with the old contents */
+  gtk_css_node_style_cache_clear ();
+  gtk_css_node_invalidate_prefetched_styles ();
+
+  g_signal_emit (provider, signals[CHANGED], 0, keys);
 }
 
 GtkSettings *
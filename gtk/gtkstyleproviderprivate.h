@@ -53,7 +53,8 @@ struct _GtkStyleProviderPrivateInterface
                                                  GtkCssSection           *section,
                                                  const GError            *error);
   /* signal */
-  void                  (* changed)             (GtkStyleProviderPrivate *provider);
+  void                  (* changed)             (GtkStyleProviderPrivate *provider,
+                                                 GPtrArray               *keys);
 };
 
 GType                   _gtk_style_provider_private_get_type     (void) G_GNUC_CONST;
@@ -70,6 +71,9 @@ void                    _gtk_style_provider_private_lookup       (GtkStyleProvid
                                                                   GtkCssChange            *out_change);
 
 void                    _gtk_style_provider_private_changed      (GtkStyleProviderPrivate *provider);
+void                    _gtk_style_provider_private_changed_selectors
+                                                                 (GtkStyleProviderPrivate *provider,
+                                                                  GPtrArray               *keys);
 
 void                    _gtk_style_provider_private_emit_error   (GtkStyleProviderPrivate *provider,
                                                                   GtkCssSection           *section,
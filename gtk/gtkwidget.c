@@ -729,6 +729,9 @@ static void		gtk_widget_accessible_interface_init	(AtkImplementorIface *iface);
 static AtkObject*	gtk_widget_ref_accessible		(AtkImplementor *implementor);
 static void             gtk_widget_invalidate_widget_windows    (GtkWidget        *widget,
 								 cairo_region_t        *region);
+static void             gtk_widget_invalidate_render_cache      (GtkWidget        *widget);
+static void             gtk_widget_invalidate_child_render_caches (GtkWidget            *widget,
+                                                                   const cairo_region_t *region);
 static GdkScreen *      gtk_widget_get_screen_unchecked         (GtkWidget        *widget);
 static gboolean         gtk_widget_real_can_activate_accel      (GtkWidget *widget,
                                                                  guint      signal_id);
@@ -830,6 +833,7 @@ static gint             GtkWidget_private_offset = 0;
 static gpointer         gtk_widget_parent_class = NULL;
 static guint            widget_signals[LAST_SIGNAL] = { 0 };
 static guint            composite_child_stack = 0;
+static guint            n_render_cached_widgets = 0;
 GtkTextDirection gtk_default_direction = GTK_TEXT_DIR_LTR;
 static GParamSpecPool  *style_property_spec_pool = NULL;
 
@@ -4982,6 +4986,8 @@ gtk_widget_map (GtkWidget *widget)
 
       g_signal_emit (widget, widget_signals[MAP], 0);
 
+      gtk_widget_invalidate_render_cache (widget);
+      gtk_widget_set_opaque_rect (widget, NULL);
       if (!_gtk_widget_get_has_window (widget))
         gdk_window_invalidate_rect (priv->window, &priv->clip, FALSE);
 
@@ -5010,6 +5016,8 @@ gtk_widget_unmap (GtkWidget *widget)
       g_object_ref (widget);
       gtk_widget_push_verify_invariants (widget);
 
+      gtk_widget_invalidate_render_cache (widget);
+      gtk_widget_set_opaque_rect (widget, NULL);
       if (!_gtk_widget_get_has_window (widget))
 	gdk_window_invalidate_rect (priv->window, &priv->clip, FALSE);
       _gtk_tooltip_hide (widget);
@@ -5560,6 +5568,8 @@ gtk_widget_queue_draw_region (GtkWidget            *widget,
 
   g_return_if_fail (GTK_IS_WIDGET (widget));
 
+  gtk_widget_invalidate_render_cache (widget);
+
   if (!_gtk_widget_get_realized (widget))
     return;
 
@@ -5568,6 +5578,8 @@ gtk_widget_queue_draw_region (GtkWidget            *widget,
     if (!_gtk_widget_get_mapped (w))
       return;
 
+  gtk_widget_invalidate_child_render_caches (widget, region);
+
   WIDGET_CLASS (widget)->queue_draw_region (widget, region);
 }
 
@@ -5906,6 +5918,8 @@ gtk_widget_invalidate_widget_windows (GtkWidget      *widget,
       cairo_region_translate (region, -x, -y);
     }
 
+  gtk_widget_invalidate_child_render_caches (widget, region);
+
   gdk_window_invalidate_maybe_recurse (priv->window, region,
 				       invalidate_predicate, widget);
 }
@@ -6124,6 +6138,11 @@ gtk_widget_size_allocate_with_baseline (GtkWidget     *widget,
   position_changed |= (old_clip.x != priv->clip.x ||
                       old_clip.y != priv->clip.y);
 
+  if (size_changed || position_changed || baseline_changed)
+    gtk_widget_invalidate_render_cache (widget);
+  if (size_changed)
+    gtk_widget_set_opaque_rect (widget, NULL);
+
   if (_gtk_widget_get_mapped (widget) && priv->redraw_on_alloc)
     {
       if (!_gtk_widget_get_has_window (widget) && position_changed)
@@ -6940,6 +6959,212 @@ gtk_cairo_should_draw_window (cairo_t *cr,
   return event_window == window;
 }
 
+static void
+gtk_widget_emit_draw (GtkWidget *widget,
+                      cairo_t   *cr)
+{
+  gboolean result;
+
+  /* Drawing the main gadget sets it again */
+  gtk_widget_set_opaque_rect (widget, NULL);
+
+  if (g_signal_has_handler_pending (widget, widget_signals[DRAW], 0, FALSE))
+    {
+      g_signal_emit (widget, widget_signals[DRAW],
+                     0, cr,
+                     &result);
+    }
+  else if (GTK_WIDGET_GET_CLASS (widget)->draw)
+    {
+      cairo_save (cr);
+      GTK_WIDGET_GET_CLASS (widget)->draw (widget, cr);
+      cairo_restore (cr);
+    }
+}
+
+static void
+gtk_widget_drop_render_recording (GtkWidget *widget)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+
+  g_clear_pointer (&priv->render_recording, cairo_surface_destroy);
+  priv->render_recording_window = NULL;
+}
+
+/* Called when the widget or one of its descendants will draw
+ * differently, which all the recordings up to the toplevel
+ * contain. */
+static void
+gtk_widget_invalidate_render_cache (GtkWidget *widget)
+{
+  GtkWidget *w;
+
+  if (n_render_cached_widgets == 0)
+    return;
+
+  for (w = widget; w != NULL; w = w->priv->parent)
+    {
+      if (!w->priv->render_cache)
+        continue;
+
+      w->priv->render_generation++;
+      gtk_widget_drop_render_recording (w);
+    }
+}
+
+typedef struct {
+  GdkWindow *window;
+  const cairo_region_t *region;
+} RenderCacheInvalidation;
+
+/* Whether the clip of @widget intersects @region, which is in the
+ * coordinates of @window. Widgets that aren't inside @window are
+ * assumed to intersect.
+ */
+static gboolean
+gtk_widget_clip_intersects_region (GtkWidget            *widget,
+                                   GdkWindow            *window,
+                                   const cairo_region_t *region)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+  GdkRectangle clip;
+  GdkWindow *w;
+  int x, y;
+
+  /* The clip is in the coordinates of the window the widget
+   * is allocated in */
+  w = priv->window;
+  if (_gtk_widget_get_has_window (widget))
+    w = gdk_window_get_parent (w);
+
+  clip = priv->clip;
+  while (w != window)
+    {
+      if (w == NULL)
+        return TRUE;
+
+      gdk_window_get_position (w, &x, &y);
+      clip.x += x;
+      clip.y += y;
+      w = gdk_window_get_parent (w);
+    }
+
+  return cairo_region_contains_rectangle (region, &clip) != CAIRO_REGION_OVERLAP_OUT;
+}
+
+static void
+invalidate_render_cache_foreach (GtkWidget *widget,
+                                 gpointer   data)
+{
+  RenderCacheInvalidation *invalidation = data;
+
+  if (!_gtk_widget_get_mapped (widget) ||
+      !gtk_widget_clip_intersects_region (widget,
+                                          invalidation->window,
+                                          invalidation->region))
+    return;
+
+  if (widget->priv->render_cache)
+    {
+      widget->priv->render_generation++;
+      gtk_widget_drop_render_recording (widget);
+    }
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget),
+                          invalidate_render_cache_foreach,
+                          data);
+}
+
+/* Called when @region of the window of @widget gets invalidated.
+ * The recordings of the descendants drawing there get dropped too,
+ * @widget and its ancestors are left to the caller.
+ */
+static void
+gtk_widget_invalidate_child_render_caches (GtkWidget            *widget,
+                                           const cairo_region_t *region)
+{
+  RenderCacheInvalidation invalidation;
+
+  if (n_render_cached_widgets == 0 ||
+      !_gtk_widget_get_mapped (widget) ||
+      !GTK_IS_CONTAINER (widget))
+    return;
+
+  invalidation.window = widget->priv->window;
+  invalidation.region = region;
+
+  gtk_container_forall (GTK_CONTAINER (widget),
+                        invalidate_render_cache_foreach,
+                        &invalidation);
+}
+
+static void
+gtk_widget_draw_with_render_cache (GtkWidget *widget,
+                                   cairo_t   *cr,
+                                   GdkWindow *event_window)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+  cairo_surface_t *recording;
+  cairo_t *record_cr;
+  double x_scale, y_scale;
+  guint generation;
+
+  if (priv->render_recording_window != event_window)
+    gtk_widget_drop_render_recording (widget);
+
+  if (priv->render_recording)
+    {
+      recording = cairo_surface_reference (priv->render_recording);
+    }
+  else
+    {
+      /* Only record widgets that get drawn again without having
+       * changed. The others, like animations, would only pay for
+       * recording and replaying every frame.
+       */
+      if (priv->render_drawn_generation != priv->render_generation)
+        {
+          priv->render_drawn_generation = priv->render_generation;
+          gtk_widget_emit_draw (widget, cr);
+          return;
+        }
+
+      generation = priv->render_generation;
+
+      recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
+      x_scale = y_scale = 1;
+      cairo_surface_get_device_scale (cairo_get_target (cr), &x_scale, &y_scale);
+      cairo_surface_set_device_scale (recording, x_scale, y_scale);
+
+      /* Record everything, the next draws might need other parts */
+      record_cr = cairo_create (recording);
+      gtk_cairo_set_event_window (record_cr, event_window);
+      cairo_rectangle (record_cr,
+                       priv->clip.x - priv->allocation.x,
+                       priv->clip.y - priv->allocation.y,
+                       priv->clip.width,
+                       priv->clip.height);
+      cairo_clip (record_cr);
+      gtk_widget_emit_draw (widget, record_cr);
+      cairo_destroy (record_cr);
+
+      /* Drawing might have changed the widget already */
+      if (priv->render_generation == generation)
+        {
+          priv->render_recording = cairo_surface_reference (recording);
+          priv->render_recording_window = event_window;
+        }
+    }
+
+  cairo_save (cr);
+  cairo_set_source_surface (cr, recording, 0, 0);
+  cairo_paint (cr);
+  cairo_restore (cr);
+
+  cairo_surface_destroy (recording);
+}
+
 void
 gtk_widget_draw_internal (GtkWidget *widget,
                           cairo_t   *cr,
@@ -6961,7 +7186,6 @@ gtk_widget_draw_internal (GtkWidget *widget,
   if (gdk_cairo_get_clip_rectangle (cr, NULL))
     {
       GdkWindow *event_window;
-      gboolean result;
       gboolean push_group;
 
       event_window = gtk_cairo_get_event_window (cr);
@@ -6976,18 +7200,10 @@ gtk_widget_draw_internal (GtkWidget *widget,
       if (push_group)
         cairo_push_group (cr);
 
-      if (g_signal_has_handler_pending (widget, widget_signals[DRAW], 0, FALSE))
-        {
-          g_signal_emit (widget, widget_signals[DRAW],
-                         0, cr,
-                         &result);
-        }
-      else if (GTK_WIDGET_GET_CLASS (widget)->draw)
-        {
-          cairo_save (cr);
-          GTK_WIDGET_GET_CLASS (widget)->draw (widget, cr);
-          cairo_restore (cr);
-        }
+      if (widget->priv->render_cache && event_window != NULL)
+        gtk_widget_draw_with_render_cache (widget, cr, event_window);
+      else
+        gtk_widget_emit_draw (widget, cr);
 
 #ifdef G_ENABLE_DEBUG
       if (GTK_DEBUG_CHECK (BASELINES))
@@ -12239,6 +12455,8 @@ gtk_widget_finalize (GObject *object)
 
   gtk_grab_remove (widget);
 
+  gtk_widget_set_render_cache (widget, FALSE);
+
   g_clear_object (&priv->style);
 
   g_free (priv->name);
@@ -16497,6 +16715,9 @@ gtk_widget_class_get_css_name (GtkWidgetClass *widget_class)
 void
 _gtk_widget_style_context_invalidated (GtkWidget *widget)
 {
+  gtk_widget_invalidate_render_cache (widget);
+  gtk_widget_set_opaque_rect (widget, NULL);
+
   if (_gtk_widget_get_realized (widget))
     g_signal_emit (widget, widget_signals[STYLE_UPDATED], 0);
   else
@@ -17442,3 +17663,97 @@ gtk_widget_reset_controllers (GtkWidget *widget)
       gtk_event_controller_reset (controller_data->controller);
     }
 }
+
+/*
+ * gtk_widget_set_render_cache:
+ * @widget: a #GtkWidget
+ * @render_cache: whether to keep what @widget draws
+ *
+ * Makes @widget keep a recording of what it and its children draw,
+ * and replay it instead of drawing again as long as neither of them
+ * queued a draw, got mapped or unmapped, got a new allocation or
+ * changed its style, and no ancestor queued a draw over them. This
+ * makes static parts of windows cheap to redraw when something next
+ * to them changes.
+ *
+ * Only use this for widgets that don't draw differently without
+ * telling GTK+, for example by invalidating their #GdkWindow
+ * directly.
+ */
+void
+gtk_widget_set_render_cache (GtkWidget *widget,
+                             gboolean   render_cache)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+
+  render_cache = !!render_cache;
+  if (priv->render_cache == render_cache)
+    return;
+
+  priv->render_cache = render_cache;
+
+  if (render_cache)
+    {
+      n_render_cached_widgets++;
+      /* don't count the first draw as a redraw */
+      priv->render_drawn_generation = priv->render_generation - 1;
+    }
+  else
+    {
+      n_render_cached_widgets--;
+      gtk_widget_drop_render_recording (widget);
+    }
+}
+
+/**
+ * gtk_widget_set_opaque_rect:
+ * @widget: a #GtkWidget
+ * @rect: (allow-none): the area covered with opaque pixels, in
+ *   widget coordinates, or %NULL
+ *
+ * Records that the last draw of @widget covered @rect with opaque
+ * pixels, so that its parent can skip drawing children below it.
+ * The main gadget of the widget calls this when it draws an opaque
+ * background.
+ */
+void
+gtk_widget_set_opaque_rect (GtkWidget                   *widget,
+                            const cairo_rectangle_int_t *rect)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+
+  if (rect)
+    priv->opaque_rect = *rect;
+  else
+    priv->opaque_rect.width = priv->opaque_rect.height = 0;
+}
+
+/**
+ * gtk_widget_get_opaque_rect:
+ * @widget: a #GtkWidget
+ * @rect: (out): return location for the opaque area, in the
+ *   coordinates of the allocation
+ *
+ * Returns: %TRUE if drawing @widget will cover @rect with opaque
+ *   pixels
+ */
+gboolean
+gtk_widget_get_opaque_rect (GtkWidget             *widget,
+                            cairo_rectangle_int_t *rect)
+{
+  GtkWidgetPrivate *priv = widget->priv;
+
+  /* Widgets with their own window are stacked by GDK */
+  if (_gtk_widget_get_has_window (widget) ||
+      priv->opaque_rect.width <= 0 ||
+      priv->opaque_rect.height <= 0 ||
+      priv->alpha != 255)
+    return FALSE;
+
+  rect->x = priv->allocation.x + priv->opaque_rect.x;
+  rect->y = priv->allocation.y + priv->opaque_rect.y;
+  rect->width = priv->opaque_rect.width;
+  rect->height = priv->opaque_rect.height;
+
+  return TRUE;
+}
@@ -75,6 +75,7 @@ struct _GtkWidgetPrivate
   guint multidevice           : 1;
   guint has_shape_mask        : 1;
   guint in_reparent           : 1;
+  guint render_cache          : 1;
 
   /* Queue-resize related flags */
   guint resize_needed         : 1; /* queue_resize() has been called but no get_preferred_size() yet */
@@ -157,6 +158,16 @@ struct _GtkWidgetPrivate
   GtkWidget *parent;
 
   GList *event_controllers;
+
+  /* What the widget drew last time, see gtk_widget_set_render_cache() */
+  cairo_surface_t *render_recording;
+  GdkWindow *render_recording_window;
+  guint render_generation;
+  guint render_drawn_generation;
+
+  /* What the widget covered with opaque pixels when it was last
+   * drawn, in widget coordinates, see gtk_widget_set_opaque_rect() */
+  cairo_rectangle_int_t opaque_rect;
 };
 
 GtkCssNode *  gtk_widget_get_css_node       (GtkWidget *widget);
@@ -294,6 +305,13 @@ gboolean          gtk_widget_has_size_request              (GtkWidget *widget);
 
 void              gtk_widget_reset_controllers             (GtkWidget *widget);
 
+void              gtk_widget_set_render_cache              (GtkWidget *widget,
+                                                            gboolean   render_cache);
+void              gtk_widget_set_opaque_rect               (GtkWidget                   *widget,
+                                                            const cairo_rectangle_int_t *rect);
+gboolean          gtk_widget_get_opaque_rect               (GtkWidget                   *widget,
+                                                            cairo_rectangle_int_t       *rect);
+
 /* inline getters */
 
 static inline gboolean
@@ -282,10 +282,9 @@ update_style (GtkInspectorCssEditor *ce)
   ce->priv->errors = NULL;
 
   text = get_current_text (ce->priv->text);
+  /* The provider only restyles the widgets affected by the edit */
   gtk_css_provider_load_from_data (provider, text, -1, NULL);
   g_free (text);
-
-  gtk_style_context_reset_widgets (gdk_screen_get_default ());
 }
 
 static gboolean
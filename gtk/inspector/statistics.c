@@ -26,6 +26,8 @@
 #include "gtkcellrenderertext.h"
 #include "gtkcelllayout.h"
 #include "gtksearchbar.h"
+#include "gtklabel.h"
+#include "gtkcssnodestylecacheprivate.h"
 
 enum
 {
@@ -52,6 +54,8 @@ struct _GtkInspectorStatisticsPrivate
   guint update_source_id;
   GtkWidget *search_entry;
   GtkWidget *search_bar;
+  GtkWidget *style_cache_label;
+  guint style_cache_source_id;
 };
 
 typedef struct {
@@ -123,6 +127,52 @@ add_type_count (GtkInspectorStatistics *sl, GType type)
   return cumulative;
 }
 
+static gboolean
+update_style_cache_stats (gpointer data)
+{
+  GtkInspectorStatistics *sl = data;
+  GtkCssNodeStyleCacheStats stats;
+  gchar *size, *budget, *text;
+
+  gtk_css_node_style_cache_get_stats (&stats);
+
+  size = g_format_size (stats.size);
+  budget = g_format_size (stats.budget);
+  /* Translators: statistics of the CSS style cache */
+  text = g_strdup_printf (_("Style cache: %u entries, %s of %s, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " evictions"),
+                          stats.n_entries, size, budget,
+                          stats.hits, stats.misses, stats.evictions);
+  gtk_label_set_text (GTK_LABEL (sl->priv->style_cache_label), text);
+
+  g_free (text);
+  g_free (budget);
+  g_free (size);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+style_cache_map (GtkWidget              *widget,
+                 GtkInspectorStatistics *sl)
+{
+  if (sl->priv->style_cache_source_id == 0)
+    sl->priv->style_cache_source_id = gdk_threads_add_timeout_seconds (1,
+                                                                      update_style_cache_stats,
+                                                                      sl);
+  update_style_cache_stats (sl);
+}
+
+static void
+style_cache_unmap (GtkWidget              *widget,
+                   GtkInspectorStatistics *sl)
+{
+  if (sl->priv->style_cache_source_id)
+    {
+      g_source_remove (sl->priv->style_cache_source_id);
+      sl->priv->style_cache_source_id = 0;
+    }
+}
+
 static gboolean
 update_type_counts (gpointer data)
 {
@@ -351,6 +401,8 @@ gtk_inspector_statistics_init (GtkInspectorStatistics *sl)
   gtk_tree_view_set_search_entry (sl->priv->view, GTK_ENTRY (sl->priv->search_entry));
   gtk_tree_view_set_search_equal_func (sl->priv->view, match_row, sl, NULL);
   g_signal_connect (sl, "hierarchy-changed", G_CALLBACK (hierarchy_changed), NULL);
+  g_signal_connect (sl, "map", G_CALLBACK (style_cache_map), sl);
+  g_signal_connect (sl, "unmap", G_CALLBACK (style_cache_unmap), sl);
 }
 
 static void
@@ -377,6 +429,8 @@ finalize (GObject *object)
 
   if (sl->priv->update_source_id)
     g_source_remove (sl->priv->update_source_id);
+  if (sl->priv->style_cache_source_id)
+    g_source_remove (sl->priv->style_cache_source_id);
 
   g_hash_table_unref (sl->priv->counts);
 
@@ -452,6 +506,7 @@ gtk_inspector_statistics_class_init (GtkInspectorStatisticsClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, renderer_cumulative2);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, search_entry);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, search_bar);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, style_cache_label);
 
 }
 
@@ -16,24 +16,28 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
-int
-main (int argc, char **argv)
+static void
+measure (const char *kernel,
+         int         n_threads,
+         int         size)
 {
   cairo_surface_t *surface;
   cairo_t *cr;
   GTimer *timer;
   double msec;
   int i, j;
-  int size;
 
-  timer = g_timer_new ();
+  if (!_gtk_cairo_blur_set_kernel (kernel, n_threads))
+    return;
 
-  size = 2000;
+  timer = g_timer_new ();
 
   surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
 
   cr = cairo_create (surface);
 
+  g_print ("%s, %d extra threads:\n", kernel, n_threads);
+
   /* We do everything three times, first two as warmup */
   for (j = 0; j < 2; j++)
     {
@@ -44,11 +48,35 @@ main (int argc, char **argv)
 	  _gtk_cairo_blur_surface (surface, i, GTK_BLUR_X | GTK_BLUR_Y);
 	  msec = g_timer_elapsed (timer, NULL) * 1000;
 	  if (j == 1)
-	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec:\n", i, msec, size*size/(msec*1000));
+	    g_print ("Radius %2d: %.2f msec, %.2f MPixel/s\n", i, msec, size*size/(msec*1000));
 	}
     }
 
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
   g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char **kernels;
+  int size;
+  int i;
+
+  size = 2000;
+
+  kernels = _gtk_cairo_blur_list_kernels ();
+
+  for (i = 0; kernels[i]; i++)
+    {
+      measure (kernels[i], 0, size);
+      /* the scalar kernel never uses threads */
+      if (g_get_num_processors () > 1 && !g_str_equal (kernels[i], "scalar"))
+        measure (kernels[i], g_get_num_processors () - 1, size);
+    }
+
+  g_free (kernels);
 
   return 0;
 }
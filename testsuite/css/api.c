@@ -19,6 +19,7 @@
  */
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 
 static void
 gtk_css_provider_load_data_not_null_terminated (void)
@@ -33,6 +34,291 @@ gtk_css_provider_load_data_not_null_terminated (void)
   g_object_unref (p);
 }
 
+static GFile *
+write_temp_file (const char *dir,
+                 const char *name,
+                 const char *contents,
+                 gssize      length)
+{
+  GError *error = NULL;
+  char *path;
+  GFile *file;
+
+  path = g_build_filename (dir, name, NULL);
+  g_file_set_contents (path, contents, length, &error);
+  g_assert_no_error (error);
+
+  file = g_file_new_for_path (path);
+  g_free (path);
+
+  return file;
+}
+
+static GFile *
+write_temp_image (const char *dir,
+                  const char *name,
+                  int         size)
+{
+  GError *error = NULL;
+  GdkPixbuf *pixbuf;
+  char *path;
+  GFile *file;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  gdk_pixbuf_fill (pixbuf, 0xff000080);
+
+  path = g_build_filename (dir, name, NULL);
+  gdk_pixbuf_save (pixbuf, path, "png", &error, NULL);
+  g_assert_no_error (error);
+
+  file = g_file_new_for_path (path);
+  g_free (path);
+  g_object_unref (pixbuf);
+
+  return file;
+}
+
+static char *
+to_string_from_file (GFile *file)
+{
+  GtkCssProvider *provider;
+  GError *error = NULL;
+  char *result;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_file (provider, file, &error);
+  g_assert_no_error (error);
+  result = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  return result;
+}
+
+static void
+gtk_css_provider_load_compiled (void)
+{
+  const char *css =
+    "@define-color fg red;\n"
+    "@keyframes spin { to { -gtk-icon-transform: rotate(1turn); } }\n"
+    "* { color: @fg; }\n"
+    "button.flat:hover, label#title > box:nth-child(2n+1) { margin: 1px 2px; }\n"
+    ".view:not(:selected) { -MyWidget-spacing: 3; animation: spin 1s; }\n";
+  GtkCssProvider *source_provider, *compiled_provider;
+  GError *error = NULL;
+  GFile *source, *compiled;
+  GBytes *bytes;
+  char *dir, *expected, *result;
+
+  dir = g_dir_make_tmp ("gtk-css-api-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  source = write_temp_file (dir, "test.css", css, -1);
+
+  source_provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_file (source_provider, source, &error);
+  g_assert_no_error (error);
+  expected = gtk_css_provider_to_string (source_provider);
+
+  bytes = gtk_css_provider_compile (source, &error);
+  g_assert_no_error (error);
+  g_assert (bytes != NULL);
+  compiled = write_temp_file (dir, "test.css.compiled",
+                              g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes));
+  g_bytes_unref (bytes);
+
+  compiled_provider = gtk_css_provider_new ();
+  g_assert (gtk_css_provider_load_from_compiled (compiled_provider, compiled, source, &error));
+  g_assert_no_error (error);
+  result = gtk_css_provider_to_string (compiled_provider);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  /* a changed source must be noticed */
+  g_object_unref (source);
+  source = write_temp_file (dir, "test.css", "* { color: blue; }", -1);
+  gtk_css_provider_load_from_file (source_provider, source, &error);
+  g_assert_no_error (error);
+  expected = gtk_css_provider_to_string (source_provider);
+
+  g_assert (gtk_css_provider_load_from_compiled (compiled_provider, compiled, source, &error));
+  g_assert_no_error (error);
+  result = gtk_css_provider_to_string (compiled_provider);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  /* invalid files fail when there is no source to fall back to */
+  g_assert (!gtk_css_provider_load_from_compiled (compiled_provider, source, NULL, &error));
+  g_assert_error (error, GTK_CSS_PROVIDER_ERROR, GTK_CSS_PROVIDER_ERROR_FAILED);
+  g_clear_error (&error);
+
+  g_file_delete (compiled, NULL, NULL);
+  g_file_delete (source, NULL, NULL);
+  g_rmdir (dir);
+  g_free (dir);
+  g_object_unref (compiled);
+  g_object_unref (source);
+  g_object_unref (compiled_provider);
+  g_object_unref (source_provider);
+}
+
+static void
+gtk_css_provider_load_compiled_url (void)
+{
+  const char *css =
+    ".image { background-image: url(\"image.png\"); }\n"
+    ".scaled { background-image: -gtk-scaled(url(\"image.png\"), url(\"image.png\")); }\n";
+  GtkCssProvider *compiled_provider;
+  GError *error = NULL;
+  GFile *source, *image, *compiled;
+  GBytes *bytes;
+  char *dir, *uri, *expected, *result;
+
+  dir = g_dir_make_tmp ("gtk-css-api-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  image = write_temp_image (dir, "image.png", 2);
+  source = write_temp_file (dir, "test.css", css, -1);
+
+  /* Images are referenced, not compiled in */
+  bytes = gtk_css_provider_compile (source, &error);
+  g_assert_no_error (error);
+  g_assert (bytes != NULL);
+  uri = g_file_get_uri (image);
+  g_assert (g_strstr_len (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), uri) != NULL);
+  g_assert (g_strstr_len (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), "data:") == NULL);
+  g_free (uri);
+
+  compiled = write_temp_file (dir, "test.css.compiled",
+                              g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes));
+  g_bytes_unref (bytes);
+
+  expected = to_string_from_file (source);
+  compiled_provider = gtk_css_provider_new ();
+  g_assert (gtk_css_provider_load_from_compiled (compiled_provider, compiled, NULL, &error));
+  g_assert_no_error (error);
+  result = gtk_css_provider_to_string (compiled_provider);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  /* so a changed image is picked up without recompiling */
+  g_object_unref (image);
+  image = write_temp_image (dir, "image.png", 3);
+
+  expected = to_string_from_file (source);
+  g_assert (gtk_css_provider_load_from_compiled (compiled_provider, compiled, NULL, &error));
+  g_assert_no_error (error);
+  result = gtk_css_provider_to_string (compiled_provider);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  g_file_delete (compiled, NULL, NULL);
+  g_file_delete (source, NULL, NULL);
+  g_file_delete (image, NULL, NULL);
+  g_rmdir (dir);
+  g_free (dir);
+  g_object_unref (compiled);
+  g_object_unref (source);
+  g_object_unref (image);
+  g_object_unref (compiled_provider);
+}
+
+/* Classes that no selector depends on don't restyle anything, but a
+ * reload may add a selector that does */
+static void
+gtk_css_provider_reload_after_class_change (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  GtkWidget *window, *outer, *inner, *label;
+  GdkRGBA color, red = { 1, 0, 0, 1 };
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, ".unused { color: blue; }", -1, NULL);
+  gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
+                                             GTK_STYLE_PROVIDER (provider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  outer = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  inner = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  label = gtk_label_new ("Label");
+  gtk_container_add (GTK_CONTAINER (window), outer);
+  gtk_container_add (GTK_CONTAINER (outer), inner);
+  gtk_container_add (GTK_CONTAINER (inner), label);
+
+  context = gtk_widget_get_style_context (label);
+  gtk_style_context_add_class (context, "y");
+  gtk_style_context_get_color (context, gtk_style_context_get_state (context), &color);
+  g_assert (!gdk_rgba_equal (&color, &red));
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (outer), "x");
+  gtk_style_context_get_color (context, gtk_style_context_get_state (context), &color);
+  g_assert (!gdk_rgba_equal (&color, &red));
+
+  gtk_css_provider_load_from_data (provider,
+                                   ".unused { color: blue; }\n"
+                                   ".x .y { color: red; }", -1, NULL);
+  gtk_style_context_get_color (context, gtk_style_context_get_state (context), &color);
+  g_assert (gdk_rgba_equal (&color, &red));
+
+  gtk_style_context_remove_provider_for_screen (gdk_screen_get_default (),
+                                                GTK_STYLE_PROVIDER (provider));
+  gtk_widget_destroy (window);
+  g_object_unref (provider);
+}
+
+/* A ruleset that only changes its selector must restyle both the
+ * nodes it matched and the ones it matches now */
+static void
+gtk_css_provider_reload_selector_change (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *foo_context, *bar_context;
+  GtkWidget *window, *box, *foo, *bar;
+  GdkRGBA color, red = { 1, 0, 0, 1 };
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, ".foo { color: red; }", -1, NULL);
+  gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
+                                             GTK_STYLE_PROVIDER (provider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  foo = gtk_label_new ("Foo");
+  bar = gtk_label_new ("Bar");
+  gtk_container_add (GTK_CONTAINER (window), box);
+  gtk_container_add (GTK_CONTAINER (box), foo);
+  gtk_container_add (GTK_CONTAINER (box), bar);
+
+  foo_context = gtk_widget_get_style_context (foo);
+  bar_context = gtk_widget_get_style_context (bar);
+  gtk_style_context_add_class (foo_context, "foo");
+  gtk_style_context_add_class (bar_context, "bar");
+
+  gtk_style_context_get_color (foo_context, gtk_style_context_get_state (foo_context), &color);
+  g_assert (gdk_rgba_equal (&color, &red));
+  gtk_style_context_get_color (bar_context, gtk_style_context_get_state (bar_context), &color);
+  g_assert (!gdk_rgba_equal (&color, &red));
+
+  gtk_css_provider_load_from_data (provider, ".bar { color: red; }", -1, NULL);
+
+  gtk_style_context_get_color (foo_context, gtk_style_context_get_state (foo_context), &color);
+  g_assert (!gdk_rgba_equal (&color, &red));
+  gtk_style_context_get_color (bar_context, gtk_style_context_get_state (bar_context), &color);
+  g_assert (gdk_rgba_equal (&color, &red));
+
+  gtk_style_context_remove_provider_for_screen (gdk_screen_get_default (),
+                                                GTK_STYLE_PROVIDER (provider));
+  gtk_widget_destroy (window);
+  g_object_unref (provider);
+}
 
 int
 main (int argc, char *argv[])
@@ -41,6 +327,14 @@ main (int argc, char *argv[])
 
   g_test_add_func ("/gtk_css_provider_load_data/not_null_terminated",
       gtk_css_provider_load_data_not_null_terminated);
+  g_test_add_func ("/gtk_css_provider_load_compiled/roundtrip",
+      gtk_css_provider_load_compiled);
+  g_test_add_func ("/gtk_css_provider_load_compiled/url",
+      gtk_css_provider_load_compiled_url);
+  g_test_add_func ("/gtk_css_provider_reload/class_change",
+      gtk_css_provider_reload_after_class_change);
+  g_test_add_func ("/gtk_css_provider_reload/selector_change",
+      gtk_css_provider_reload_selector_change);
 
   return g_test_run ();
 }
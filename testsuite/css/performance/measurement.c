@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_MALLINFO
+#include <malloc.h>
+#endif
+
+#include "measurement.h"
+
+#ifdef __GLIBC__
+/* Count allocations by interposing the malloc() family for the
+ * whole process. Memory handed out by GSlice is only counted when
+ * it needs new chunks, use G_SLICE=always-malloc to count those too.
+ */
+#define HAVE_ALLOCATION_COUNT 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_elements, size_t size);
+extern void *__libc_realloc (void *mem, size_t size);
+
+static gint n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_elements,
+        size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+
+  return __libc_calloc (n_elements, size);
+}
+
+void *
+realloc (void   *mem,
+         size_t  size)
+{
+  g_atomic_int_inc (&n_allocations);
+
+  return __libc_realloc (mem, size);
+}
+#endif
+
+void
+measurement_start (Measurement *m)
+{
+#ifdef HAVE_ALLOCATION_COUNT
+  m->allocations = g_atomic_int_get (&n_allocations);
+#endif
+#ifdef HAVE_MALLINFO
+  m->heap = mallinfo ().uordblks;
+#endif
+  g_timer_start (m->timer);
+}
+
+void
+measurement_stop (Measurement *m,
+                  double      *elapsed,
+                  double      *allocations,
+                  double      *heap)
+{
+  g_timer_stop (m->timer);
+  *elapsed += g_timer_elapsed (m->timer, NULL);
+#ifdef HAVE_ALLOCATION_COUNT
+  *allocations += g_atomic_int_get (&n_allocations) - m->allocations;
+#else
+  *allocations = -1;
+#endif
+#ifdef HAVE_MALLINFO
+  *heap += mallinfo ().uordblks - m->heap;
+#else
+  *heap = 0;
+#endif
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MEASUREMENT_H__
+#define __MEASUREMENT_H__
+
+#include <glib.h>
+
+/* Time, allocations and heap growth of a piece of code, summed up
+ * over several runs */
+typedef struct {
+  GTimer *timer;
+  gint    allocations;
+  glong   heap;
+} Measurement;
+
+void    measurement_start       (Measurement    *m);
+void    measurement_stop        (Measurement    *m,
+                                 double         *elapsed,
+                                 double         *allocations,
+                                 double         *heap);
+
+#endif /* __MEASUREMENT_H__ */
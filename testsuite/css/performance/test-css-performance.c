@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Measures the cost of the CSS machinery: parsing style sheets,
+ * styling a synthetic widget tree (selector matching and computing
+ * the values) and restyling it after changes of style classes and
+ * states.
+ *
+ * The results are printed as tab-separated values, one line per
+ * phase, so that runs can be compared with the usual tools.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "measurement.h"
+
+static gint width = 10;
+static gint depth = 10;
+static gint runs = 10;
+static gint n_rules = 1000;
+static gchar *theme = NULL;
+static gchar **stylesheets = NULL;
+
+static GOptionEntry entries[] = {
+  { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Create N buttons per level of the tree", "N" },
+  { "depth", 'd', 0, G_OPTION_ARG_INT, &depth, "Nest the tree N levels deep", "N" },
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Average over N runs", "N" },
+  { "rules", 'n', 0, G_OPTION_ARG_INT, &n_rules, "Generate N rules for the stress style sheet", "N" },
+  { "theme", 't', 0, G_OPTION_ARG_STRING, &theme, "Parse the builtin theme NAME", "NAME" },
+  { "css", 'c', 0, G_OPTION_ARG_FILENAME_ARRAY, &stylesheets, "Add the style sheet FILE", "FILE" },
+  { NULL }
+};
+
+static void
+report (const char *phase,
+        guint       n_ops,
+        double      elapsed,
+        double      allocations,
+        double      heap)
+{
+  guint total = n_ops * runs;
+
+  g_print ("%s\t%u\t%.1f\t%.2f\t%.1f\n",
+           phase,
+           n_ops,
+           elapsed * 1e9 / total,
+           allocations < 0 ? -1.0 : allocations / total,
+           heap / total);
+}
+
+/* Selectors in the style of what themes use, including some that
+ * never match so the selector tree has to reject them, followed by
+ * the style sheets given on the command line.
+ */
+static char *
+create_stress_css (void)
+{
+  GError *error = NULL;
+  GString *css;
+  char *contents;
+  int i;
+
+  css = g_string_new (NULL);
+
+  for (i = 0; i < n_rules; i++)
+    {
+      switch (i % 8)
+        {
+        case 0:
+          g_string_append_printf (css, "box > button.odd:hover label { color: #%06x; }\n", i * 4099 % 0xffffff);
+          break;
+        case 1:
+          g_string_append_printf (css, ".toggled button:nth-child(%dn+1) { padding: %dpx; }\n", i % 5 + 2, i % 7);
+          break;
+        case 2:
+          g_string_append_printf (css, "box box box .even:active { border-width: %dpx; }\n", i % 3);
+          break;
+        case 3:
+          g_string_append_printf (css, "window box:not(.unused-%d) > button:first-child { background-image: linear-gradient(to bottom, #%06x, #%06x); }\n",
+                                  i, i * 31 % 0xffffff, i * 17 % 0xffffff);
+          break;
+        case 4:
+          g_string_append_printf (css, ".unused-%d button, .unused-%d label { margin: %dpx; }\n", i, i, i % 4);
+          break;
+        case 5:
+          g_string_append_printf (css, "#button-%d:hover { box-shadow: 0 1px %dpx alpha(black, 0.2); }\n", i % (width + 1), i % 6);
+          break;
+        case 6:
+          g_string_append_printf (css, "box.toggled > button.even ~ button label { font-size: %dpx; }\n", 10 + i % 5);
+          break;
+        case 7:
+          g_string_append_printf (css, "button:backdrop:not(:hover) + button { opacity: 0.%d; }\n", i % 9 + 1);
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  for (i = 0; stylesheets && stylesheets[i]; i++)
+    {
+      if (!g_file_get_contents (stylesheets[i], &contents, NULL, &error))
+        g_error ("Failed to read %s: %s", stylesheets[i], error->message);
+
+      g_string_append (css, contents);
+      g_string_append_c (css, '\n');
+      g_free (contents);
+    }
+
+  return g_string_free (css, FALSE);
+}
+
+static void
+load_stylesheets (GtkCssProvider *theme_provider,
+                  GtkCssProvider *stress_provider,
+                  const char     *stress_css)
+{
+  GError *error = NULL;
+  char *path;
+
+  if (theme_provider)
+    {
+      path = g_strdup_printf ("/org/gtk/libgtk/theme/%s/gtk.css", theme);
+      gtk_css_provider_load_from_resource (theme_provider, path);
+      g_free (path);
+    }
+
+  if (stress_provider)
+    {
+      if (!gtk_css_provider_load_from_data (stress_provider, stress_css, -1, &error))
+        g_error ("Failed to parse stress style sheet: %s", error->message);
+    }
+}
+
+static void
+measure_parse (const char *stress_css)
+{
+  Measurement m = { g_timer_new (), };
+  double elapsed, allocations, heap;
+  GtkCssProvider *provider;
+  int i;
+
+  elapsed = allocations = heap = 0;
+  for (i = 0; i < runs; i++)
+    {
+      provider = gtk_css_provider_new ();
+      measurement_start (&m);
+      load_stylesheets (provider, NULL, NULL);
+      measurement_stop (&m, &elapsed, &allocations, &heap);
+      g_object_unref (provider);
+    }
+  report ("parse-theme", 1, elapsed, allocations, heap);
+
+  elapsed = allocations = heap = 0;
+  for (i = 0; i < runs; i++)
+    {
+      provider = gtk_css_provider_new ();
+      measurement_start (&m);
+      load_stylesheets (NULL, provider, stress_css);
+      measurement_stop (&m, &elapsed, &allocations, &heap);
+      g_object_unref (provider);
+    }
+  report ("parse-stress", 1, elapsed, allocations, heap);
+
+  g_timer_destroy (m.timer);
+}
+
+static GtkWidget *
+create_tree (GPtrArray *boxes,
+             GPtrArray *buttons)
+{
+  GtkWidget *window, *parent, *box, *button;
+  char *name;
+  int d, w;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  parent = window;
+
+  for (d = 0; d < depth; d++)
+    {
+      box = gtk_box_new (d % 2 ? GTK_ORIENTATION_HORIZONTAL : GTK_ORIENTATION_VERTICAL, 0);
+      gtk_container_add (GTK_CONTAINER (parent), box);
+      g_ptr_array_add (boxes, box);
+
+      for (w = 0; w < width; w++)
+        {
+          button = gtk_button_new_with_label ("Button");
+          name = g_strdup_printf ("button-%d", w);
+          gtk_widget_set_name (button, name);
+          g_free (name);
+          gtk_style_context_add_class (gtk_widget_get_style_context (button), w % 2 ? "odd" : "even");
+          gtk_container_add (GTK_CONTAINER (box), button);
+          g_ptr_array_add (buttons, button);
+        }
+
+      parent = box;
+    }
+
+  return window;
+}
+
+static void
+style_widget (GtkWidget *widget,
+              gpointer   unused)
+{
+  GtkStyleContext *context;
+  GdkRGBA color;
+
+  context = gtk_widget_get_style_context (widget);
+  gtk_style_context_get_color (context, gtk_style_context_get_state (context), &color);
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), style_widget, NULL);
+}
+
+static guint
+count_widgets (GtkWidget *widget)
+{
+  GList *children, *l;
+  guint n = 1;
+
+  if (!GTK_IS_CONTAINER (widget))
+    return n;
+
+  children = gtk_container_get_children (GTK_CONTAINER (widget));
+  for (l = children; l; l = l->next)
+    n += count_widgets (l->data);
+  g_list_free (children);
+
+  return n;
+}
+
+static void
+measure_style (const char *stress_css)
+{
+  Measurement m = { g_timer_new (), };
+  double elapsed, allocations, heap;
+  GtkCssProvider *provider;
+  GPtrArray *boxes, *buttons;
+  GtkWidget *window;
+  GdkScreen *screen;
+  guint n_widgets, i, j;
+
+  screen = gdk_screen_get_default ();
+  provider = gtk_css_provider_new ();
+  load_stylesheets (NULL, provider, stress_css);
+
+  boxes = g_ptr_array_new ();
+  buttons = g_ptr_array_new ();
+  window = create_tree (boxes, buttons);
+  n_widgets = count_widgets (window);
+
+  /* Adding a provider restyles everything, so this is a lookup and
+   * compute of every style from scratch. */
+  elapsed = allocations = heap = 0;
+  for (i = 0; i < runs; i++)
+    {
+      measurement_start (&m);
+      gtk_style_context_add_provider_for_screen (screen,
+                                                 GTK_STYLE_PROVIDER (provider),
+                                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+      style_widget (window, NULL);
+      measurement_stop (&m, &elapsed, &allocations, &heap);
+
+      gtk_style_context_remove_provider_for_screen (screen, GTK_STYLE_PROVIDER (provider));
+      style_widget (window, NULL);
+    }
+  report ("style", n_widgets, elapsed, allocations, heap);
+
+  gtk_style_context_add_provider_for_screen (screen,
+                                             GTK_STYLE_PROVIDER (provider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  style_widget (window, NULL);
+
+  elapsed = allocations = heap = 0;
+  for (i = 0; i < runs; i++)
+    {
+      measurement_start (&m);
+      for (j = 0; j < boxes->len; j++)
+        gtk_style_context_add_class (gtk_widget_get_style_context (g_ptr_array_index (boxes, j)), "toggled");
+      style_widget (window, NULL);
+      for (j = 0; j < boxes->len; j++)
+        gtk_style_context_remove_class (gtk_widget_get_style_context (g_ptr_array_index (boxes, j)), "toggled");
+      style_widget (window, NULL);
+      measurement_stop (&m, &elapsed, &allocations, &heap);
+    }
+  report ("class-invalidate", 2 * boxes->len, elapsed, allocations, heap);
+
+  elapsed = allocations = heap = 0;
+  for (i = 0; i < runs; i++)
+    {
+      measurement_start (&m);
+      for (j = 0; j < buttons->len; j++)
+        gtk_widget_set_state_flags (g_ptr_array_index (buttons, j), GTK_STATE_FLAG_PRELIGHT, FALSE);
+      style_widget (window, NULL);
+      for (j = 0; j < buttons->len; j++)
+        gtk_widget_unset_state_flags (g_ptr_array_index (buttons, j), GTK_STATE_FLAG_PRELIGHT);
+      style_widget (window, NULL);
+      measurement_stop (&m, &elapsed, &allocations, &heap);
+    }
+  report ("state-invalidate", 2 * buttons->len, elapsed, allocations, heap);
+
+  gtk_style_context_remove_provider_for_screen (screen, GTK_STYLE_PROVIDER (provider));
+  gtk_widget_destroy (window);
+  g_ptr_array_unref (boxes);
+  g_ptr_array_unref (buttons);
+  g_object_unref (provider);
+  g_timer_destroy (m.timer);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  char *stress_css;
+
+  if (!gtk_init_with_args (&argc, &argv, NULL, entries, NULL, &error))
+    {
+      g_printerr ("%s\n", error ? error->message : "Failed to initialize GTK+");
+      return 1;
+    }
+
+  if (width < 1 || depth < 1 || runs < 1 || n_rules < 0)
+    {
+      g_printerr ("Width, depth and runs must be positive\n");
+      return 1;
+    }
+
+  if (theme == NULL)
+    theme = g_strdup ("Adwaita");
+
+  stress_css = create_stress_css ();
+
+  g_print ("# width=%d depth=%d rules=%d runs=%d theme=%s\n", width, depth, n_rules, runs, theme);
+  g_print ("# phase\tops\tns/op\tallocations/op\theap-bytes/op\n");
+
+  measure_parse (stress_css);
+  measure_style (stress_css);
+
+  g_free (stress_css);
+
+  return 0;
+}
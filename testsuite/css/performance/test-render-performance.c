@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Measures the cost of the gtk_render_*() functions for a set of
+ * CSS inputs: border radii, borders, gradients, multiple backgrounds
+ * and box shadows with different blur radii, at scale 1 and 2.
+ *
+ * Every primitive draws the same box over and over again into an
+ * image surface, so this measures the steady state with all the
+ * caches filled, like a widget that gets redrawn.
+ *
+ * The results are printed as tab-separated values, one line per
+ * primitive, case and scale, so that runs can be compared with the
+ * usual tools.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "measurement.h"
+
+static gint runs = 1000;
+static gint box_width = 120;
+static gint box_height = 32;
+static gchar *filter = NULL;
+
+static GOptionEntry entries[] = {
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Average over N calls", "N" },
+  { "width", 0, 0, G_OPTION_ARG_INT, &box_width, "Draw boxes N pixels wide", "N" },
+  { "height", 0, 0, G_OPTION_ARG_INT, &box_height, "Draw boxes N pixels high", "N" },
+  { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter, "Only run the cases with TEXT in their name", "TEXT" },
+  { NULL }
+};
+
+typedef struct {
+  const char *name;
+  const char *css;
+} RenderCase;
+
+static const RenderCase box_cases[] = {
+  { "plain",                "background-color: #ddd;" },
+  { "radius-3",             "background-color: #ddd; border-radius: 3px;" },
+  { "radius-12",            "background-color: #ddd; border-radius: 12px;" },
+  { "radius-elliptic",      "background-color: #ddd; border-radius: 20px / 8px;" },
+  { "border-1",             "border: 1px solid #888;" },
+  { "border-1-radius-3",    "border: 1px solid #888; border-radius: 3px;" },
+  { "border-3-colors",      "border: 3px solid; border-color: red green blue yellow; border-radius: 5px;" },
+  { "border-dashed",        "border: 2px dashed #888; border-radius: 3px;" },
+  { "border-ridge",         "border: 4px ridge #888;" },
+  { "gradient-vertical",    "background-image: linear-gradient(to bottom, #eee, #ccc); border-radius: 3px;" },
+  { "gradient-angle",       "background-image: linear-gradient(30deg, #eee, #ccc 40%, #aaa);" },
+  { "gradient-repeating",   "background-image: repeating-linear-gradient(45deg, #eee, #eee 4px, #ccc 4px, #ccc 8px);" },
+  { "gradient-radial",      "background-image: radial-gradient(circle farthest-corner, #eee, #888);" },
+  { "multiple-backgrounds", "background-color: #ddd;"
+                            "background-image: linear-gradient(to bottom, alpha(white, 0.3), transparent),"
+                            " radial-gradient(ellipse at top, alpha(white, 0.2), transparent),"
+                            " linear-gradient(to right, #eee, #ccc);"
+                            "border-radius: 3px;" },
+  { "shadow-blur-0",        "background-color: #ddd; box-shadow: 0 1px alpha(black, 0.3);" },
+  { "shadow-blur-2",        "background-color: #ddd; border-radius: 3px; box-shadow: 0 1px 2px alpha(black, 0.3);" },
+  { "shadow-blur-8",        "background-color: #ddd; border-radius: 3px; box-shadow: 0 2px 8px alpha(black, 0.3);" },
+  { "shadow-blur-24",       "background-color: #ddd; border-radius: 8px; box-shadow: 0 8px 24px alpha(black, 0.4);" },
+  { "shadow-spread",        "background-color: #ddd; border-radius: 3px; box-shadow: 0 0 4px 3px alpha(black, 0.3);" },
+  { "shadow-inset",         "background-color: #ddd; border-radius: 3px; box-shadow: inset 0 1px 3px alpha(black, 0.3);" },
+  { "shadow-multiple",      "background-color: #ddd; border-radius: 3px;"
+                            "box-shadow: inset 0 1px alpha(white, 0.5), 0 1px 2px alpha(black, 0.2), 0 0 0 1px alpha(black, 0.1);" },
+  { "button",               "background-image: linear-gradient(to top, #edebe9 2px, #f6f5f4);"
+                            "border: 1px solid #cdc7c2; border-bottom-color: #bfb8b1; border-radius: 5px;"
+                            "box-shadow: inset 0 1px white, 0 1px alpha(black, 0.07);" },
+};
+
+static const RenderCase icon_cases[] = {
+  { "plain",                "" },
+  { "icon-shadow",          "-gtk-icon-shadow: 0 1px 2px alpha(black, 0.5);" },
+  { "icon-effect",          "-gtk-icon-effect: dim;" },
+};
+
+static const RenderCase layout_cases[] = {
+  { "plain",                "color: black;" },
+  { "text-shadow",          "color: black; text-shadow: 0 1px white;" },
+  { "text-shadow-blur",     "color: black; text-shadow: 0 1px 3px alpha(black, 0.5);" },
+};
+
+typedef enum {
+  RENDER_BACKGROUND,
+  RENDER_FRAME,
+  RENDER_ICON,
+  RENDER_LAYOUT
+} RenderPrimitive;
+
+static const char *primitive_names[] = {
+  "background",
+  "frame",
+  "icon",
+  "layout"
+};
+
+static gboolean
+case_selected (const char *primitive,
+               const char *name)
+{
+  gboolean selected;
+  char *full;
+
+  if (filter == NULL)
+    return TRUE;
+
+  full = g_strconcat (primitive, "/", name, NULL);
+  selected = strstr (full, filter) != NULL;
+  g_free (full);
+
+  return selected;
+}
+
+static GtkStyleContext *
+create_context (const char *css,
+                int         scale)
+{
+  GError *error = NULL;
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  GtkWidgetPath *path;
+  char *full_css;
+
+  full_css = g_strdup_printf (".benchmark { %s }", css);
+  provider = gtk_css_provider_new ();
+  if (!gtk_css_provider_load_from_data (provider, full_css, -1, &error))
+    g_error ("Failed to parse \"%s\": %s", full_css, error->message);
+  g_free (full_css);
+
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_WIDGET);
+  gtk_widget_path_iter_add_class (path, -1, "benchmark");
+
+  context = gtk_style_context_new ();
+  gtk_style_context_set_path (context, path);
+  gtk_style_context_set_scale (context, scale);
+  gtk_style_context_add_provider (context,
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  gtk_widget_path_unref (path);
+  g_object_unref (provider);
+
+  return context;
+}
+
+static void
+render (RenderPrimitive  primitive,
+        GtkStyleContext *context,
+        cairo_t         *cr,
+        GdkPixbuf       *pixbuf,
+        PangoLayout     *layout)
+{
+  switch (primitive)
+    {
+    case RENDER_BACKGROUND:
+      gtk_render_background (context, cr, 32, 32, box_width, box_height);
+      break;
+    case RENDER_FRAME:
+      gtk_render_frame (context, cr, 32, 32, box_width, box_height);
+      break;
+    case RENDER_ICON:
+      gtk_render_icon (context, cr, pixbuf, 32, 32);
+      break;
+    case RENDER_LAYOUT:
+      gtk_render_layout (context, cr, 32, 32, layout);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+measure_case (RenderPrimitive   primitive,
+              const RenderCase *render_case,
+              int               scale,
+              GdkPixbuf        *pixbuf)
+{
+  Measurement m = { g_timer_new (), };
+  double elapsed, allocations, heap;
+  GtkStyleContext *context;
+  cairo_surface_t *surface;
+  PangoLayout *layout;
+  cairo_t *cr;
+  int i;
+
+  if (!case_selected (primitive_names[primitive], render_case->name))
+    return;
+
+  context = create_context (render_case->css, scale);
+
+  /* Leave room for shadows around the box */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        (box_width + 64) * scale,
+                                        (box_height + 64) * scale);
+  cairo_surface_set_device_scale (surface, scale, scale);
+  cr = cairo_create (surface);
+
+  layout = pango_cairo_create_layout (cr);
+  pango_layout_set_text (layout, "The quick brown fox jumps over the lazy dog", -1);
+
+  /* Fill the caches and compute the style first */
+  render (primitive, context, cr, pixbuf, layout);
+
+  elapsed = allocations = heap = 0;
+  measurement_start (&m);
+  for (i = 0; i < runs; i++)
+    render (primitive, context, cr, pixbuf, layout);
+  measurement_stop (&m, &elapsed, &allocations, &heap);
+
+  g_print ("%s\t%s\t%d\t%.1f\t%.2f\n",
+           primitive_names[primitive],
+           render_case->name,
+           scale,
+           elapsed * 1e9 / runs,
+           allocations < 0 ? -1.0 : allocations / runs);
+
+  if (cairo_status (cr))
+    g_error ("Drawing %s/%s failed: %s",
+             primitive_names[primitive], render_case->name,
+             cairo_status_to_string (cairo_status (cr)));
+
+  g_object_unref (layout);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+  g_object_unref (context);
+  g_timer_destroy (m.timer);
+}
+
+static GdkPixbuf *
+create_icon (void)
+{
+  GdkPixbuf *pixbuf;
+  guchar *pixels;
+  int x, y, stride;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 32, 32);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  stride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  for (y = 0; y < 32; y++)
+    for (x = 0; x < 32; x++)
+      {
+        pixels[y * stride + 4 * x + 0] = x * 8;
+        pixels[y * stride + 4 * x + 1] = y * 8;
+        pixels[y * stride + 4 * x + 2] = 128;
+        pixels[y * stride + 4 * x + 3] = (x + y) * 4;
+      }
+
+  return pixbuf;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  GdkPixbuf *pixbuf;
+  int scale;
+  guint i;
+
+  if (!gtk_init_with_args (&argc, &argv, NULL, entries, NULL, &error))
+    {
+      g_printerr ("%s\n", error ? error->message : "Failed to initialize GTK+");
+      return 1;
+    }
+
+  if (runs < 1 || box_width < 1 || box_height < 1)
+    {
+      g_printerr ("Runs, width and height must be positive\n");
+      return 1;
+    }
+
+  pixbuf = create_icon ();
+
+  g_print ("# runs=%d size=%dx%d\n", runs, box_width, box_height);
+  g_print ("# primitive\tcase\tscale\tns/call\tallocations/call\n");
+
+  for (scale = 1; scale <= 2; scale++)
+    {
+      for (i = 0; i < G_N_ELEMENTS (box_cases); i++)
+        measure_case (RENDER_BACKGROUND, &box_cases[i], scale, pixbuf);
+
+      for (i = 0; i < G_N_ELEMENTS (box_cases); i++)
+        measure_case (RENDER_FRAME, &box_cases[i], scale, pixbuf);
+
+      for (i = 0; i < G_N_ELEMENTS (icon_cases); i++)
+        measure_case (RENDER_ICON, &icon_cases[i], scale, pixbuf);
+
+      for (i = 0; i < G_N_ELEMENTS (layout_cases); i++)
+        measure_case (RENDER_LAYOUT, &layout_cases[i], scale, pixbuf);
+    }
+
+  g_object_unref (pixbuf);
+
+  return 0;
+}
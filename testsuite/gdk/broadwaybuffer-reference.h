@@ -0,0 +1,25 @@
+#ifndef __BROADWAY_BUFFER_REFERENCE__
+#define __BROADWAY_BUFFER_REFERENCE__
+
+#include <glib-object.h>
+#include <cairo.h>
+
+typedef struct _ReferenceBuffer ReferenceBuffer;
+
+ReferenceBuffer *reference_buffer_create     (int              width,
+                                              int              height,
+                                              guint8          *data,
+                                              int              stride);
+void             reference_buffer_destroy    (ReferenceBuffer *buffer);
+void             reference_buffer_encode     (ReferenceBuffer *buffer,
+                                              ReferenceBuffer *prev,
+                                              GString         *dest);
+void             reference_buffer_update_rect (ReferenceBuffer       *buffer,
+                                               cairo_rectangle_int_t *rect,
+                                               guint8                *data,
+                                               int                    stride,
+                                               GString               *dest);
+int              reference_buffer_get_width  (ReferenceBuffer *buffer);
+int              reference_buffer_get_height (ReferenceBuffer *buffer);
+
+#endif /* __BROADWAY_BUFFER_REFERENCE__ */
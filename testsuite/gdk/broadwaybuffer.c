@@ -0,0 +1,287 @@
+/* Broadway buffer encoding tests.
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "../../gdk/broadway/broadway-buffer.h"
+#include "broadwaybuffer-reference.h"
+
+/* The frames are what a window looks like while it is scrolled:
+ * opaque content moving up, with translucent shadows and gradients
+ * on top, so that the encoder finds both blocks to reuse and pixels
+ * to unpremultiply. */
+static void
+draw_frame (cairo_surface_t *surface,
+            int              frame)
+{
+  cairo_pattern_t *pattern;
+  cairo_t *cr;
+  int width, height, y;
+
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+
+  cr = cairo_create (surface);
+
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_rgba (cr, 0, 0, 0, 0);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+  cairo_rectangle (cr, 4, 4, width - 8, height - 8);
+  cairo_set_source_rgb (cr, 0.95, 0.95, 0.9);
+  cairo_fill (cr);
+
+  for (y = -(frame * 13) % 24; y < height; y += 24)
+    {
+      cairo_rectangle (cr, 10, y + 4, (y * 7 + 300) % (width + 1), 14);
+      cairo_set_source_rgb (cr, (y & 0xff) / 255., 0.3, 0.6);
+      cairo_fill (cr);
+    }
+
+  pattern = cairo_pattern_create_linear (0, 0, width, height);
+  cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0.5, 0, 0);
+  cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0.2, 1, 0.8);
+  cairo_set_source (cr, pattern);
+  cairo_rectangle (cr, 0, 0, width, height / 3);
+  cairo_fill (cr);
+  cairo_pattern_destroy (pattern);
+
+  pattern = cairo_pattern_create_radial (width / 2, height / 2, 0,
+                                         width / 2, height / 2, MAX (width, height) / 2);
+  cairo_pattern_add_color_stop_rgba (pattern, 0, 0, 0, 0, 0.6);
+  cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 0, 0);
+  cairo_set_source (cr, pattern);
+  cairo_arc (cr, width / 2, height / 2 + frame, MAX (width, height) / 3, 0, 2 * G_PI);
+  cairo_fill (cr);
+  cairo_pattern_destroy (pattern);
+
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+}
+
+/* Every alpha with every color value, including the ones that are
+ * too big to be premultiplied. */
+static void
+draw_all_pixels (cairo_surface_t *surface)
+{
+  guint32 *line;
+  guint8 *data;
+  int width, height, stride, x, y;
+
+  cairo_surface_flush (surface);
+  data = cairo_image_surface_get_data (surface);
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  for (y = 0; y < height; y++)
+    {
+      line = (guint32 *) (data + y * stride);
+      for (x = 0; x < width; x++)
+        line[x] = (y & 0xff) << 24 | (x & 0xff) << 16 | ((x * 3) & 0xff) << 8 | ((255 - x) & 0xff);
+    }
+
+  cairo_surface_mark_dirty (surface);
+}
+
+static GString *
+encode_frames (int          width,
+               int          height,
+               int          n_frames,
+               const char **kernels)
+{
+  cairo_rectangle_int_t rect;
+  cairo_surface_t *surface;
+  BroadwayBuffer *buffer, *prev;
+  GString *dest;
+  int frame;
+
+  dest = g_string_new (NULL);
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  prev = NULL;
+
+  for (frame = 0; frame < n_frames; frame++)
+    {
+      g_assert (broadway_buffer_set_kernel (kernels[frame % g_strv_length ((char **) kernels)]));
+
+      if (frame == 0 && width >= 256 && height >= 256)
+        draw_all_pixels (surface);
+      else
+        draw_frame (surface, frame);
+
+      buffer = broadway_buffer_create (width, height,
+                                       cairo_image_surface_get_data (surface),
+                                       cairo_image_surface_get_stride (surface));
+      broadway_buffer_encode (buffer, prev, dest);
+
+      draw_frame (surface, frame + n_frames);
+      rect.x = width / 3;
+      rect.y = height / 4;
+      rect.width = width / 2 + 1;
+      rect.height = height / 2 + 1;
+      broadway_buffer_update_rect (buffer, &rect,
+                                   cairo_image_surface_get_data (surface),
+                                   cairo_image_surface_get_stride (surface),
+                                   dest);
+
+      if (prev)
+        broadway_buffer_destroy (prev);
+      prev = buffer;
+    }
+
+  broadway_buffer_destroy (prev);
+  cairo_surface_destroy (surface);
+  broadway_buffer_set_kernel (NULL);
+
+  return dest;
+}
+
+/* The same frames through the encoder as it was before the kernels */
+static GString *
+encode_frames_reference (int width,
+                         int height,
+                         int n_frames)
+{
+  cairo_rectangle_int_t rect;
+  cairo_surface_t *surface;
+  ReferenceBuffer *buffer, *prev;
+  GString *dest;
+  int frame;
+
+  dest = g_string_new (NULL);
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  prev = NULL;
+
+  for (frame = 0; frame < n_frames; frame++)
+    {
+      if (frame == 0 && width >= 256 && height >= 256)
+        draw_all_pixels (surface);
+      else
+        draw_frame (surface, frame);
+
+      buffer = reference_buffer_create (width, height,
+                                        cairo_image_surface_get_data (surface),
+                                        cairo_image_surface_get_stride (surface));
+      reference_buffer_encode (buffer, prev, dest);
+
+      draw_frame (surface, frame + n_frames);
+      rect.x = width / 3;
+      rect.y = height / 4;
+      rect.width = width / 2 + 1;
+      rect.height = height / 2 + 1;
+      reference_buffer_update_rect (buffer, &rect,
+                                    cairo_image_surface_get_data (surface),
+                                    cairo_image_surface_get_stride (surface),
+                                    dest);
+
+      if (prev)
+        reference_buffer_destroy (prev);
+      prev = buffer;
+    }
+
+  reference_buffer_destroy (prev);
+  cairo_surface_destroy (surface);
+
+  return dest;
+}
+
+static void
+assert_same_encoding (GString *result,
+                      GString *expected)
+{
+  g_assert_cmpuint (result->len, ==, expected->len);
+  g_assert (memcmp (result->str, expected->str, expected->len) == 0);
+  g_string_free (result, TRUE);
+}
+
+static const struct {
+  int width;
+  int height;
+} sizes[] = {
+  { 256, 256 },
+  { 301, 167 },
+  { 640, 64 },
+  { 35, 31 },
+  { 37, 40 },
+  { 7, 3 },
+  { 1, 1 },
+};
+
+static void
+check_kernel (const char *name)
+{
+  const char *kernel[] = { NULL, NULL };
+  const char *mixed[] = { NULL, "scalar", NULL };
+  GString *expected;
+  guint i;
+
+  kernel[0] = mixed[0] = name;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      expected = encode_frames_reference (sizes[i].width, sizes[i].height, 6);
+
+      assert_same_encoding (encode_frames (sizes[i].width, sizes[i].height, 6, kernel),
+                            expected);
+
+      /* The hashes have to match between kernels too, or blocks of
+       * the previous frame are not found */
+      assert_same_encoding (encode_frames (sizes[i].width, sizes[i].height, 6, mixed),
+                            expected);
+
+      g_string_free (expected, TRUE);
+    }
+}
+
+static void
+test_kernel (gconstpointer data)
+{
+  check_kernel (data);
+}
+
+static void
+test_unknown_kernel (void)
+{
+  g_assert (!broadway_buffer_set_kernel ("unknown"));
+  g_assert (broadway_buffer_set_kernel ("scalar"));
+  g_assert (broadway_buffer_set_kernel (NULL));
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char **kernels;
+  char *path;
+  guint i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/broadway/buffer/unknown-kernel", test_unknown_kernel);
+
+  kernels = broadway_buffer_list_kernels ();
+  for (i = 0; kernels[i]; i++)
+    {
+      path = g_strdup_printf ("/broadway/buffer/kernel/%s", kernels[i]);
+      g_test_add_data_func (path, kernels[i], test_kernel);
+      g_free (path);
+    }
+  g_free (kernels);
+
+  return g_test_run ();
+}
@@ -0,0 +1,184 @@
+/* Box blur kernel tests.
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "../../gtk/gtkcairoblurprivate.h"
+
+/* The largest one is big enough to be blurred by several threads */
+static const struct {
+  int width;
+  int height;
+} sizes[] = {
+  { 700, 420 },
+  { 301, 167 },
+  { 64, 64 },
+  { 37, 40 },
+  { 17, 3 },
+  { 1, 1 },
+};
+
+/* The last one has a box filter too large for the vectorized code */
+static const int radii[] = { 2, 3, 4, 5, 8, 13, 40, 150 };
+
+/* Hard edges, gradients and noise, written directly so that the
+ * contents don't depend on how cairo draws. */
+static cairo_surface_t *
+create_surface (int width,
+                int height)
+{
+  cairo_surface_t *surface;
+  guint8 *data;
+  int stride, x, y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        if ((x / 23 + y / 17) % 3 == 0)
+          data[y * stride + x] = 255;
+        else if ((x / 23 + y / 17) % 3 == 1)
+          data[y * stride + x] = (x * 7 + y * 13 + (x * y) % 31) & 0xff;
+        else
+          data[y * stride + x] = 0;
+      }
+
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static cairo_surface_t *
+blur_surface (const char   *kernel,
+              int           n_threads,
+              int           width,
+              int           height,
+              int           radius,
+              GtkBlurFlags  flags)
+{
+  cairo_surface_t *surface;
+
+  g_assert (_gtk_cairo_blur_set_kernel (kernel, n_threads));
+
+  surface = create_surface (width, height);
+  _gtk_cairo_blur_surface (surface, radius, flags);
+  cairo_surface_flush (surface);
+
+  _gtk_cairo_blur_set_kernel (NULL, -1);
+
+  return surface;
+}
+
+static void
+assert_same_pixels (cairo_surface_t *result,
+                    cairo_surface_t *expected)
+{
+  guint8 *result_data, *expected_data;
+  int width, height, stride, y;
+
+  width = cairo_image_surface_get_width (expected);
+  height = cairo_image_surface_get_height (expected);
+  stride = cairo_image_surface_get_stride (expected);
+  result_data = cairo_image_surface_get_data (result);
+  expected_data = cairo_image_surface_get_data (expected);
+
+  g_assert_cmpint (cairo_image_surface_get_stride (result), ==, stride);
+
+  for (y = 0; y < height; y++)
+    g_assert (memcmp (result_data + y * stride, expected_data + y * stride, width) == 0);
+}
+
+static void
+check_kernel (const char *name,
+              int         n_threads)
+{
+  const GtkBlurFlags flags[] = { GTK_BLUR_X, GTK_BLUR_Y, GTK_BLUR_X | GTK_BLUR_Y };
+  cairo_surface_t *expected, *result;
+  guint i, j, k;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (j = 0; j < G_N_ELEMENTS (radii); j++)
+      for (k = 0; k < G_N_ELEMENTS (flags); k++)
+        {
+          expected = blur_surface ("scalar", 0,
+                                   sizes[i].width, sizes[i].height,
+                                   radii[j], flags[k]);
+          result = blur_surface (name, n_threads,
+                                 sizes[i].width, sizes[i].height,
+                                 radii[j], flags[k]);
+
+          assert_same_pixels (result, expected);
+
+          cairo_surface_destroy (result);
+          cairo_surface_destroy (expected);
+        }
+}
+
+static void
+test_kernel (gconstpointer data)
+{
+  check_kernel (data, 0);
+}
+
+static void
+test_kernel_threaded (gconstpointer data)
+{
+  check_kernel (data, 3);
+}
+
+static void
+test_unknown_kernel (void)
+{
+  g_assert (!_gtk_cairo_blur_set_kernel ("unknown", -1));
+  g_assert (_gtk_cairo_blur_set_kernel ("scalar", -1));
+  g_assert (_gtk_cairo_blur_set_kernel (NULL, -1));
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char **kernels;
+  char *path;
+  guint i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cairoblur/unknown-kernel", test_unknown_kernel);
+
+  kernels = _gtk_cairo_blur_list_kernels ();
+  for (i = 0; kernels[i]; i++)
+    {
+      /* the scalar kernel is the reference, and never uses threads */
+      if (g_str_equal (kernels[i], "scalar"))
+        continue;
+
+      path = g_strdup_printf ("/cairoblur/kernel/%s", kernels[i]);
+      g_test_add_data_func (path, kernels[i], test_kernel);
+      g_free (path);
+
+      path = g_strdup_printf ("/cairoblur/kernel/%s/threaded", kernels[i]);
+      g_test_add_data_func (path, kernels[i], test_kernel_threaded);
+      g_free (path);
+    }
+  g_free (kernels);
+
+  return g_test_run ();
+}
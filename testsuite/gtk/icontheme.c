@@ -752,6 +752,79 @@ test_nonsquare_symbolic (void)
   g_object_unref (info);
 }
 
+static void
+assert_pixel (GdkPixbuf *pixbuf,
+              gint       x,
+              gint       y,
+              guint8     red,
+              guint8     green,
+              guint8     blue)
+{
+  guchar *pixel;
+
+  pixel = gdk_pixbuf_get_pixels (pixbuf)
+          + y * gdk_pixbuf_get_rowstride (pixbuf)
+          + x * gdk_pixbuf_get_n_channels (pixbuf);
+
+  g_assert_cmpint (pixel[0], ==, red);
+  g_assert_cmpint (pixel[1], ==, green);
+  g_assert_cmpint (pixel[2], ==, blue);
+  g_assert_cmpint (pixel[3], ==, 255);
+}
+
+static void
+test_symbolic_colors (void)
+{
+  GtkIconTheme *icon_theme;
+  GtkIconInfo *info;
+  GFile *file;
+  GIcon *icon;
+  GdkPixbuf *pixbuf;
+  GdkRGBA fg = { 0.6, 0.6, 0.6, 1.0 };
+  GdkRGBA warning = { 0.2, 0.4, 0.8, 1.0 };
+  gboolean was_symbolic = FALSE;
+  GError *error = NULL;
+  gchar *path = g_build_filename (g_test_get_dir (G_TEST_DIST),
+				  "icons",
+				  "scalable",
+				  "classes-symbolic.svg",
+				  NULL);
+
+  icon_theme = gtk_icon_theme_get_default ();
+  file = g_file_new_for_path (path);
+  icon = g_file_icon_new (file);
+  info = gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme, icon,
+						   32, 1, 0);
+  g_assert_nonnull (info);
+
+  /* the colors are the ones symbolic SVGs were always rendered with */
+  pixbuf = gtk_icon_info_load_symbolic (info, &fg, NULL, NULL, NULL,
+					&was_symbolic, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (pixbuf);
+  g_assert_true (was_symbolic);
+
+  assert_pixel (pixbuf, 8, 8, 153, 153, 153);
+  assert_pixel (pixbuf, 24, 8, 78, 154, 6);
+  assert_pixel (pixbuf, 8, 24, 245, 121, 62);
+  assert_pixel (pixbuf, 24, 24, 204, 0, 0);
+  g_object_unref (pixbuf);
+
+  pixbuf = gtk_icon_info_load_symbolic (info, &fg, NULL, &warning, NULL,
+					NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (pixbuf);
+
+  assert_pixel (pixbuf, 8, 8, 153, 153, 153);
+  assert_pixel (pixbuf, 8, 24, 51, 102, 204);
+  g_object_unref (pixbuf);
+
+  g_free (path);
+  g_object_unref (file);
+  g_object_unref (icon);
+  g_object_unref (info);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -771,6 +844,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/icontheme/async", test_async);
   g_test_add_func ("/icontheme/inherit", test_inherit);
   g_test_add_func ("/icontheme/nonsquare-symbolic", test_nonsquare_symbolic);
+  g_test_add_func ("/icontheme/symbolic-colors", test_symbolic_colors);
 
   return g_test_run();
 }
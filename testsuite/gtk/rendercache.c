@@ -0,0 +1,272 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "../../gtk/gtkwidgetprivate.h"
+
+/* A window with a render cached box holding a red area, next to a
+ * blue area that isn't cached. Both count how often they draw.
+ */
+typedef struct {
+  GtkWidget *window;
+  GtkWidget *cached;
+  GtkWidget *cached_area;
+  GtkWidget *other_area;
+  guint cached_draws;
+  guint other_draws;
+} Fixture;
+
+static gboolean
+draw_cached_area (GtkWidget *widget,
+                  cairo_t   *cr,
+                  Fixture   *fixture)
+{
+  fixture->cached_draws++;
+  cairo_set_source_rgb (cr, 1, 0, 0);
+  cairo_paint (cr);
+
+  return FALSE;
+}
+
+static gboolean
+draw_other_area (GtkWidget *widget,
+                 cairo_t   *cr,
+                 Fixture   *fixture)
+{
+  fixture->other_draws++;
+  cairo_set_source_rgb (cr, 0, 0, 1);
+  cairo_paint (cr);
+
+  return FALSE;
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+               gconstpointer  data)
+{
+  GtkWidget *box;
+
+  fixture->window = gtk_offscreen_window_new ();
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  gtk_container_add (GTK_CONTAINER (fixture->window), box);
+
+  fixture->cached = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_widget_set_render_cache (fixture->cached, TRUE);
+  gtk_container_add (GTK_CONTAINER (box), fixture->cached);
+
+  fixture->cached_area = gtk_drawing_area_new ();
+  gtk_widget_set_size_request (fixture->cached_area, 100, 100);
+  g_signal_connect (fixture->cached_area, "draw",
+                    G_CALLBACK (draw_cached_area), fixture);
+  gtk_container_add (GTK_CONTAINER (fixture->cached), fixture->cached_area);
+
+  fixture->other_area = gtk_drawing_area_new ();
+  gtk_widget_set_size_request (fixture->other_area, 100, 100);
+  g_signal_connect (fixture->other_area, "draw",
+                    G_CALLBACK (draw_other_area), fixture);
+  gtk_container_add (GTK_CONTAINER (box), fixture->other_area);
+
+  gtk_widget_show_all (fixture->window);
+  gtk_test_widget_wait_for_draw (fixture->window);
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+                  gconstpointer  data)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+static void
+process_updates (Fixture *fixture)
+{
+  gdk_window_process_updates (gtk_widget_get_window (fixture->window), TRUE);
+}
+
+/* Redraws the whole window behind GTK+'s back, like an expose */
+static void
+expose (Fixture *fixture)
+{
+  gdk_window_invalidate_rect (gtk_widget_get_window (fixture->window), NULL, TRUE);
+  process_updates (fixture);
+}
+
+/* Get the cached box to record itself: it draws directly the first
+ * time, and records on the first unchanged redraw */
+static void
+record (Fixture *fixture)
+{
+  expose (fixture);
+  expose (fixture);
+}
+
+static guint32
+get_pixel (Fixture   *fixture,
+           GtkWidget *widget)
+{
+  cairo_surface_t *surface;
+  GtkAllocation allocation;
+  guint32 pixel;
+  cairo_t *cr;
+
+  gtk_widget_get_allocation (widget, &allocation);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 1, 1);
+  cr = cairo_create (surface);
+  cairo_set_source_surface (cr,
+                            gtk_offscreen_window_get_surface (GTK_OFFSCREEN_WINDOW (fixture->window)),
+                            - allocation.x - allocation.width / 2,
+                            - allocation.y - allocation.height / 2);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  cairo_surface_flush (surface);
+  pixel = *(guint32 *) cairo_image_surface_get_data (surface);
+  cairo_surface_destroy (surface);
+
+  return pixel & 0xffffff;
+}
+
+static void
+test_replay (Fixture       *fixture,
+             gconstpointer  data)
+{
+  guint draws;
+
+  record (fixture);
+  draws = fixture->cached_draws;
+
+  expose (fixture);
+  expose (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, draws);
+  g_assert_cmphex (get_pixel (fixture, fixture->cached_area), ==, 0xff0000);
+  g_assert_cmphex (get_pixel (fixture, fixture->other_area), ==, 0x0000ff);
+}
+
+static void
+test_uncached_draw (Fixture       *fixture,
+                    gconstpointer  data)
+{
+  gtk_widget_set_render_cache (fixture->cached, FALSE);
+  fixture->cached_draws = 0;
+
+  expose (fixture);
+  expose (fixture);
+  expose (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, 3);
+}
+
+static void
+test_invalidate_child (Fixture       *fixture,
+                       gconstpointer  data)
+{
+  guint draws;
+
+  record (fixture);
+  draws = fixture->cached_draws;
+
+  gtk_widget_queue_draw (fixture->cached_area);
+  process_updates (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, draws + 1);
+}
+
+static void
+test_invalidate_ancestor (Fixture       *fixture,
+                          gconstpointer  data)
+{
+  guint draws;
+
+  record (fixture);
+  draws = fixture->cached_draws;
+
+  gtk_widget_queue_draw (fixture->window);
+  expose (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, draws + 1);
+}
+
+static void
+test_invalidate_ancestor_region (Fixture       *fixture,
+                                 gconstpointer  data)
+{
+  GtkAllocation allocation;
+  guint draws;
+
+  record (fixture);
+  draws = fixture->cached_draws;
+
+  /* Only a single pixel of the cached box gets invalidated,
+   * what it recorded there is stale anyway */
+  gtk_widget_get_allocation (fixture->cached_area, &allocation);
+  gtk_widget_queue_draw_area (gtk_widget_get_parent (fixture->cached),
+                              allocation.x + allocation.width - 1,
+                              allocation.y + allocation.height - 1,
+                              1, 1);
+  expose (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, draws + 1);
+}
+
+static void
+test_invalidate_ancestor_elsewhere (Fixture       *fixture,
+                                    gconstpointer  data)
+{
+  GtkAllocation allocation;
+  guint draws, other_draws;
+
+  record (fixture);
+  draws = fixture->cached_draws;
+  other_draws = fixture->other_draws;
+
+  /* Invalidating next to the cached box keeps its recording */
+  gtk_widget_get_allocation (fixture->other_area, &allocation);
+  gtk_widget_queue_draw_area (fixture->window,
+                              allocation.x, allocation.y,
+                              allocation.width, allocation.height);
+  process_updates (fixture);
+  expose (fixture);
+
+  g_assert_cmpuint (fixture->cached_draws, ==, draws);
+  g_assert_cmpuint (fixture->other_draws, ==, other_draws + 2);
+  g_assert_cmphex (get_pixel (fixture, fixture->cached_area), ==, 0xff0000);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/rendercache/replay", Fixture, NULL,
+              fixture_setup, test_replay, fixture_teardown);
+  g_test_add ("/rendercache/uncached-draw", Fixture, NULL,
+              fixture_setup, test_uncached_draw, fixture_teardown);
+  g_test_add ("/rendercache/invalidate/child", Fixture, NULL,
+              fixture_setup, test_invalidate_child, fixture_teardown);
+  g_test_add ("/rendercache/invalidate/ancestor", Fixture, NULL,
+              fixture_setup, test_invalidate_ancestor, fixture_teardown);
+  g_test_add ("/rendercache/invalidate/ancestor-region", Fixture, NULL,
+              fixture_setup, test_invalidate_ancestor_region, fixture_teardown);
+  g_test_add ("/rendercache/invalidate/ancestor-elsewhere", Fixture, NULL,
+              fixture_setup, test_invalidate_ancestor_elsewhere, fixture_teardown);
+
+  return g_test_run ();
+}